@@ -1,9 +1,64 @@
 // This file was created by: Valentin-Ioan VINTILA (313CA)
 
+// pthread_rwlock_t is a POSIX feature
+#define _POSIX_C_SOURCE 200809L
+
 #include "octave.h"
+#include "octave_benchmark.h"
+#include "octave_server.h"
 
-// We do nothing but run the "terminal"
-int main(void)
+// We do nothing but read the startup options and run the "terminal" (or the
+// benchmarks / the server / a worker, if they were requested)
+int main(int argc, char **argv)
 {
-	return octave_terminal();
+	octave_options opts;
+	if (!octave_options_parse(&opts, argc, argv))
+		return EXIT_FAILURE;
+
+	// The placement applies to every mode
+	if (!topo_init(opts.numa, opts.pin_threads, opts.huge_pages,
+				   opts.huge_threshold, opts.threads))
+		return EXIT_FAILURE;
+	if (opts.topology)
+		topo_report(stderr);
+
+	// The simulator is a client of its own library (see 'octave_library'),
+	// which sets up the tuning, the back end and the verification
+	olib_config config;
+	olib_config_init(&config);
+	config.tuning_path = opts.tuning_path;
+	config.backend = opts.backend;
+	config.verify = opts.verify;
+	config.verify_fallback = opts.verify_fallback;
+	config.seed = opts.seed;
+	if (olib_init(&config) != OLIB_OK) {
+		fprintf(stderr, "The %s back end can't be used with MOD = %d\n",
+				multiply_backend_name(opts.backend), MOD);
+		return EXIT_FAILURE;
+	}
+
+	int status;
+	switch (opts.mode) {
+	case OCTAVE_MODE_GENERATE:
+		status = bench_generate(&opts);
+		break;
+	case OCTAVE_MODE_BENCH:
+		status = bench_run(&opts);
+		break;
+	case OCTAVE_MODE_TUNE:
+		status = bench_tune(&opts);
+		break;
+	case OCTAVE_MODE_SERVER:
+		status = octave_server_run(&opts);
+		break;
+	case OCTAVE_MODE_WORKER:
+		status = dist_worker_run(opts.worker_address);
+		break;
+	default:
+		status = octave_terminal(&opts);
+		break;
+	}
+
+	olib_free();
+	return status;
 }
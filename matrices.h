@@ -8,13 +8,21 @@
 // header files, the order is irrelevant - so, they are included alphabetically
 
 #include "matrices_base.h"
+#include "matrices_chain.h"
+#include "matrices_distributed.h"
+#include "matrices_elementwise.h"
 #include "matrices_errors.h"
 #include "matrices_input.h"
+#include "matrices_linear.h"
+#include "matrices_memory.h"
 #include "matrices_multiplication.h"
+#include "matrices_out_of_core.h"
 #include "matrices_output.h"
 #include "matrices_resize.h"
+#include "matrices_shared.h"
 #include "matrices_sort.h"
 #include "matrices_transpose.h"
+#include "matrices_verification.h"
 #include "safe_utilities.h"
 
 #endif // MATRICES_H
@@ -10,6 +10,7 @@
 // Standard library dependencies
 #include <stdlib.h> // free
 #include <stdio.h> // scanf
+#include <stdint.h> // int16_t, int32_t
 
 // Other dependencies
 #include "matrices_errors.h"
@@ -17,17 +18,43 @@
 
 // Every operation has to be executed modulo MOD
 #define MOD 10007
+// The elements are always kept in (-MOD, MOD) - the input may be negative, and
+// C's remainder keeps the sign. For MOD <= 32768 (the default one included),
+// that fits in 16 bits, which halves the memory (and the bandwidth) used by
+// every matrix. Bigger moduli fall back to 32 bits. The kernels load the
+// elements in wider variables before doing any arithmetic on them.
+#if MOD <= 32768
+typedef int16_t matrix_elem;
+#else
+typedef int32_t matrix_elem;
+#endif
+
 // This is the initial size of the dynamically allocated array of matrices
 #define MIN_D_MATRICES_SIZE 4
 
 // The matrix structure
 typedef struct {
 	// The matrix elements will be stored in a (m x n) matrix called info
-	int **info;
-	// Its size is represented by the number of lines (m) and columns (n)
+	matrix_elem **info;
+	// Its size is represented by the number of lines (m) and columns (n).
+	// Every dimension fits in an int, but m * n (and any size in bytes) may
+	// not - those are always computed in size_t / long long (see safe_mul)
 	int m, n;
 	// The sum of all elements is updated everytime a change occours
 	int elem_sum;
+	// The number of matrices that use info (see 'matrices_shared'), or NULL if
+	// this is the only one. It has to be NULL when a matrix is created.
+	int *refs;
+	// The following fields are only used by the memory budget (see
+	// 'matrices_memory') and are set when a matrix is loaded in the array:
+	// spilled = 1 if info was moved to the spill file (info is NULL then)
+	int spilled;
+	// spill_offset = where the matrix is stored in the spill file (-1 = never
+	// written). The copy stays valid until the matrix is changed in place,
+	// which drops it (see mm_invalidate).
+	long long spill_offset;
+	// last_use = the moment the matrix was last touched by a command
+	unsigned long long last_use;
 } matrix;
 
 // Note: The following typedefs come as a result of the following issue:
@@ -0,0 +1,208 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "matrices_chain.h"
+
+// This function finds the cheapest order of a chain. It returns NULL if the
+// matrices can't be multiplied (or if there are more than CHAIN_MAX_LENGTH).
+chain_order_ptr chain_order_create(matrix_ptr *mats, int count)
+{
+	if (count < 1 || count > CHAIN_MAX_LENGTH)
+		return NULL;
+	for (int k = 0; k + 1 < count; ++k)
+		if (mats[k]->n != mats[k + 1]->m)
+			return NULL;
+
+	chain_order_ptr order = safe_malloc(sizeof(chain_order));
+	order->mats = mats;
+	order->count = count;
+	order->dims = safe_malloc(safe_mul(count + 1, sizeof(int)));
+	for (int k = 0; k < count; ++k)
+		order->dims[k] = mats[k]->m;
+	order->dims[count] = mats[count - 1]->n;
+
+	size_t cells = safe_mul(count, count);
+	order->split = safe_malloc(safe_mul(cells, sizeof(int)));
+	order->work = safe_malloc(safe_mul(cells, sizeof(double)));
+	order->peak = safe_malloc(safe_mul(cells, sizeof(double)));
+
+	// The work is counted in doubles: it can't overflow, and every count of
+	// multiplications that could ever be computed is still exact
+	int *p = order->dims;
+	for (int i = 0; i < count; ++i) {
+		order->work[(size_t)i * count + i] = 0;
+		order->peak[(size_t)i * count + i] = 0;
+	}
+	for (int len = 2; len <= count; ++len) {
+		for (int i = 0; i + len <= count; ++i) {
+			int j = i + len - 1;
+			size_t at = (size_t)i * count + j;
+			order->work[at] = -1;
+			for (int k = i; k < j; ++k) {
+				size_t left = (size_t)i * count + k;
+				size_t right = (size_t)(k + 1) * count + j;
+				double work = order->work[left] + order->work[right] +
+							  (double)p[i] * p[k + 1] * p[j + 1];
+
+				// The halves that aren't single matrices are intermediate
+				double peak = order->peak[left] > order->peak[right] ?
+							  order->peak[left] : order->peak[right];
+				if (k > i && (double)p[i] * p[k + 1] > peak)
+					peak = (double)p[i] * p[k + 1];
+				if (k + 1 < j && (double)p[k + 1] * p[j + 1] > peak)
+					peak = (double)p[k + 1] * p[j + 1];
+
+				if (order->work[at] < 0 || work < order->work[at] ||
+					(work == order->work[at] && peak < order->peak[at])) {
+					order->work[at] = work;
+					order->peak[at] = peak;
+					order->split[at] = k;
+				}
+			}
+		}
+	}
+
+	// The memory budget isn't shared between threads. The caller is one of
+	// the threads (see 'octave_topology' for how many of them may be used).
+	order->threads = mm_enabled() ? 0 : topo_threads(CHAIN_MAX_THREADS) - 1;
+	order->pinned = 0;
+	pthread_mutex_init(&order->lock, NULL);
+	return order;
+}
+
+// This function frees an order
+void chain_order_free(chain_order_ptr order)
+{
+	pthread_mutex_destroy(&order->lock);
+	free(order->dims);
+	free(order->split);
+	free(order->work);
+	free(order->peak);
+	free(order);
+}
+
+// This function returns the number of arithmetic operations of a chain (in
+// the order that was found)
+unsigned long long chain_order_flops(chain_order_ptr order)
+{
+	return 2ULL * (unsigned long long)order->work[order->count - 1];
+}
+
+// This function multiplies two matrices of the chain and, if it was asked for,
+// verifies the product (see 'matrices_verification')
+static matrix_ptr chain_product(matrix_ptr m1, matrix_ptr m2)
+{
+	unsigned long long start_ns = octave_stats_clock();
+	matrix_ptr rez = multiply_matrices(m1, m2);
+	if (verify_enabled())
+		rez = verify_product('N', -1, -1, m1, m2, rez,
+							 octave_stats_clock() - start_ns);
+	return rez;
+}
+
+// This utility computes the product of the matrices i, ..., j (i < j), in the
+// order that was found
+matrix_ptr chain_multiply_utility(chain_order_ptr order, int i, int j)
+{
+	int count = order->count;
+	int k = order->split[(size_t)i * count + j];
+
+	// If both halves are big enough, the first one is computed by another
+	// thread (if there are any left)
+	chain_job job = {order, i, k, NULL};
+	pthread_t thread;
+	int started = 0;
+	if (k > i && k + 1 < j &&
+		order->work[(size_t)i * count + k] >= CHAIN_THREAD_WORK &&
+		order->work[(size_t)(k + 1) * count + j] >= CHAIN_THREAD_WORK) {
+		pthread_mutex_lock(&order->lock);
+		if (order->threads > 0) {
+			--order->threads;
+			started = 1;
+		}
+		pthread_mutex_unlock(&order->lock);
+		if (started && pthread_create(&thread, NULL, chain_thread, &job)) {
+			started = 0;
+			pthread_mutex_lock(&order->lock);
+			++order->threads;
+			pthread_mutex_unlock(&order->lock);
+		}
+	}
+
+	matrix_ptr right = k + 1 < j ? chain_multiply_utility(order, k + 1, j)
+								 : order->mats[j];
+	matrix_ptr left;
+	if (started) {
+		pthread_join(thread, NULL);
+		left = job.result;
+		pthread_mutex_lock(&order->lock);
+		++order->threads;
+		pthread_mutex_unlock(&order->lock);
+	} else {
+		left = k > i ? chain_multiply_utility(order, i, k) : order->mats[i];
+	}
+
+	// The matrices of the chain are only read back (and pinned) while they are
+	// used; the intermediate ones are freed right away
+	if (k == i)
+		mm_touch(left);
+	if (k + 1 == j)
+		mm_touch(right);
+	matrix_ptr rez = chain_product(left, right);
+	if (k == i) {
+		mm_unpin(left);
+	} else {
+		free_matrix(left);
+		free(left);
+	}
+	if (k + 1 == j) {
+		mm_unpin(right);
+	} else {
+		free_matrix(right);
+		free(right);
+	}
+	return rez;
+}
+
+// This function is executed by the threads of a chain: it computes a part of
+// it
+void *chain_thread(void *arg)
+{
+	chain_job_ptr job = arg;
+
+	// The caller is the first thread, so the others are numbered from 1
+	pthread_mutex_lock(&job->order->lock);
+	int index = ++job->order->pinned;
+	pthread_mutex_unlock(&job->order->lock);
+	topo_pin(index);
+
+	job->result = chain_multiply_utility(job->order, job->i, job->j);
+	return NULL;
+}
+
+// This function multiplies a chain of matrices, in the cheapest order. It
+// returns NULL if the matrices can't be multiplied (see chain_order_create).
+// The result is a new matrix, even for a chain of one. If flops isn't NULL,
+// the number of arithmetic operations is added to it.
+matrix_ptr chain_multiply(matrix_ptr *mats, int count,
+						  unsigned long long *flops)
+{
+	if (count == 1) {
+		matrix_ptr mat = mats[0];
+		mm_touch(mat);
+		matrix_ptr rez = multiply_matrices_alloc_utility(mat->m, mat->n);
+		for (int i = 0; i < mat->m; ++i)
+			memcpy(rez->info[i], mat->info[i], mat->n * sizeof(matrix_elem));
+		rez->elem_sum = mat->elem_sum;
+		return rez;
+	}
+
+	chain_order_ptr order = chain_order_create(mats, count);
+	if (!order)
+		return NULL;
+	matrix_ptr rez = chain_multiply_utility(order, 0, count - 1);
+	if (flops)
+		*flops += chain_order_flops(order);
+	chain_order_free(order);
+	return rez;
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef MATRICES_CHAIN_H
+#define MATRICES_CHAIN_H
+
+// This file contains the product of a chain of matrices (A1 x A2 x ... x An).
+// The product is the same no matter where the parentheses go, but its cost
+// isn't: ((10 x 1000) x (1000 x 10)) x (10 x 1000) needs 200 times less work
+// than (10 x 1000) x ((1000 x 10) x (10 x 1000)). The classic dynamic
+// programming finds the cheapest order: cost[i][j] = the minimum of cost[i][k]
+// + cost[k + 1][j] + the cost of the last product, over every k. Ties are
+// broken by the size of the biggest intermediate matrix.
+//
+// The two halves of a product don't depend on each other, so the bigger ones
+// are computed by different threads (as many as 'octave_topology' allows).
+// Every intermediate matrix is freed as soon as it was used.
+
+// Standard library dependencies
+#include <pthread.h> // pthread_create, pthread_mutex_t
+#include <stdlib.h> // free
+#include <string.h> // memcpy
+
+// Other dependencies
+#include "matrices_base.h"
+#include "matrices_memory.h" // mm_touch, mm_unpin, mm_enabled
+#include "matrices_multiplication.h" // multiply_matrices
+#include "matrices_verification.h" // verify_product
+#include "octave_stats.h" // octave_stats_clock
+#include "octave_topology.h" // topo_threads, topo_pin
+#include "safe_utilities.h" // safe_malloc, safe_mul
+
+// The maximum number of threads that compute a chain
+#define CHAIN_MAX_THREADS 16
+// The longest chain that is accepted: finding its order needs count^2 cells
+// (20 MB here) and count^3 / 6 steps
+#define CHAIN_MAX_LENGTH 1024
+// The halves that need less multiplications than this are computed by the
+// same thread
+#define CHAIN_THREAD_WORK (1LL << 24)
+
+// The order in which a chain is multiplied
+typedef struct {
+	// The chain (count matrices); the k-th one is (dims[k] x dims[k + 1])
+	matrix_ptr *mats;
+	int count;
+	int *dims;
+	// split[i * count + j] = the last product of the matrices i, ..., j is
+	// (i, ..., k) x (k + 1, ..., j)
+	int *split;
+	// The number of multiplications of [i, j] (the arithmetic operations are
+	// twice as many) and the elements of its biggest intermediate matrix
+	// (work[i * count + j], peak[i * count + j])
+	double *work, *peak;
+	// threads = the number of threads that may still be started; pinned = the
+	// number of threads that were started (every one of them is pinned to
+	// its own CPU, see topo_pin)
+	int threads, pinned;
+	pthread_mutex_t lock;
+} chain_order;
+
+// A part of the chain that is computed by another thread
+typedef struct {
+	chain_order *order;
+	int i, j;
+	matrix_ptr result;
+} chain_job;
+
+// Note: The following typedefs are kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef chain_order * chain_order_ptr;
+typedef chain_job * chain_job_ptr;
+
+// This function finds the cheapest order of a chain. It returns NULL if the
+// matrices can't be multiplied (or if there are more than CHAIN_MAX_LENGTH).
+extern chain_order_ptr chain_order_create(matrix_ptr *mats, int count);
+
+// This function frees an order
+extern void chain_order_free(chain_order_ptr order);
+
+// This function returns the number of arithmetic operations of a chain (in
+// the order that was found)
+extern unsigned long long chain_order_flops(chain_order_ptr order);
+
+// This utility computes the product of the matrices i, ..., j (i < j), in the
+// order that was found
+extern matrix_ptr chain_multiply_utility(chain_order_ptr order, int i, int j);
+
+// This function is executed by the threads of a chain: it computes a part of
+// it
+extern void *chain_thread(void *arg);
+
+// This function multiplies a chain of matrices, in the cheapest order. It
+// returns NULL if the matrices can't be multiplied (see chain_order_create).
+// The result is a new matrix, even for a chain of one. If flops isn't NULL,
+// the number of arithmetic operations is added to it.
+extern matrix_ptr chain_multiply(matrix_ptr *mats, int count,
+								 unsigned long long *flops);
+
+#endif // MATRICES_CHAIN_H
@@ -0,0 +1,480 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Sockets, getaddrinfo and fork are POSIX features
+#define _POSIX_C_SOURCE 200809L
+
+// Include the asscociated header file
+#include "matrices_distributed.h"
+
+// Standard library dependencies
+#include <errno.h> // errno, EINTR
+#include <netdb.h> // getaddrinfo, freeaddrinfo
+#include <netinet/in.h> // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <string.h> // strchr, strrchr, memcpy
+#include <sys/socket.h> // socket, connect, bind, listen, send, recv
+#include <sys/wait.h> // waitpid
+#include <unistd.h> // fork, close, _exit
+
+// The workers are shared by the whole program
+static matrices_distributed dist;
+
+// These functions send / receive exactly len bytes. They return 0 on failure.
+static int dist_send(int fd, const void *data, size_t len)
+{
+	const char *p = data;
+	while (len) {
+		ssize_t w = send(fd, p, len, MSG_NOSIGNAL);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w <= 0)
+			return 0;
+		p += w;
+		len -= w;
+	}
+	return 1;
+}
+
+static int dist_recv(int fd, void *data, size_t len)
+{
+	char *p = data;
+	while (len) {
+		ssize_t r = recv(fd, p, len, 0);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			return 0;
+		p += r;
+		len -= r;
+	}
+	return 1;
+}
+
+// This function sends a message header
+static int dist_send_header(int fd, int type, int a, int b)
+{
+	dist_header h = {type, a, b};
+	return dist_send(fd, &h, sizeof(h));
+}
+
+// This function connects to a worker (HOST:PORT). It returns -1 on failure.
+static int dist_connect(const char *address)
+{
+	char host[256];
+	const char *port = strrchr(address, ':');
+	if (!port || port - address >= (long)sizeof(host)) {
+		fprintf(stderr, "Invalid worker address: %s\n", address);
+		return -1;
+	}
+	memcpy(host, address, port - address);
+	host[port - address] = '\0';
+
+	struct addrinfo hints, *res;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, port + 1, &hints, &res)) {
+		fprintf(stderr, "Unknown worker: %s\n", address);
+		return -1;
+	}
+
+	int fd = -1;
+	for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(res);
+	if (fd < 0) {
+		fprintf(stderr, "Could not connect to the worker: %s\n", address);
+		return -1;
+	}
+
+	// The headers are small, they shouldn't wait for the next panel
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+// This function starts a worker process on this machine. It returns the
+// coordinator's end of the socket, or -1 on failure.
+static int dist_spawn(void)
+{
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+		perror("socketpair");
+		return -1;
+	}
+
+	// Nothing was written to stdout yet, so the child can't output it again
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+
+	if (!pid) {
+		// The worker only keeps its end of the socket (and its own CPU, if the
+		// workers are pinned)
+		topo_pin(dist.pids_count);
+		close(sv[0]);
+		for (int i = 0; i < dist.count; ++i)
+			close(dist.fds[i]);
+		_exit(dist_serve(sv[1]) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(sv[1]);
+	dist.pids[dist.pids_count++] = pid;
+	return sv[0];
+}
+
+// This function checks that a worker uses the same MOD. It returns 0 if it
+// doesn't (or if it didn't answer).
+static int dist_hello(int fd)
+{
+	dist_header h;
+	if (!dist_send_header(fd, DIST_HELLO, MOD, 0) ||
+		!dist_recv(fd, &h, sizeof(h)) || h.type != DIST_HELLO) {
+		fprintf(stderr, "A worker didn't answer\n");
+		return 0;
+	}
+	if (h.a != MOD) {
+		fprintf(stderr, "A worker uses a different MOD (%d)\n", h.a);
+		return 0;
+	}
+	return 1;
+}
+
+// This function connects to the workers. workers is a list of HOST:PORT
+// addresses separated by commas (or NULL); local is the number of worker
+// processes started on this machine. It returns 0 on failure.
+int dist_init(const char *workers, int local)
+{
+	dist.count = 0;
+	dist.pids_count = 0;
+	pthread_mutex_init(&dist.lock, NULL);
+
+	while (workers && *workers) {
+		char address[512];
+		const char *end = strchr(workers, ',');
+		size_t len = end ? (size_t)(end - workers) : strlen(workers);
+		if (len >= sizeof(address) || dist.count == DIST_MAX_WORKERS) {
+			fprintf(stderr, "Invalid list of workers\n");
+			return 0;
+		}
+		memcpy(address, workers, len);
+		address[len] = '\0';
+		workers = end ? end + 1 : workers + len;
+
+		int fd = dist_connect(address);
+		if (fd < 0)
+			return 0;
+		dist.fds[dist.count++] = fd;
+		if (!dist_hello(fd))
+			return 0;
+	}
+
+	for (int i = 0; i < local; ++i) {
+		if (dist.count == DIST_MAX_WORKERS) {
+			fprintf(stderr, "Too many workers (at most %d)\n",
+					DIST_MAX_WORKERS);
+			return 0;
+		}
+		int fd = dist_spawn();
+		if (fd < 0)
+			return 0;
+		dist.fds[dist.count++] = fd;
+		if (!dist_hello(fd))
+			return 0;
+	}
+
+	// The grid should be as square as possible, so that every worker receives
+	// as little data as possible: rows = the biggest divisor <= sqrt(count)
+	dist.grid_rows = 1;
+	for (int r = 1; r * r <= dist.count; ++r)
+		if (dist.count % r == 0)
+			dist.grid_rows = r;
+	dist.grid_cols = dist.count ? dist.count / dist.grid_rows : 0;
+	return 1;
+}
+
+// This function returns 1 if the product of a (m x n) and a (n x p) matrix
+// should be computed by the workers
+int dist_worth(int m, int n, int p)
+{
+	return dist.count && (long long)m * n * p >= DIST_MIN_WORK;
+}
+
+// This function is called when a worker fails in the middle of a product.
+// Every worker is disconnected - the products are computed locally from now on.
+static void dist_fail(void)
+{
+	fprintf(stderr, "A worker failed; the products are computed locally\n");
+	for (int i = 0; i < dist.count; ++i)
+		close(dist.fds[i]);
+	dist.count = 0;
+}
+
+// This function multiplies two matrices using the workers. If a worker fails,
+// the workers are disconnected and NULL is returned (the caller computes the
+// product by itself).
+matrix_ptr dist_multiply(matrix_ptr m1, matrix_ptr m2)
+{
+	pthread_mutex_lock(&dist.lock);
+	if (!dist.count) {
+		pthread_mutex_unlock(&dist.lock);
+		return NULL;
+	}
+
+	int m = m1->m, n = m1->n, p = m2->n;
+	int rows = dist.grid_rows, cols = dist.grid_cols;
+
+	// Worker (i, j) computes lines [r[i], r[i + 1]) and columns
+	// [c[j], c[j + 1]) of the result. Workers with an empty block are skipped.
+	int r[DIST_MAX_WORKERS + 1], c[DIST_MAX_WORKERS + 1];
+	for (int i = 0; i <= rows; ++i)
+		r[i] = (int)((long long)m * i / rows);
+	for (int j = 0; j <= cols; ++j)
+		c[j] = (int)((long long)p * j / cols);
+
+	int ok = 1;
+	for (int i = 0; i < rows && ok; ++i)
+		for (int j = 0; j < cols && ok; ++j)
+			if (r[i + 1] > r[i] && c[j + 1] > c[j])
+				ok = dist_send_header(dist.fds[i * cols + j], DIST_BEGIN,
+									  r[i + 1] - r[i], c[j + 1] - c[j]);
+
+	// The panels are sent to every worker in turn, so all of them compute
+	// while the next ones are sent
+	int max_rows = (m + rows - 1) / rows, max_cols = (p + cols - 1) / cols;
+	int32_t *buf = safe_malloc((size_t)(max_rows + max_cols) * DIST_PANEL *
+							   sizeof(int32_t));
+	for (int k0 = 0; k0 < n && ok; k0 += DIST_PANEL) {
+		int kb = n - k0 < DIST_PANEL ? n - k0 : DIST_PANEL;
+		for (int i = 0; i < rows && ok; ++i) {
+			for (int j = 0; j < cols && ok; ++j) {
+				int br = r[i + 1] - r[i], bc = c[j + 1] - c[j];
+				if (!br || !bc)
+					continue;
+
+				// The worker's lines of the first matrix, then its columns of
+				// the second one
+				int32_t *at = buf;
+				for (int x = r[i]; x < r[i + 1]; ++x)
+					for (int k = k0; k < k0 + kb; ++k)
+						*at++ = m1->info[x][k];
+				for (int k = k0; k < k0 + kb; ++k)
+					for (int y = c[j]; y < c[j + 1]; ++y)
+						*at++ = m2->info[k][y];
+
+				int fd = dist.fds[i * cols + j];
+				ok = dist_send_header(fd, DIST_PANEL_DATA, kb, 0) &&
+					 dist_send(fd, buf, (at - buf) * sizeof(int32_t));
+			}
+		}
+	}
+	free(buf);
+
+	// Collect the blocks of the result
+	matrix_ptr mat = safe_malloc(sizeof(matrix));
+	mat->m = m;
+	mat->n = p;
+	mat->refs = NULL;
+	mat->info = alloc_matrix_lines(m, p);
+
+	buf = safe_malloc((size_t)max_cols * sizeof(int32_t));
+	for (int i = 0; i < rows && ok; ++i) {
+		for (int j = 0; j < cols && ok; ++j) {
+			int fd = dist.fds[i * cols + j], bc = c[j + 1] - c[j];
+			if (r[i + 1] == r[i] || !bc)
+				continue;
+
+			ok = dist_send_header(fd, DIST_END, 0, 0);
+			for (int x = r[i]; x < r[i + 1] && ok; ++x) {
+				ok = dist_recv(fd, buf, bc * sizeof(int32_t));
+				for (int y = 0; y < bc && ok; ++y)
+					mat->info[x][c[j] + y] = (matrix_elem)buf[y];
+			}
+		}
+	}
+	free(buf);
+
+	if (!ok) {
+		dist_fail();
+		pthread_mutex_unlock(&dist.lock);
+		free_matrix(mat);
+		free(mat);
+		return NULL;
+	}
+	pthread_mutex_unlock(&dist.lock);
+
+	// The sum of the elements has to be computed at the end, since it has been
+	// lost during the operations
+	matrix_update_sum(mat);
+	return mat;
+}
+
+// This function serves a single coordinator (on the given socket) until it
+// sends DIST_QUIT or disconnects. It returns 0 on failure.
+int dist_serve(int fd)
+{
+	// The worker's block of the result, which is accumulated in long longs
+	long long *acc = NULL;
+	int rows = 0, cols = 0;
+	// The current panel
+	int32_t *a = NULL, *b = NULL;
+	int ok = 1;
+
+	dist_header h;
+	while (ok && dist_recv(fd, &h, sizeof(h))) {
+		if (h.type == DIST_HELLO) {
+			ok = dist_send_header(fd, DIST_HELLO, MOD, 0);
+		} else if (h.type == DIST_BEGIN) {
+			// The sizes come from the network, so they are checked before
+			// anything is allocated (or received)
+			if (h.a <= 0 || h.b <= 0) {
+				fprintf(stderr, "Invalid block size from the coordinator\n");
+				ok = 0;
+				break;
+			}
+			rows = h.a;
+			cols = h.b;
+			free(acc);
+			size_t bytes = safe_mul((long long)rows * cols, sizeof(long long));
+			acc = safe_malloc(bytes);
+			memset(acc, 0, bytes);
+			a = safe_realloc(a, safe_mul((long long)rows * DIST_PANEL,
+										 sizeof(int32_t)));
+			b = safe_realloc(b, safe_mul((long long)cols * DIST_PANEL,
+										 sizeof(int32_t)));
+		} else if (h.type == DIST_PANEL_DATA && acc) {
+			if (h.a <= 0 || h.a > DIST_PANEL) {
+				fprintf(stderr, "Invalid panel width from the coordinator\n");
+				ok = 0;
+				break;
+			}
+			int kb = h.a;
+			ok = dist_recv(fd, a, (size_t)rows * kb * sizeof(int32_t)) &&
+				 dist_recv(fd, b, (size_t)kb * cols * sizeof(int32_t));
+
+			// acc += a x b, in the i-k-j order. Every product is smaller than
+			// MOD^2, so a whole panel fits before the reduction.
+			for (int i = 0; i < rows && ok; ++i) {
+				long long *line = acc + (size_t)i * cols;
+				for (int k = 0; k < kb; ++k) {
+					long long aik = a[(size_t)i * kb + k];
+					const int32_t *bk = b + (size_t)k * cols;
+					for (int j = 0; j < cols; ++j)
+						line[j] += aik * bk[j];
+				}
+				for (int j = 0; j < cols; ++j)
+					line[j] %= MOD;
+			}
+		} else if (h.type == DIST_END && acc) {
+			// The block is sent line by line, reduced to [0, MOD)
+			int32_t *line = safe_malloc((size_t)cols * sizeof(int32_t));
+			for (int i = 0; i < rows && ok; ++i) {
+				const long long *block = acc + (size_t)i * cols;
+				for (int j = 0; j < cols; ++j)
+					line[j] = (int32_t)((block[j] + MOD) % MOD);
+				ok = dist_send(fd, line, (size_t)cols * sizeof(int32_t));
+			}
+			free(line);
+			free(acc);
+			acc = NULL;
+		} else if (h.type == DIST_QUIT) {
+			break;
+		} else {
+			fprintf(stderr, "Unexpected message from the coordinator\n");
+			ok = 0;
+		}
+	}
+
+	free(acc);
+	free(a);
+	free(b);
+	close(fd);
+	return ok;
+}
+
+// This function runs a worker process, which listens on [HOST:]PORT and serves
+// the coordinators, one at a time
+int dist_worker_run(const char *address)
+{
+	char host[256] = "";
+	const char *port = strrchr(address, ':');
+	if (port) {
+		if (port - address >= (long)sizeof(host)) {
+			fprintf(stderr, "Invalid worker address: %s\n", address);
+			return EXIT_FAILURE;
+		}
+		memcpy(host, address, port - address);
+		host[port - address] = '\0';
+		++port;
+	} else {
+		port = address;
+	}
+
+	struct addrinfo hints, *res;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(*host ? host : NULL, port, &hints, &res)) {
+		fprintf(stderr, "Invalid worker address: %s\n", address);
+		return EXIT_FAILURE;
+	}
+
+	int fd = -1, one = 1;
+	for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0 || listen(fd, 1) < 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(res);
+	if (fd < 0) {
+		perror(address);
+		return EXIT_FAILURE;
+	}
+
+	// A coordinator that fails doesn't stop the worker
+	while (1) {
+		int client = accept(fd, NULL, NULL);
+		if (client < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			break;
+		}
+		setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		dist_serve(client);
+	}
+
+	close(fd);
+	return EXIT_FAILURE;
+}
+
+// This function stops the workers and disconnects from them
+void dist_free(void)
+{
+	for (int i = 0; i < dist.count; ++i) {
+		dist_send_header(dist.fds[i], DIST_QUIT, 0, 0);
+		close(dist.fds[i]);
+	}
+	dist.count = 0;
+
+	for (int i = 0; i < dist.pids_count; ++i)
+		waitpid(dist.pids[i], NULL, 0);
+	dist.pids_count = 0;
+	pthread_mutex_destroy(&dist.lock);
+}
@@ -0,0 +1,90 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef MATRICES_DISTRIBUTED_H
+#define MATRICES_DISTRIBUTED_H
+
+// This file contains the distributed multiplication. The program that holds
+// the matrices (the coordinator) is connected to a number of worker processes,
+// either on other machines (--workers=HOST:PORT,...) or on the same one
+// (--local-workers=N). Big products are split SUMMA-style: the workers are
+// arranged in a (rows x cols) grid and every worker computes a block of the
+// result. The operands are sent in panels (DIST_PANEL columns of the first
+// matrix and the matching lines of the second one), so a worker starts
+// computing before the whole operands are sent, and it only ever holds its
+// block of the result and a single panel. Without any worker, every function
+// in this file returns right away.
+//
+// The messages are sent in the machine's byte order, so every node has to use
+// the same one (and the same MOD, which is checked when connecting).
+
+// Standard library dependencies
+#include <pthread.h> // pthread_mutex_t
+#include <stdint.h> // int32_t
+#include <stdio.h> // fprintf
+#include <stdlib.h> // free
+
+// Other dependencies
+#include "matrices_base.h"
+#include "matrices_shared.h" // alloc_matrix_lines
+#include "octave_topology.h" // topo_pin
+#include "safe_utilities.h" // safe_malloc
+
+// The maximum number of workers
+#define DIST_MAX_WORKERS 64
+// The number of columns (lines) of the first (second) matrix in a panel
+#define DIST_PANEL 256
+// Products with fewer multiplications than this are computed locally
+#define DIST_MIN_WORK (128LL * 128 * 128)
+
+// The messages exchanged by the coordinator and the workers
+#define DIST_HELLO 1 // a = MOD (both ways)
+#define DIST_BEGIN 2 // a x b = the size of the worker's block of the result
+#define DIST_PANEL_DATA 3 // a = the panel's width, then both operands' parts
+#define DIST_END 4 // the worker answers with its block of the result
+#define DIST_QUIT 5 // the coordinator is done
+
+// Every message starts with this header
+typedef struct {
+	int32_t type, a, b;
+} dist_header;
+
+// The distributed multiplication structure (there is a single one per program)
+typedef struct {
+	// The sockets connected to the workers
+	int fds[DIST_MAX_WORKERS];
+	int count;
+	// The processes started by --local-workers
+	int pids[DIST_MAX_WORKERS];
+	int pids_count;
+	// The grid of workers (grid_rows x grid_cols <= count)
+	int grid_rows, grid_cols;
+	// The workers compute a single product at a time (see 'octave_server')
+	pthread_mutex_t lock;
+} matrices_distributed;
+
+// This function connects to the workers. workers is a list of HOST:PORT
+// addresses separated by commas (or NULL); local is the number of worker
+// processes started on this machine. It returns 0 on failure.
+extern int dist_init(const char *workers, int local);
+
+// This function returns 1 if the product of a (m x n) and a (n x p) matrix
+// should be computed by the workers
+extern int dist_worth(int m, int n, int p);
+
+// This function multiplies two matrices using the workers. If a worker fails,
+// the workers are disconnected and NULL is returned (the caller computes the
+// product by itself).
+extern matrix_ptr dist_multiply(matrix_ptr m1, matrix_ptr m2);
+
+// This function serves a single coordinator (on the given socket) until it
+// sends DIST_QUIT or disconnects. It returns 0 on failure.
+extern int dist_serve(int fd);
+
+// This function runs a worker process, which listens on [HOST:]PORT and serves
+// the coordinators, one at a time
+extern int dist_worker_run(const char *address);
+
+// This function stops the workers and disconnects from them
+extern void dist_free(void);
+
+#endif // MATRICES_DISTRIBUTED_H
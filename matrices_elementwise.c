@@ -0,0 +1,264 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "matrices_elementwise.h"
+
+// This function returns x op y (or k * x), in [0, MOD)
+static int elementwise_scalar(int x, int y, int k, int op)
+{
+	long long r;
+	switch (op) {
+	case ELEMENTWISE_ADD:
+		r = (long long)x + y;
+		break;
+	case ELEMENTWISE_SUBTRACT:
+		r = (long long)x - y;
+		break;
+	case ELEMENTWISE_HADAMARD:
+		r = (long long)x * y;
+		break;
+	default:
+		r = (long long)k * x;
+		break;
+	}
+	r %= MOD;
+	return (int)(r < 0 ? r + MOD : r);
+}
+
+#ifdef ELEMENTWISE_SIMD
+// This function returns MOD^-1 modulo 2^16 (Newton's method doubles the number
+// of correct bits every step, and MOD is its own inverse modulo 8)
+static int elementwise_qinv(void)
+{
+	unsigned int inv = MOD;
+	for (int step = 0; step < 3; ++step)
+		inv *= 2 - MOD * inv;
+	return (int)(short)(inv & 0xffff);
+}
+
+// This function moves every element of v from (-MOD, MOD) to [0, MOD)
+static elementwise_vec elementwise_canonical(elementwise_vec v,
+											 elementwise_vec mod)
+{
+	return elementwise_add(v, elementwise_and(elementwise_cmpgt(
+		elementwise_zero(), v), mod));
+}
+
+// This function returns a b 2^-16 (modulo MOD), in (-MOD, MOD). The low halves
+// of a b and t MOD are the same, so their high halves can be subtracted.
+static elementwise_vec elementwise_montgomery(elementwise_vec a,
+											  elementwise_vec b,
+											  elementwise_vec qinv,
+											  elementwise_vec mod)
+{
+	elementwise_vec t = elementwise_mullo(elementwise_mullo(a, b), qinv);
+	return elementwise_sub(elementwise_mulhi(a, b), elementwise_mulhi(t, mod));
+}
+#endif
+
+// This utility computes dst = x op y for n elements (n <= ELEMENTWISE_CHUNK;
+// dst may be x or y) and returns the sum of dst. k is only used by
+// ELEMENTWISE_SCALE and has to be in [0, MOD).
+int elementwise_line_utility(matrix_elem *dst, const matrix_elem *x,
+							 const matrix_elem *y, int k, int n, int op)
+{
+	int j = 0, sum = 0;
+#ifdef ELEMENTWISE_SIMD
+	elementwise_vec mod = elementwise_set1(MOD);
+	elementwise_vec top = elementwise_set1(MOD - 1);
+	elementwise_vec ones = elementwise_set1(1);
+	elementwise_vec qinv = elementwise_set1((short)elementwise_qinv());
+	// 2^32 turns mont(mont(a, b), .) back into a b; k 2^16 turns mont(a, .)
+	// into k a
+	elementwise_vec r2 = elementwise_set1((short)((1ULL << 32) % MOD));
+	elementwise_vec kr = elementwise_set1((short)((long long)k *
+												  (1 << 16) % MOD));
+	// The results are added up in pairs (pmaddwd), in 32-bit lanes
+	elementwise_vec acc = elementwise_zero();
+	for (; j + ELEMENTWISE_LANES <= n; j += ELEMENTWISE_LANES) {
+		elementwise_vec a = elementwise_load(x + j), r;
+		switch (op) {
+		case ELEMENTWISE_ADD:
+			r = elementwise_add(elementwise_canonical(a, mod),
+								elementwise_canonical(elementwise_load(y + j),
+													  mod));
+			r = elementwise_sub(r, elementwise_and(elementwise_cmpgt(r, top),
+												   mod));
+			break;
+		case ELEMENTWISE_SUBTRACT:
+			r = elementwise_sub(elementwise_canonical(a, mod),
+								elementwise_canonical(elementwise_load(y + j),
+													  mod));
+			r = elementwise_canonical(r, mod);
+			break;
+		case ELEMENTWISE_HADAMARD:
+			r = elementwise_montgomery(a, elementwise_load(y + j), qinv, mod);
+			r = elementwise_canonical(elementwise_montgomery(r, r2, qinv, mod),
+									  mod);
+			break;
+		default:
+			r = elementwise_canonical(elementwise_montgomery(a, kr, qinv, mod),
+									  mod);
+			break;
+		}
+		elementwise_store(dst + j, r);
+		acc = elementwise_add32(acc, elementwise_madd(r, ones));
+	}
+	int lanes[ELEMENTWISE_LANES / 2];
+	elementwise_store(lanes, acc);
+	for (int s = 0; s < ELEMENTWISE_LANES / 2; ++s)
+		sum += lanes[s];
+#endif
+	// The last few elements (or all of them, without vectors)
+	for (; j < n; ++j) {
+		dst[j] = (matrix_elem)elementwise_scalar(x[j], y ? y[j] : 0, k, op);
+		sum += dst[j];
+	}
+	return sum;
+}
+
+// This function returns the sum of n elements (n <= ELEMENTWISE_CHUNK)
+static int elementwise_sum_utility(const matrix_elem *x, int n)
+{
+	int j = 0, sum = 0;
+#ifdef ELEMENTWISE_SIMD
+	elementwise_vec ones = elementwise_set1(1), acc = elementwise_zero();
+	for (; j + ELEMENTWISE_LANES <= n; j += ELEMENTWISE_LANES)
+		acc = elementwise_add32(acc, elementwise_madd(elementwise_load(x + j),
+													  ones));
+	int lanes[ELEMENTWISE_LANES / 2];
+	elementwise_store(lanes, acc);
+	for (int s = 0; s < ELEMENTWISE_LANES / 2; ++s)
+		sum += lanes[s];
+#endif
+	for (; j < n; ++j)
+		sum += x[j];
+	return sum;
+}
+
+// This utility computes dst = m1 op m2 (dst is already allocated and may be
+// m1) and its sum
+void elementwise_matrices_utility(matrix_ptr dst, matrix_ptr m1,
+								  matrix_ptr m2, int op, int k)
+{
+	long long sum = 0;
+	for (int i = 0; i < (m1->m); ++i) {
+		for (int j0 = 0; j0 < (m1->n); j0 += ELEMENTWISE_CHUNK) {
+			int n = m1->n - j0 < ELEMENTWISE_CHUNK ? m1->n - j0
+												   : ELEMENTWISE_CHUNK;
+			sum += elementwise_line_utility(dst->info[i] + j0,
+											m1->info[i] + j0,
+											op == ELEMENTWISE_SCALE ? NULL :
+											m2->info[i] + j0, k, n, op);
+		}
+		sum %= MOD;
+	}
+	dst->elem_sum = (int)sum;
+}
+
+// This function returns m1 op m2 (m2 isn't used by ELEMENTWISE_SCALE, which
+// multiplies m1 by k), or NULL if the sizes of the matrices are different
+matrix_ptr elementwise_matrices(matrix_ptr m1, matrix_ptr m2, int op, int k)
+{
+	if (op != ELEMENTWISE_SCALE && (m1->m != m2->m || m1->n != m2->n))
+		return NULL;
+
+	matrix_ptr mat = multiply_matrices_alloc_utility(m1->m, m1->n);
+	elementwise_matrices_utility(mat, m1, m2, op, (k % MOD + MOD) % MOD);
+	return mat;
+}
+
+// This function computes m1 = m1 op m2 in place, without allocating anything
+// (unless m1's content is shared, see 'matrices_shared' - it is copied first).
+// m1 has to be resident (see mm_touch). It returns 0 if the sizes of the
+// matrices are different.
+int elementwise_matrices_inplace(matrix_ptr m1, matrix_ptr m2, int op, int k)
+{
+	if (op != ELEMENTWISE_SCALE && (m1->m != m2->m || m1->n != m2->n))
+		return 0;
+
+	// The other users of m1's content keep the old one, and the copy in the
+	// spill file (if any) isn't valid anymore
+	unshare_matrix(m1);
+	mm_invalidate(m1);
+	elementwise_matrices_utility(m1, m1, m2, op, (k % MOD + MOD) % MOD);
+	return 1;
+}
+
+// This function returns the sums of every line of a matrix, as a column
+matrix_ptr sum_lines_matrix(matrix_ptr mat)
+{
+	matrix_ptr rez = multiply_matrices_alloc_utility(mat->m, 1);
+	for (int i = 0; i < (mat->m); ++i) {
+		long long sum = 0;
+		for (int j0 = 0; j0 < (mat->n); j0 += ELEMENTWISE_CHUNK)
+			sum += elementwise_sum_utility(mat->info[i] + j0,
+										   mat->n - j0 < ELEMENTWISE_CHUNK ?
+										   mat->n - j0 : ELEMENTWISE_CHUNK);
+		rez->info[i][0] = (matrix_elem)((sum % MOD + MOD) % MOD);
+	}
+
+	// Every element is still added up exactly once
+	rez->elem_sum = (mat->elem_sum % MOD + MOD) % MOD;
+	return rez;
+}
+
+// This function adds the lines x0 and x1 (NULL = a line of zeros) to acc. The
+// two lines are interleaved, so pmaddwd adds up the elements of a column.
+static void elementwise_columns_utility(int *acc, const matrix_elem *x0,
+										const matrix_elem *x1, int n)
+{
+	int j = 0;
+#ifdef ELEMENTWISE_SIMD
+	elementwise_vec ones = elementwise_set1(1);
+	for (; j + ELEMENTWISE_LANES <= n; j += ELEMENTWISE_LANES) {
+		elementwise_vec a = elementwise_load(x0 + j);
+		elementwise_vec b = x1 ? elementwise_load(x1 + j) : elementwise_zero();
+		elementwise_vec lo = elementwise_madd(elementwise_unpacklo(a, b), ones);
+		elementwise_vec hi = elementwise_madd(elementwise_unpackhi(a, b), ones);
+#ifdef __AVX2__
+		// The unpacks work on each half of the vectors, so lo has the columns
+		// 0-3 and 8-11, while hi has 4-7 and 12-15
+		elementwise_vec first = _mm256_permute2x128_si256(lo, hi, 0x20);
+		hi = _mm256_permute2x128_si256(lo, hi, 0x31);
+		lo = first;
+#endif
+		elementwise_store(acc + j, elementwise_add32(elementwise_load(acc + j),
+													 lo));
+		elementwise_store(acc + j + ELEMENTWISE_LANES / 2,
+						  elementwise_add32(elementwise_load(acc + j +
+															 ELEMENTWISE_LANES /
+															 2), hi));
+	}
+#endif
+	for (; j < n; ++j)
+		acc[j] += x0[j] + (x1 ? x1[j] : 0);
+}
+
+// This function returns the sums of every column of a matrix, as a line. The
+// lines are added up two at a time, in ints that are reduced every
+// ELEMENTWISE_CHUNK lines.
+matrix_ptr sum_columns_matrix(matrix_ptr mat)
+{
+	int n = mat->n, lines = 0;
+	int *acc = safe_malloc(safe_mul(n, sizeof(int)));
+	for (int j = 0; j < n; ++j)
+		acc[j] = 0;
+	for (int i = 0; i < (mat->m); i += 2) {
+		elementwise_columns_utility(acc, mat->info[i], i + 1 < mat->m ?
+									mat->info[i + 1] : NULL, n);
+		lines += 2;
+		if (lines >= ELEMENTWISE_CHUNK - 2) {
+			for (int j = 0; j < n; ++j)
+				acc[j] %= MOD;
+			lines = 0;
+		}
+	}
+
+	matrix_ptr rez = multiply_matrices_alloc_utility(1, n);
+	for (int j = 0; j < n; ++j)
+		rez->info[0][j] = (matrix_elem)((acc[j] % MOD + MOD) % MOD);
+	rez->elem_sum = (mat->elem_sum % MOD + MOD) % MOD;
+	free(acc);
+	return rez;
+}
@@ -0,0 +1,116 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef MATRICES_ELEMENTWISE_H
+#define MATRICES_ELEMENTWISE_H
+
+// This file contains the element-wise operations (the sum, the difference and
+// the Hadamard product of two matrices of the same size, a matrix multiplied
+// by a number) and the sums of every line / column of a matrix. The results
+// are always in [0, MOD), and their sum is computed while they are written,
+// so matrix_update_sum is never needed.
+//
+// The elements are processed a vector at a time (SSE2 or AVX2). The products
+// are reduced with Montgomery's method, which only needs 16-bit multiplies:
+// mont(a, b) = a b 2^-16 (modulo MOD), so a b = mont(mont(a, b), 2^32) and
+// k a = mont(a, k 2^16). This requires an odd MOD; the sums also have to fit
+// in 16 bits, hence MOD < 16384 (the default one included). Anything else
+// falls back to plain C.
+
+// Standard library dependencies
+#include <limits.h> // INT_MAX
+#include <stdlib.h> // free
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h> // _mm_mulhi_epi16, _mm256_mulhi_epi16
+#endif
+
+// Other dependencies
+#include "matrices_base.h"
+#include "matrices_memory.h" // mm_invalidate
+#include "matrices_multiplication.h" // multiply_matrices_alloc_utility
+#include "matrices_shared.h" // unshare_matrix
+#include "safe_utilities.h" // safe_malloc, safe_mul
+
+// The error of the element-wise commands (see 'matrices_errors')
+#define INVALID_ELEMENTWISE "Cannot perform element-wise operation\n"
+
+// The operations
+#define ELEMENTWISE_ADD 0 // x + y
+#define ELEMENTWISE_SUBTRACT 1 // x - y
+#define ELEMENTWISE_HADAMARD 2 // x * y
+#define ELEMENTWISE_SCALE 3 // k * x (y isn't used)
+
+// The sums of this many elements (each in (-MOD, MOD)) fit in an int
+#define ELEMENTWISE_CHUNK (INT_MAX / MOD < (1 << 16) ? INT_MAX / MOD \
+													 : (1 << 16))
+
+// The vectors of 16-bit elements
+#if MOD % 2 == 1 && MOD < 16384 && (defined(__AVX2__) || defined(__SSE2__))
+#define ELEMENTWISE_SIMD
+#ifdef __AVX2__
+#define ELEMENTWISE_LANES 16
+typedef __m256i elementwise_vec;
+#define elementwise_load(p) _mm256_loadu_si256((const __m256i *)(p))
+#define elementwise_store(p, v) _mm256_storeu_si256((__m256i *)(p), v)
+#define elementwise_set1 _mm256_set1_epi16
+#define elementwise_zero _mm256_setzero_si256
+#define elementwise_add _mm256_add_epi16
+#define elementwise_sub _mm256_sub_epi16
+#define elementwise_and _mm256_and_si256
+#define elementwise_cmpgt _mm256_cmpgt_epi16
+#define elementwise_mullo _mm256_mullo_epi16
+#define elementwise_mulhi _mm256_mulhi_epi16
+#define elementwise_madd _mm256_madd_epi16
+#define elementwise_add32 _mm256_add_epi32
+#define elementwise_unpacklo _mm256_unpacklo_epi16
+#define elementwise_unpackhi _mm256_unpackhi_epi16
+#else
+#define ELEMENTWISE_LANES 8
+typedef __m128i elementwise_vec;
+#define elementwise_load(p) _mm_loadu_si128((const __m128i *)(p))
+#define elementwise_store(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define elementwise_set1 _mm_set1_epi16
+#define elementwise_zero _mm_setzero_si128
+#define elementwise_add _mm_add_epi16
+#define elementwise_sub _mm_sub_epi16
+#define elementwise_and _mm_and_si128
+#define elementwise_cmpgt _mm_cmpgt_epi16
+#define elementwise_mullo _mm_mullo_epi16
+#define elementwise_mulhi _mm_mulhi_epi16
+#define elementwise_madd _mm_madd_epi16
+#define elementwise_add32 _mm_add_epi32
+#define elementwise_unpacklo _mm_unpacklo_epi16
+#define elementwise_unpackhi _mm_unpackhi_epi16
+#endif
+#endif
+
+// This utility computes dst = x op y for n elements (n <= ELEMENTWISE_CHUNK;
+// dst may be x or y) and returns the sum of dst. k is only used by
+// ELEMENTWISE_SCALE and has to be in [0, MOD).
+extern int elementwise_line_utility(matrix_elem *dst, const matrix_elem *x,
+									const matrix_elem *y, int k, int n,
+									int op);
+
+// This utility computes dst = m1 op m2 (dst is already allocated and may be
+// m1) and its sum
+extern void elementwise_matrices_utility(matrix_ptr dst, matrix_ptr m1,
+										 matrix_ptr m2, int op, int k);
+
+// This function returns m1 op m2 (m2 isn't used by ELEMENTWISE_SCALE, which
+// multiplies m1 by k), or NULL if the sizes of the matrices are different
+extern matrix_ptr elementwise_matrices(matrix_ptr m1, matrix_ptr m2, int op,
+									   int k);
+
+// This function computes m1 = m1 op m2 in place, without allocating anything
+// (unless m1's content is shared, see 'matrices_shared' - it is copied first).
+// m1 has to be resident (see mm_touch). It returns 0 if the sizes of the
+// matrices are different.
+extern int elementwise_matrices_inplace(matrix_ptr m1, matrix_ptr m2, int op,
+										int k);
+
+// This function returns the sums of every line of a matrix, as a column
+extern matrix_ptr sum_lines_matrix(matrix_ptr mat);
+
+// This function returns the sums of every column of a matrix, as a line
+extern matrix_ptr sum_columns_matrix(matrix_ptr mat);
+
+#endif // MATRICES_ELEMENTWISE_H
@@ -1,26 +1,176 @@
 // Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
 
+// getc_unlocked is a POSIX function
+#define _POSIX_C_SOURCE 200809L
+
 // Include the asscociated header file
 #include "matrices_input.h"
 
 // This function reads a matrix from stdin
 void read_matrix(matrix_ptr mat)
+{
+	fread_matrix(stdin, mat);
+}
+
+// This function reads a matrix from any given stream (read_matrix uses stdin)
+void fread_matrix(FILE *in, matrix_ptr mat)
 {
 	// Read matrix size
-	scanf("%d %d", &mat->m, &mat->n);
+	fscanf(in, "%d %d", &mat->m, &mat->n);
 
 	// Read matrix information while making sure it has the required size
 	// dynamically allocated.
-	mat->info = safe_malloc(mat->m * sizeof(int *));
+	mat->info = alloc_matrix_lines(mat->m, mat->n);
 	mat->elem_sum = 0;
+	mat->refs = NULL;
+
+	// Big matrices are parsed by several threads
+	if ((long long)mat->m * mat->n >= INPUT_BULK_MIN) {
+		fread_matrix_bulk(in, mat);
+		return;
+	}
+
 	for (int i = 0; i < mat->m; ++i) {
-		mat->info[i] = safe_malloc(mat->n * sizeof(int));
 		for (int j = 0; j < mat->n; ++j) {
-			scanf("%d", &mat->info[i][j]);
-			mat->info[i][j] %= MOD;
+			// The element is reduced before being stored (see matrix_elem)
+			int elem;
+			fscanf(in, "%d", &elem);
+			mat->info[i][j] = elem % MOD;
 			mat->elem_sum += mat->info[i][j];
 			// Correct for the last statement update
 			mat->elem_sum = (mat->elem_sum % MOD + MOD) % MOD;
 		}
 	}
 }
+
+// This function reads the content of a big matrix (whose size was already
+// read) in bulk and parses it on several threads
+void fread_matrix_bulk(FILE *in, matrix_ptr mat)
+{
+	long long elements = (long long)mat->m * mat->n;
+	long long chunks = (elements + INPUT_CHUNK - 1) / INPUT_CHUNK;
+	size_t *marks = safe_malloc(safe_mul(chunks, sizeof(size_t)));
+
+	// The text is copied until the last number ends. Just like fscanf, the
+	// character that follows it is put back, so the next command can be read.
+	size_t len = 0, size = 1 << 16;
+	char *text = safe_malloc(size);
+	long long count = 0;
+	int in_number = 0, c;
+	flockfile(in);
+	while ((c = getc_unlocked(in)) != EOF) {
+		int space = isspace(c);
+		if (space && count == elements) {
+			ungetc(c, in);
+			break;
+		}
+		if (!space && !in_number) {
+			// A new number starts here
+			if (count % INPUT_CHUNK == 0)
+				marks[count / INPUT_CHUNK] = len;
+			++count;
+		}
+		in_number = !space;
+
+		if (len + 1 == size) {
+			size *= 2;
+			text = safe_realloc(text, size);
+		}
+		text[len++] = (char)c;
+	}
+	funlockfile(in);
+	text[len] = '\0';
+
+	// If the input ended too soon, the missing elements are 0
+	if (count < elements) {
+		for (long long e = count; e < elements; ++e)
+			mat->info[e / mat->n][e % mat->n] = 0;
+		elements = count;
+		chunks = (elements + INPUT_CHUNK - 1) / INPUT_CHUNK;
+	}
+
+	// Every thread gets a few chunks
+	int threads = topo_threads(INPUT_MAX_THREADS);
+	if (threads > chunks)
+		threads = (int)chunks;
+	if (threads < 1)
+		threads = 1;
+
+	input_job jobs[INPUT_MAX_THREADS];
+	pthread_t ids[INPUT_MAX_THREADS];
+	int started[INPUT_MAX_THREADS];
+	for (int t = 0; t < threads; ++t) {
+		jobs[t] = (input_job){
+			.mat = mat, .text = text, .marks = marks, .chunks = chunks,
+			.elements = elements, .first = t, .step = threads, .sum = 0,
+			.thread = t
+		};
+		// The first job is done by this thread; if a thread can't be
+		// created, its job is done here, too (without pinning this thread)
+		started[t] = t && !pthread_create(&ids[t], NULL, fread_matrix_chunks,
+										  &jobs[t]);
+		if (t && !started[t]) {
+			jobs[t].thread = 0;
+			fread_matrix_chunks(&jobs[t]);
+		}
+	}
+	fread_matrix_chunks(&jobs[0]);
+
+	// The sums are combined at the end
+	long long sum = 0;
+	for (int t = 0; t < threads; ++t) {
+		if (started[t])
+			pthread_join(ids[t], NULL);
+		sum += jobs[t].sum;
+	}
+	mat->elem_sum = (int)((sum % MOD + MOD) % MOD);
+
+	free(text);
+	free(marks);
+}
+
+// This function parses some chunks of a matrix's text (see 'input_job'). It is
+// a thread's function.
+void *fread_matrix_chunks(void *arg)
+{
+	input_job_ptr job = arg;
+	int n = job->mat->n;
+	long long sum = 0;
+
+	// The caller is the first thread, so the others are numbered from 1
+	if (job->thread)
+		topo_pin(job->thread);
+
+	for (long long k = job->first; k < job->chunks; k += job->step) {
+		const char *p = job->text + job->marks[k];
+		long long e = k * INPUT_CHUNK;
+		long long last = e + INPUT_CHUNK;
+		if (last > job->elements)
+			last = job->elements;
+		for (; e < last; ++e) {
+			// Every number is parsed just like "%d" would do it
+			while (isspace((unsigned char)*p))
+				++p;
+			int negative = *p == '-';
+			if (*p == '-' || *p == '+')
+				++p;
+			long long value = 0;
+			while (*p >= '0' && *p <= '9')
+				value = value * 10 + (*p++ - '0');
+			// Anything else that isn't a digit is skipped
+			while (*p && !isspace((unsigned char)*p))
+				++p;
+
+			// The element is reduced before being stored (see matrix_elem)
+			int elem = (int)(negative ? -value : value);
+			matrix_elem x = (matrix_elem)(elem % MOD);
+			job->mat->info[e / n][e % n] = x;
+			sum += x;
+		}
+		// The sum of a chunk can't overflow; it is reduced after every one
+		sum %= MOD;
+	}
+
+	job->sum = sum;
+	return NULL;
+}
@@ -4,15 +4,69 @@
 #define MATRICES_INPUT_H
 
 // This file contains the means of reading a matrix.
+//
+// Big matrices are not read with fscanf, one element at a time. Their content
+// is copied in bulk (it is only looked at to count the numbers, so the copy
+// stops right after the last one), then it is parsed by a few threads at the
+// same time. While copying, the position of every INPUT_CHUNK-th number is
+// noted, so every chunk of the text already knows where its numbers go in the
+// matrix. Every thread adds up the elements of its chunks; the sums are
+// combined at the end (modulo MOD, which gives the same elem_sum). The number
+// of threads follows --threads and they are pinned like the workers (see
+// 'octave_topology').
 
 // Standard library dependencies
-#include <stdio.h> // scanf
+#include <ctype.h> // isspace
+#include <pthread.h> // pthread_create, pthread_join
+#include <stdio.h> // scanf, fscanf, getc_unlocked
+#include <stdlib.h> // free
 
 // Other dependencies
 #include "matrices_base.h"
-#include "safe_utilities.h" // safe_malloc
+#include "matrices_shared.h" // alloc_matrix_lines
+#include "octave_topology.h" // topo_threads, topo_pin
+#include "safe_utilities.h" // safe_malloc, safe_realloc
+
+// Matrices with at least this many elements are read in bulk
+#define INPUT_BULK_MIN (1 << 16)
+// The number of elements parsed at once by a thread
+#define INPUT_CHUNK (1 << 14)
+// The maximum number of threads that parse a matrix
+#define INPUT_MAX_THREADS 16
+
+// The work of a thread that parses a matrix
+typedef struct {
+	// The matrix and its text (see 'fread_matrix_bulk')
+	matrix_ptr mat;
+	const char *text;
+	// marks[k] = where the (k * INPUT_CHUNK)-th number starts in the text
+	const size_t *marks;
+	long long chunks, elements;
+	// The thread parses the chunks first, first + step, ...
+	long long first, step;
+	// thread = the thread's number, used to pin it (0 = the caller, which
+	// isn't pinned)
+	int thread;
+	// The sum of the elements it parsed (modulo MOD)
+	long long sum;
+} input_job;
+
+// Note: The following typedef is kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef input_job * input_job_ptr;
 
 // This function reads a matrix from stdin
 extern void read_matrix(matrix_ptr mat);
 
+// This function reads a matrix from any given stream (read_matrix uses stdin)
+extern void fread_matrix(FILE *in, matrix_ptr mat);
+
+// This function reads the content of a big matrix (whose size was already
+// read) in bulk and parses it on several threads
+extern void fread_matrix_bulk(FILE *in, matrix_ptr mat);
+
+// This function parses some chunks of a matrix's text (see 'input_job'). It is
+// a thread's function.
+extern void *fread_matrix_chunks(void *arg);
+
 #endif // MATRICES_INPUT_H
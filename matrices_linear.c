@@ -0,0 +1,361 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "matrices_linear.h"
+
+// This function returns the inverse of x (modulo MOD, x must not be 0). MOD is
+// prime, so x^(MOD - 2) * x = x^(MOD - 1) = 1.
+int linear_inverse(int x)
+{
+	long long base = (x % MOD + MOD) % MOD, inverse = 1;
+	for (int e = MOD - 2; e; e >>= 1) {
+		if (e & 1)
+			inverse = inverse * base % MOD;
+		base = base * base % MOD;
+	}
+	return (int)inverse;
+}
+
+// This utility computes x -= l * y (modulo MOD) for n elements in [0, MOD).
+// Adding (MOD - l) * y instead keeps everything positive, so the remainder
+// doesn't have to be corrected.
+static void linear_row_utility(matrix_elem *x, const matrix_elem *y, int l,
+							   int n)
+{
+	unsigned int nl = (unsigned int)(MOD - l);
+	for (int j = 0; j < n; ++j)
+		x[j] = (matrix_elem)(((unsigned int)x[j] + nl * y[j]) % MOD);
+}
+
+// This utility makes view a (m x n) block of mat, starting at (i0, j0). Its
+// lines are stored in rows (which must have room for m of them).
+void linear_view_utility(matrix_ptr view, matrix_elem **rows,
+						 matrix_ptr mat, int i0, int j0, int m, int n)
+{
+	for (int i = 0; i < m; ++i)
+		rows[i] = mat->info[i0 + i] + j0;
+	view->info = rows;
+	view->m = m;
+	view->n = n;
+	view->elem_sum = 0;
+	view->refs = NULL;
+}
+
+// This function computes c -= a x b (modulo MOD). c may be a view of a bigger
+// matrix; the elements of every matrix must be in [0, MOD).
+void linear_subtract_product(matrix_ptr c, matrix_ptr a, matrix_ptr b)
+{
+	if (!a->m || !a->n || !b->n)
+		return;
+
+	linear_product prod = {.c = c, .a = a, .b = b, .next = 0, .pinned = 0};
+	pthread_mutex_init(&prod.lock, NULL);
+
+	// Small products aren't worth the threads (see 'octave_topology' for how
+	// many of them may be used)
+	int threads = 1;
+	if ((long long)a->m * a->n * b->n >= LINEAR_THREAD_WORK)
+		threads = topo_threads(LINEAR_MAX_THREADS);
+	if (threads > (a->m + LINEAR_SLAB - 1) / LINEAR_SLAB)
+		threads = (a->m + LINEAR_SLAB - 1) / LINEAR_SLAB;
+
+	// This thread computes slabs too; if a thread can't be created, the
+	// others simply get more slabs
+	pthread_t ids[LINEAR_MAX_THREADS];
+	int started = 0;
+	for (int t = 1; t < threads; ++t)
+		if (!pthread_create(&ids[started], NULL, linear_product_thread, &prod))
+			++started;
+	linear_product_utility(&prod);
+	for (int t = 0; t < started; ++t)
+		pthread_join(ids[t], NULL);
+
+	pthread_mutex_destroy(&prod.lock);
+}
+
+// This function is executed by the threads of a product: it computes slabs
+// until there are none left
+void *linear_product_thread(void *arg)
+{
+	linear_product_ptr prod = arg;
+
+	// The caller computes slabs too, so the other threads are numbered from 1
+	pthread_mutex_lock(&prod->lock);
+	int index = ++prod->pinned;
+	pthread_mutex_unlock(&prod->lock);
+	topo_pin(index);
+
+	linear_product_utility(prod);
+	return NULL;
+}
+
+// This utility computes slabs of a product until there are none left
+void linear_product_utility(linear_product_ptr prod)
+{
+	int width = prod->b->n;
+
+	// A slab of the product is computed here, then subtracted from c
+	matrix_elem *buf = safe_malloc(safe_mul(safe_mul(LINEAR_SLAB, width),
+											sizeof(matrix_elem)));
+	matrix_elem *rows[LINEAR_SLAB];
+	for (int i = 0; i < LINEAR_SLAB; ++i)
+		rows[i] = buf + (size_t)i * width;
+
+	while (1) {
+		pthread_mutex_lock(&prod->lock);
+		int i0 = prod->next;
+		prod->next += LINEAR_SLAB;
+		pthread_mutex_unlock(&prod->lock);
+		if (i0 >= prod->a->m)
+			break;
+
+		int m = prod->a->m - i0 < LINEAR_SLAB ? prod->a->m - i0 : LINEAR_SLAB;
+		matrix slab = {.info = prod->a->info + i0, .m = m, .n = prod->a->n};
+		matrix tmp = {.info = rows, .m = m, .n = width};
+		multiply_matrices_naive_utility(&slab, prod->b, &tmp);
+
+		for (int i = 0; i < m; ++i) {
+			matrix_elem *line = prod->c->info[i0 + i];
+			for (int j = 0; j < width; ++j) {
+				int v = line[j] - rows[i][j];
+				line[j] = (matrix_elem)(v < 0 ? v + MOD : v);
+			}
+		}
+	}
+
+	free(buf);
+}
+
+// This function computes the LU factorization of a matrix (which isn't
+// changed)
+lu_factors_ptr lu_factor(matrix_ptr mat)
+{
+	int m = mat->m, n = mat->n, steps = m < n ? m : n;
+
+	// The elements are factorized in [0, MOD)
+	lu_factors_ptr lu = safe_malloc(sizeof(lu_factors));
+	lu->a = multiply_matrices_alloc_utility(m, n);
+	for (int i = 0; i < m; ++i)
+		for (int j = 0; j < n; ++j)
+			lu->a->info[i][j] = (matrix_elem)((mat->info[i][j] + MOD) % MOD);
+	lu->pivot_cols = safe_malloc(safe_mul(steps ? steps : 1, sizeof(int)));
+	lu->swaps = safe_malloc(safe_mul(steps ? steps : 1, sizeof(int)));
+	lu->rank = 0;
+	lu->sign = 1;
+
+	// The multipliers of a block are gathered in l21 (their columns may not
+	// be next to each other, if a column of the block has no pivot)
+	matrix_ptr l21 = multiply_matrices_alloc_utility(m, LINEAR_BLOCK);
+	matrix_elem **c_rows = safe_malloc(safe_mul(m, sizeof(matrix_elem *)));
+	matrix_elem *u_rows[LINEAR_BLOCK];
+
+	for (int c0 = 0; c0 < n && lu->rank < m; c0 += LINEAR_BLOCK) {
+		int c1 = n - c0 < LINEAR_BLOCK ? n : c0 + LINEAR_BLOCK;
+		int r0 = lu->rank;
+		lu_factor_block_utility(lu, c0, c1);
+		int r = lu->rank - r0;
+		if (!r || c1 == n)
+			continue;
+
+		// U12 = L11^-1 A12, then A22 -= L21 x U12
+		lu_solve_block_utility(lu, r0, r, c1);
+		int below = m - lu->rank;
+		if (!below)
+			continue;
+		for (int i = 0; i < below; ++i)
+			for (int s = 0; s < r; ++s)
+				l21->info[i][s] =
+					lu->a->info[lu->rank + i][lu->pivot_cols[r0 + s]];
+		matrix l = {.info = l21->info, .m = below, .n = r};
+		matrix u, c;
+		linear_view_utility(&u, u_rows, lu->a, r0, c1, r, n - c1);
+		linear_view_utility(&c, c_rows, lu->a, lu->rank, c1, below, n - c1);
+		linear_subtract_product(&c, &l, &u);
+	}
+
+	free_matrix(l21);
+	free(l21);
+	free(c_rows);
+	return lu;
+}
+
+// This utility finds the pivots of the columns [c0, c1). Only the columns of
+// the block are updated.
+void lu_factor_block_utility(lu_factors_ptr lu, int c0, int c1)
+{
+	matrix_ptr a = lu->a;
+	for (int c = c0; c < c1 && lu->rank < a->m; ++c) {
+		// Any element but 0 can be a pivot; a column without one is skipped
+		int r = lu->rank, p = r;
+		while (p < a->m && !a->info[p][c])
+			++p;
+		if (p == a->m)
+			continue;
+
+		// The whole lines are swapped (the multipliers that were already
+		// found included), which only takes swapping two pointers
+		if (p != r) {
+			matrix_elem *line = a->info[p];
+			a->info[p] = a->info[r];
+			a->info[r] = line;
+			lu->sign = -lu->sign;
+		}
+		lu->swaps[r] = p;
+		lu->pivot_cols[r] = c;
+		++lu->rank;
+
+		// The multipliers are stored in place of the eliminated elements
+		int inverse = linear_inverse(a->info[r][c]);
+		for (int i = r + 1; i < a->m; ++i) {
+			matrix_elem *line = a->info[i];
+			if (!line[c])
+				continue;
+			int l = line[c] * inverse % MOD;
+			line[c] = (matrix_elem)l;
+			linear_row_utility(line + c + 1, a->info[r] + c + 1, l,
+							   c1 - c - 1);
+		}
+	}
+}
+
+// This utility applies the pivots r0, ..., r0 + r - 1 (which were just found)
+// to the columns of their lines that follow c1 (U12 = L11^-1 A12)
+void lu_solve_block_utility(lu_factors_ptr lu, int r0, int r, int c1)
+{
+	matrix_ptr a = lu->a;
+	for (int t = 1; t < r; ++t) {
+		matrix_elem *line = a->info[r0 + t];
+		for (int s = 0; s < t; ++s) {
+			int l = line[lu->pivot_cols[r0 + s]];
+			if (l)
+				linear_row_utility(line + c1, a->info[r0 + s] + c1, l,
+								   a->n - c1);
+		}
+	}
+}
+
+// This function solves a x = b in place (lu is the factorization of a square,
+// invertible matrix a; b has as many lines as a, elements in [0, MOD))
+void lu_solve(lu_factors_ptr lu, matrix_ptr b)
+{
+	matrix_ptr a = lu->a;
+	int n = a->m;
+	matrix_elem *rows[LINEAR_BLOCK];
+
+	// P b, then L y = P b and U x = y
+	for (int r = 0; r < n; ++r) {
+		if (lu->swaps[r] != r) {
+			matrix_elem *line = b->info[r];
+			b->info[r] = b->info[lu->swaps[r]];
+			b->info[lu->swaps[r]] = line;
+		}
+	}
+
+	// Every block of lines first subtracts the ones that were already solved
+	// (a single product), then it is solved line by line
+	for (int i0 = 0; i0 < n; i0 += LINEAR_BLOCK) {
+		int i1 = n - i0 < LINEAR_BLOCK ? n : i0 + LINEAR_BLOCK;
+		if (i0) {
+			matrix l, y = {.info = b->info, .m = i0, .n = b->n};
+			matrix c = {.info = b->info + i0, .m = i1 - i0, .n = b->n};
+			linear_view_utility(&l, rows, a, i0, 0, i1 - i0, i0);
+			linear_subtract_product(&c, &l, &y);
+		}
+		for (int i = i0 + 1; i < i1; ++i)
+			for (int s = i0; s < i; ++s)
+				if (a->info[i][s])
+					linear_row_utility(b->info[i], b->info[s], a->info[i][s],
+									   b->n);
+	}
+
+	for (int i1 = n, i0; i1 > 0; i1 = i0) {
+		i0 = i1 - LINEAR_BLOCK > 0 ? i1 - LINEAR_BLOCK : 0;
+		if (i1 < n) {
+			matrix u, x = {.info = b->info + i1, .m = n - i1, .n = b->n};
+			matrix c = {.info = b->info + i0, .m = i1 - i0, .n = b->n};
+			linear_view_utility(&u, rows, a, i0, i1, i1 - i0, n - i1);
+			linear_subtract_product(&c, &u, &x);
+		}
+		for (int i = i1 - 1; i >= i0; --i) {
+			for (int s = i + 1; s < i1; ++s)
+				if (a->info[i][s])
+					linear_row_utility(b->info[i], b->info[s], a->info[i][s],
+									   b->n);
+			unsigned int inverse = (unsigned int)linear_inverse(a->info[i][i]);
+			for (int j = 0; j < b->n; ++j)
+				b->info[i][j] = (matrix_elem)(b->info[i][j] * inverse % MOD);
+		}
+	}
+}
+
+// This function frees a factorization
+void lu_free(lu_factors_ptr lu)
+{
+	free_matrix(lu->a);
+	free(lu->a);
+	free(lu->pivot_cols);
+	free(lu->swaps);
+	free(lu);
+}
+
+// This function returns the determinant of a square matrix (modulo MOD)
+int determinant_matrix(matrix_ptr mat)
+{
+	lu_factors_ptr lu = lu_factor(mat);
+	long long det = 0;
+	if (lu->rank == mat->n) {
+		det = lu->sign < 0 ? MOD - 1 : 1;
+		for (int i = 0; i < mat->n; ++i)
+			det = det * lu->a->info[i][i] % MOD;
+	}
+	lu_free(lu);
+	return (int)det;
+}
+
+// This function returns the rank of a matrix
+int rank_matrix(matrix_ptr mat)
+{
+	lu_factors_ptr lu = lu_factor(mat);
+	int rank = lu->rank;
+	lu_free(lu);
+	return rank;
+}
+
+// This function returns the inverse of a square matrix, or NULL if it is
+// singular
+matrix_ptr invert_matrix(matrix_ptr mat)
+{
+	int n = mat->n;
+	matrix_ptr inverse = multiply_matrices_alloc_utility(n, n);
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			inverse->info[i][j] = i == j;
+
+	// A^-1 is the solution of A x = I
+	matrix_ptr rez = solve_matrices(mat, inverse);
+	free_matrix(inverse);
+	free(inverse);
+	return rez;
+}
+
+// This function returns the solution x of a x = b (a must be square and have
+// as many lines as b), or NULL if a is singular
+matrix_ptr solve_matrices(matrix_ptr a, matrix_ptr b)
+{
+	lu_factors_ptr lu = lu_factor(a);
+	if (lu->rank < a->n) {
+		lu_free(lu);
+		return NULL;
+	}
+
+	// The system is solved in place, in a copy of b
+	matrix_ptr x = multiply_matrices_alloc_utility(b->m, b->n);
+	for (int i = 0; i < b->m; ++i)
+		for (int j = 0; j < b->n; ++j)
+			x->info[i][j] = (matrix_elem)((b->info[i][j] + MOD) % MOD);
+	lu_solve(lu, x);
+	matrix_update_sum(x);
+
+	lu_free(lu);
+	return x;
+}
@@ -0,0 +1,130 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef MATRICES_LINEAR_H
+#define MATRICES_LINEAR_H
+
+// This file contains the linear algebra of the simulator. MOD is prime, so
+// every element but 0 has an inverse and Gaussian elimination works just like
+// it does for real numbers. Everything is built on the LU factorization of a
+// matrix (with row pivoting): P A = L U, where L is lower triangular (with 1s
+// on its diagonal) and U is in row echelon form. The rank is the number of
+// pivots, the determinant is the product of the pivots (and of the sign of
+// P), and A x = B is solved with two triangular systems (A^-1 = the solution
+// of A x = I).
+//
+// The factorization works on blocks of LINEAR_BLOCK columns: the pivots of a
+// block are found one by one, but the rest of the matrix is updated once per
+// block, as a product (A22 -= L21 x U12) computed by the same kernel as 'M'
+// (see multiply_matrices_naive_utility). The triangular systems are solved a
+// block of LINEAR_BLOCK lines at a time, in the same way. The big products
+// are split between threads (as many as 'octave_topology' allows), LINEAR_SLAB
+// lines at a time.
+
+// Standard library dependencies
+#include <pthread.h> // pthread_create, pthread_mutex_t
+#include <stdlib.h> // free
+
+// Other dependencies
+#include "matrices_base.h"
+#include "matrices_multiplication.h" // multiply_matrices_naive_utility
+#include "octave_topology.h" // topo_threads, topo_pin
+#include "safe_utilities.h" // safe_malloc, safe_mul
+
+// The errors of the linear algebra commands (see 'matrices_errors')
+#define INVALID_SQUARE "The matrix is not square\n"
+#define INVALID_SINGULAR "The matrix is singular\n"
+#define INVALID_SOLVE "Cannot solve the linear system\n"
+
+// The number of columns that are factorized at once (and of lines that are
+// solved at once)
+#define LINEAR_BLOCK 32
+// The products are computed this many lines at a time
+#define LINEAR_SLAB 64
+// The maximum number of threads that compute a product
+#define LINEAR_MAX_THREADS 16
+// The products with less multiplications than this aren't split at all
+#define LINEAR_THREAD_WORK (1LL << 22)
+
+// The LU factorization of a (m x n) matrix
+typedef struct {
+	// a = L (under the pivots) and U (the first rank lines)
+	matrix_ptr a;
+	// rank = the number of pivots
+	int rank;
+	// pivot_cols[r] = the column of the r-th pivot
+	int *pivot_cols;
+	// swaps[r] = the line that was swapped with line r before the r-th pivot
+	// was used
+	int *swaps;
+	// sign = the sign of the permutation (-1 for an odd number of swaps)
+	int sign;
+} lu_factors;
+
+// A product that is split between threads: c -= a x b (modulo MOD)
+typedef struct {
+	matrix_ptr c, a, b;
+	// next = the next slab of LINEAR_SLAB lines to be computed; pinned = the
+	// number of threads that were started (every one of them is pinned to
+	// its own CPU, see topo_pin)
+	int next, pinned;
+	pthread_mutex_t lock;
+} linear_product;
+
+// Note: The following typedefs are kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef lu_factors * lu_factors_ptr;
+typedef linear_product * linear_product_ptr;
+
+// This function returns the inverse of x (modulo MOD, x must not be 0)
+extern int linear_inverse(int x);
+
+// This utility makes view a (m x n) block of mat, starting at (i0, j0). Its
+// lines are stored in rows (which must have room for m of them).
+extern void linear_view_utility(matrix_ptr view, matrix_elem **rows,
+								matrix_ptr mat, int i0, int j0, int m, int n);
+
+// This function computes c -= a x b (modulo MOD). c may be a view of a bigger
+// matrix; the elements of every matrix must be in [0, MOD).
+extern void linear_subtract_product(matrix_ptr c, matrix_ptr a, matrix_ptr b);
+
+// This function is executed by the threads of a product: it computes slabs
+// until there are none left
+extern void *linear_product_thread(void *arg);
+
+// This utility computes slabs of a product until there are none left
+extern void linear_product_utility(linear_product_ptr prod);
+
+// This function computes the LU factorization of a matrix (which isn't
+// changed)
+extern lu_factors_ptr lu_factor(matrix_ptr mat);
+
+// This utility finds the pivots of the columns [c0, c1). Only the columns of
+// the block are updated.
+extern void lu_factor_block_utility(lu_factors_ptr lu, int c0, int c1);
+
+// This utility applies the pivots r0, ..., r0 + r - 1 (which were just found)
+// to the columns of their lines that follow c1 (U12 = L11^-1 A12)
+extern void lu_solve_block_utility(lu_factors_ptr lu, int r0, int r, int c1);
+
+// This function solves a x = b in place (lu is the factorization of a square,
+// invertible matrix a; b has as many lines as a, elements in [0, MOD))
+extern void lu_solve(lu_factors_ptr lu, matrix_ptr b);
+
+// This function frees a factorization
+extern void lu_free(lu_factors_ptr lu);
+
+// This function returns the determinant of a square matrix (modulo MOD)
+extern int determinant_matrix(matrix_ptr mat);
+
+// This function returns the rank of a matrix
+extern int rank_matrix(matrix_ptr mat);
+
+// This function returns the inverse of a square matrix, or NULL if it is
+// singular
+extern matrix_ptr invert_matrix(matrix_ptr mat);
+
+// This function returns the solution x of a x = b (a must be square and have
+// as many lines as b), or NULL if a is singular
+extern matrix_ptr solve_matrices(matrix_ptr a, matrix_ptr b);
+
+#endif // MATRICES_LINEAR_H
@@ -0,0 +1,339 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// fseeko is a POSIX function; the spill file may grow past 2GB
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+// Include the asscociated header file
+#include "matrices_memory.h"
+
+// Standard library dependencies
+#include <sys/types.h> // off_t
+
+// The memory budget is shared by the whole program
+static matrices_memory mm;
+
+// This function sets up the memory budget for the given array. If path is NULL,
+// an anonymous temporary file is used. It returns 0 on failure.
+int mm_init(d_matrices_ptr dm, unsigned long long budget, const char *path)
+{
+	mm.budget = budget;
+	mm.resident_bytes = 0;
+	mm.spilled_count = 0;
+	mm.spill = NULL;
+	mm.spill_size = 0;
+	mm.extents = NULL;
+	mm.extents_count = 0;
+	mm.extents_size = 0;
+	mm.dm = dm;
+	mm.pinned_count = 0;
+	mm.clock = 0;
+
+	if (!budget)
+		return 1;
+
+	mm.spill = path ? fopen(path, "w+b") : tmpfile();
+	if (!mm.spill) {
+		fprintf(stderr, "Could not open the spill file: %s\n",
+				path ? path : "(temporary file)");
+		mm.budget = 0;
+		return 0;
+	}
+
+	// When safe_malloc runs out of memory, it will ask us for help
+	safe_set_reclaim(mm_reclaim);
+	return 1;
+}
+
+// This function returns 1 if a budget was set
+int mm_enabled(void)
+{
+	return mm.budget != 0;
+}
+
+// This function returns the budget (0 = no budget at all)
+unsigned long long mm_budget(void)
+{
+	return mm.budget;
+}
+
+// This function returns the number of bytes used by a matrix's content
+unsigned long long mm_matrix_bytes(matrix_ptr mat)
+{
+	return (unsigned long long)mat->m *
+		   (sizeof(*mat->info) + (unsigned long long)mat->n *
+			sizeof(**mat->info));
+}
+
+// This function must be called for every matrix that is added to the array
+void mm_track(matrix_ptr mat)
+{
+	mat->spilled = 0;
+	mat->spill_offset = -1;
+	mat->last_use = ++mm.clock;
+
+	if (!mm.budget)
+		return;
+
+	mm.resident_bytes += mm_matrix_bytes(mat);
+	if (mm.pinned_count < MM_MAX_PINNED)
+		mm.pinned[mm.pinned_count++] = mat;
+}
+
+// This function must be called before using a matrix's content. If the matrix
+// was spilled, it is read back. The matrix is also pinned until the end of
+// the current command.
+void mm_touch(matrix_ptr mat)
+{
+	if (!mm.budget)
+		return;
+
+	// Pin it first, so making room for it can't spill it
+	if (mm.pinned_count < MM_MAX_PINNED)
+		mm.pinned[mm.pinned_count++] = mat;
+	mat->last_use = ++mm.clock;
+
+	if (mat->spilled)
+		mm_fault(mat);
+}
+
+// This function pins a matrix until the end of the current command, without
+// reading it back if it was spilled (see 'matrices_out_of_core')
+void mm_pin(matrix_ptr mat)
+{
+	if (!mm.budget)
+		return;
+
+	if (mm.pinned_count < MM_MAX_PINNED)
+		mm.pinned[mm.pinned_count++] = mat;
+	mat->last_use = ++mm.clock;
+}
+
+// This function unpins a matrix before the end of the current command (once
+// for every mm_touch / mm_pin), so a command can use more than MM_MAX_PINNED
+// matrices, a few at a time (see 'matrices_chain')
+void mm_unpin(matrix_ptr mat)
+{
+	if (!mm.budget)
+		return;
+
+	for (int i = mm.pinned_count - 1; i >= 0; --i) {
+		if (mm.pinned[i] == mat) {
+			mm.pinned[i] = mm.pinned[--mm.pinned_count];
+			return;
+		}
+	}
+}
+
+// This function must be called (instead of mm_track) for a new matrix whose
+// content was written straight to the given region of the spill file
+void mm_track_spilled(matrix_ptr mat, long long offset)
+{
+	mat->info = NULL;
+	mat->spilled = 1;
+	mat->spill_offset = offset;
+	mat->last_use = ++mm.clock;
+	++mm.spilled_count;
+}
+
+// This function returns the spill file's descriptor, for reading / writing it
+// directly (pread / pwrite). Everything that was buffered is written first.
+int mm_spill_fd(void)
+{
+	if (fflush(mm.spill))
+		mm_fatal("write to");
+	return fileno(mm.spill);
+}
+
+// This function must be called after a (resident) matrix's content was changed
+// in place: its copy in the spill file isn't valid anymore, so the matrix will
+// be written again the next time it is spilled
+void mm_invalidate(matrix_ptr mat)
+{
+	if (!mm.budget || mat->spill_offset < 0)
+		return;
+
+	// Its region of the spill file can be reused
+	if (mm.extents_count == mm.extents_size) {
+		mm.extents_size = mm.extents_size ? 2 * mm.extents_size : 16;
+		mm.extents = safe_realloc(mm.extents,
+								  mm.extents_size * sizeof(mm_extent));
+	}
+	mm.extents[mm.extents_count].offset = mat->spill_offset;
+	mm.extents[mm.extents_count].bytes = (long long)mat->m * mat->n *
+										 sizeof(**mat->info);
+	++mm.extents_count;
+	mat->spill_offset = -1;
+}
+
+// This function must be called before a matrix is freed (or removed from the
+// array). A spilled matrix is left empty, so free_matrix can't fail on it.
+void mm_release(matrix_ptr mat)
+{
+	if (!mm.budget)
+		return;
+
+	// Its region of the spill file can be reused
+	mm_invalidate(mat);
+
+	if (mat->spilled) {
+		mat->spilled = 0;
+		--mm.spilled_count;
+		mat->info = NULL;
+		mat->m = 0;
+		mat->n = 0;
+	} else {
+		mm.resident_bytes -= mm_matrix_bytes(mat);
+	}
+
+	// A released matrix can't stay pinned
+	for (int i = 0; i < mm.pinned_count; ++i)
+		if (mm.pinned[i] == mat)
+			mm.pinned[i] = NULL;
+}
+
+// This function finds a region of the spill file that can hold the given
+// number of bytes (first fit), or appends one to the end of the file
+long long mm_allocate_extent(long long bytes)
+{
+	for (int i = 0; i < mm.extents_count; ++i) {
+		if (mm.extents[i].bytes >= bytes) {
+			long long offset = mm.extents[i].offset;
+			mm.extents[i].offset += bytes;
+			mm.extents[i].bytes -= bytes;
+			// Remove the empty regions
+			if (!mm.extents[i].bytes)
+				mm.extents[i] = mm.extents[--mm.extents_count];
+			return offset;
+		}
+	}
+
+	long long offset = mm.spill_size;
+	mm.spill_size += bytes;
+	return offset;
+}
+
+// This function outputs an error message and quits; there is no sane way of
+// continuing once a matrix was lost
+void mm_fatal(const char *what)
+{
+	fprintf(stderr, "FATAL: Could not %s the spill file.\n", what);
+	exit(EXIT_FAILURE);
+}
+
+// This function moves a matrix's content to the spill file
+void mm_spill(matrix_ptr mat)
+{
+	// A matrix's content only changes in place through mm_invalidate (which
+	// drops its copy), so a copy that was already written is still good
+	if (mat->spill_offset < 0) {
+		long long row = (long long)mat->n * sizeof(**mat->info);
+		mat->spill_offset = mm_allocate_extent(row * mat->m);
+		if (fseeko(mm.spill, (off_t)mat->spill_offset, SEEK_SET))
+			mm_fatal("seek in");
+		for (int i = 0; i < mat->m; ++i)
+			if (fwrite(mat->info[i], 1, row, mm.spill) != (size_t)row)
+				mm_fatal("write to");
+	}
+
+	// The content may still be used by other matrices (see 'matrices_shared')
+	mm.resident_bytes -= mm_matrix_bytes(mat);
+	if (!unref_matrix(mat)) {
+		for (int i = 0; i < mat->m; ++i)
+			free(mat->info[i]);
+		free(mat->info);
+	}
+	mat->info = NULL;
+	mat->spilled = 1;
+	++mm.spilled_count;
+}
+
+// This function reads a spilled matrix back
+void mm_fault(matrix_ptr mat)
+{
+	long long row = (long long)mat->n * sizeof(**mat->info);
+
+	// The memory has to be allocated before it can be filled. This may spill
+	// other matrices, but never a pinned one (like this one).
+	mat->info = alloc_matrix_lines(mat->m, mat->n);
+
+	if (fseeko(mm.spill, (off_t)mat->spill_offset, SEEK_SET))
+		mm_fatal("seek in");
+	for (int i = 0; i < mat->m; ++i)
+		if (fread(mat->info[i], 1, row, mm.spill) != (size_t)row)
+			mm_fatal("read from");
+
+	mat->spilled = 0;
+	--mm.spilled_count;
+	mm.resident_bytes += mm_matrix_bytes(mat);
+}
+
+// This function spills the least recently used (and unpinned) matrix. It
+// returns the number of bytes that were freed (0 if nothing could be spilled).
+unsigned long long mm_spill_lru(void)
+{
+	matrix_ptr lru = NULL;
+	for (int i = 0; i < mm.dm->matrices_count; ++i) {
+		matrix_ptr mat = mm.dm->matrices[i];
+		if (mat->spilled || !mat->m || (lru && lru->last_use <= mat->last_use))
+			continue;
+
+		int pinned = 0;
+		for (int j = 0; j < mm.pinned_count; ++j)
+			pinned |= mm.pinned[j] == mat;
+		if (!pinned)
+			lru = mat;
+	}
+
+	if (!lru)
+		return 0;
+
+	unsigned long long bytes = mm_matrix_bytes(lru);
+	mm_spill(lru);
+	return bytes;
+}
+
+// This function is called at the end of every command: it unpins the matrices
+// and spills the least recently used ones until the budget is respected
+void mm_balance(void)
+{
+	if (!mm.budget)
+		return;
+
+	mm.pinned_count = 0;
+	while (mm.resident_bytes > mm.budget)
+		if (!mm_spill_lru())
+			break;
+}
+
+// This function is called by safe_malloc when it runs out of memory. It spills
+// matrices until (at least) the requested number of bytes were freed.
+int mm_reclaim(size_t bytes)
+{
+	unsigned long long freed = 0, spilled;
+	while (freed < (unsigned long long)bytes && (spilled = mm_spill_lru()))
+		freed += spilled;
+	return freed != 0;
+}
+
+// This function returns the number of spilled matrices
+int mm_spilled_count(void)
+{
+	return mm.spilled_count;
+}
+
+// This function closes the spill file and frees everything (it has to be
+// called before dm_free_all_matrices)
+void mm_free(void)
+{
+	if (!mm.budget)
+		return;
+
+	for (int i = 0; i < mm.dm->matrices_count; ++i)
+		mm_release(mm.dm->matrices[i]);
+
+	safe_set_reclaim(NULL);
+	fclose(mm.spill);
+	free(mm.extents);
+	mm.budget = 0;
+}
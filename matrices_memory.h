@@ -0,0 +1,135 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef MATRICES_MEMORY_H
+#define MATRICES_MEMORY_H
+
+// This file contains the memory budget of the program. When a budget is set
+// (--memory-budget), the matrices that weren't used for the longest time (the
+// least recently used ones) are moved to a spill file once the loaded matrices
+// need more memory than the budget allows. They are read back as soon as a
+// command needs their content. The same thing happens when safe_malloc runs
+// out of memory, so the program degrades gracefully instead of quitting.
+// Without a budget, every function in this file returns right away.
+
+// Standard library dependencies
+#include <stdio.h> // fopen, fread, fwrite, tmpfile
+#include <stdlib.h> // free
+
+// Other dependencies
+#include "matrices_base.h"
+#include "matrices_shared.h" // unref_matrix, alloc_matrix_lines
+#include "safe_utilities.h" // safe_malloc, safe_set_reclaim
+
+// The maximum number of matrices that can be in use by a single command
+#define MM_MAX_PINNED 4
+
+// A free region of the spill file
+typedef struct {
+	long long offset, bytes;
+} mm_extent;
+
+// The memory budget structure (there is a single one per program)
+typedef struct {
+	// budget = the maximum number of bytes the loaded matrices may use (0 =
+	// no budget at all)
+	unsigned long long budget;
+	// resident_bytes = the bytes used by the matrices that are not spilled
+	unsigned long long resident_bytes;
+	// spilled_count = the number of matrices that are currently spilled
+	int spilled_count;
+	// The matrices are stored here (and the file's size)
+	FILE *spill;
+	long long spill_size;
+	// The regions of the spill file that can be reused
+	mm_extent *extents;
+	int extents_count, extents_size;
+	// The array whose matrices are managed
+	d_matrices_ptr dm;
+	// The matrices used by the current command can't be spilled
+	matrix_ptr pinned[MM_MAX_PINNED];
+	int pinned_count;
+	// clock = incremented on every touch, used instead of the real time
+	unsigned long long clock;
+} matrices_memory;
+
+// This function sets up the memory budget for the given array. If path is NULL,
+// an anonymous temporary file is used. It returns 0 on failure.
+extern int mm_init(d_matrices_ptr dm, unsigned long long budget,
+				   const char *path);
+
+// This function returns 1 if a budget was set
+extern int mm_enabled(void);
+
+// This function returns the budget (0 = no budget at all)
+extern unsigned long long mm_budget(void);
+
+// This function returns the number of bytes used by a matrix's content
+extern unsigned long long mm_matrix_bytes(matrix_ptr mat);
+
+// This function must be called for every matrix that is added to the array
+extern void mm_track(matrix_ptr mat);
+
+// This function must be called before using a matrix's content. If the matrix
+// was spilled, it is read back. The matrix is also pinned until the end of
+// the current command.
+extern void mm_touch(matrix_ptr mat);
+
+// This function pins a matrix until the end of the current command, without
+// reading it back if it was spilled (see 'matrices_out_of_core')
+extern void mm_pin(matrix_ptr mat);
+
+// This function unpins a matrix before the end of the current command (once
+// for every mm_touch / mm_pin), so a command can use more than MM_MAX_PINNED
+// matrices, a few at a time (see 'matrices_chain')
+extern void mm_unpin(matrix_ptr mat);
+
+// This function must be called (instead of mm_track) for a new matrix whose
+// content was written straight to the given region of the spill file
+extern void mm_track_spilled(matrix_ptr mat, long long offset);
+
+// This function returns the spill file's descriptor, for reading / writing it
+// directly (pread / pwrite). Everything that was buffered is written first.
+extern int mm_spill_fd(void);
+
+// This function must be called after a (resident) matrix's content was changed
+// in place: its copy in the spill file isn't valid anymore, so the matrix will
+// be written again the next time it is spilled
+extern void mm_invalidate(matrix_ptr mat);
+
+// This function must be called before a matrix is freed (or removed from the
+// array). A spilled matrix is left empty, so free_matrix can't fail on it.
+extern void mm_release(matrix_ptr mat);
+
+// This function finds a region of the spill file that can hold the given
+// number of bytes (first fit), or appends one to the end of the file
+extern long long mm_allocate_extent(long long bytes);
+
+// This function outputs an error message and quits; there is no sane way of
+// continuing once a matrix was lost
+extern void mm_fatal(const char *what);
+
+// This function moves a matrix's content to the spill file
+extern void mm_spill(matrix_ptr mat);
+
+// This function reads a spilled matrix back
+extern void mm_fault(matrix_ptr mat);
+
+// This function spills the least recently used (and unpinned) matrix. It
+// returns the number of bytes that were freed (0 if nothing could be spilled).
+extern unsigned long long mm_spill_lru(void);
+
+// This function is called at the end of every command: it unpins the matrices
+// and spills the least recently used ones until the budget is respected
+extern void mm_balance(void);
+
+// This function is called by safe_malloc when it runs out of memory
+extern int mm_reclaim(size_t bytes);
+
+// This function returns the number of spilled matrices
+extern int mm_spilled_count(void);
+
+// This function closes the spill file and frees everything (it has to be
+// called before dm_free_all_matrices)
+extern void mm_free(void);
+
+#endif // MATRICES_MEMORY_H
@@ -3,44 +3,128 @@
 // Include the asscociated header file
 #include "matrices_multiplication.h"
 
+// The back end used by the naive method (set at startup, never locked)
+static int multiply_backend = MULTIPLY_BACKEND_INT64;
+
 // This function multiplies two matrices (indexes at1, at2) and appends the
 // result to the dynamically allocated array of matrices. The function uses
-// the naive method to compute the result.
+// the naive method to compute the result. If the matrices can't be multiplied,
+// it returns NULL.
 matrix_ptr multiply_matrices(matrix_ptr m1, matrix_ptr m2)
 {
-	// Check that we can perform the multiplication
-	if (m1->n != m2->m) {
-		printf(INVALID_MULTIPLY);
+	// Check that we can perform the multiplication (the caller reports the
+	// error, since it knows where the output goes)
+	if (m1->n != m2->m)
 		return NULL;
+
+	// Thin products (with a vector as an operand or as the result) only read
+	// every element once, so they are limited by the memory's bandwidth, not
+	// by the arithmetic - they have kernels of their own
+	if (m1->n == 1 || m2->n == 1 || m1->m == 1)
+		return multiply_matrices_thin(m1, m2);
+
+	// Big products are computed by the workers, if there are any (see
+	// 'matrices_distributed'). If they fail, the product is computed here.
+	if (dist_worth(m1->m, m1->n, m2->n)) {
+		matrix_ptr mat = dist_multiply(m1, m2);
+		if (mat)
+			return mat;
 	}
 
 	// Abbreviation for the resulting matrix
-	matrix_ptr mat = safe_malloc(sizeof(matrix));
+	matrix_ptr mat = multiply_matrices_alloc_utility(m1->m, m2->n);
+	multiply_matrices_naive_utility(m1, m2, mat);
+
+	// The sum of the elements has to be computed at the end, since it has been
+	// lost during the operations
+	matrix_update_sum(mat);
+
+	return mat;
+}
 
+// This utility computes mat = m1 x m2 (mat is already allocated) using the
+// naive method, with the back end that was selected and the tuned block. The
+// operands may be views of bigger matrices (see 'matrices_linear').
+void multiply_matrices_naive_utility(matrix_ptr m1, matrix_ptr m2,
+									 matrix_ptr mat)
+{
 	// The standard multiplication method goes as follows:
 	// result[i][j] = sum_for_each_k(first[i][k] * second[k][j])
-	// The algorithm also allocates the needed memory while calculating the
-	// wanted result
-	mat->m = m1->m;
-	mat->n = m2->n;
+	// Big matrices are faster to multiply in blocks of columns (if the
+	// machine was tuned that way, see 'octave_tuning'), or using another
+	// arithmetic back end (if it was selected at startup)
+	int size = m1->m > m1->n ? m1->m : m1->n;
+	int block = tune_lookup(size > m2->n ? size : m2->n)->multiply_block;
+	if (multiply_backend == MULTIPLY_BACKEND_FMA)
+		multiply_matrices_fma_utility(m1, m2, mat);
+	else if (multiply_backend == MULTIPLY_BACKEND_MADD)
+		multiply_matrices_madd_utility(m1, m2, mat);
+	else if (block > 0)
+		multiply_matrices_blocked_utility(m1, m2, mat, block);
+	else
+		multiply_matrices_dot_utility(m1, m2, mat);
+}
+
+// This function multiplies two matrices using the original method (every
+// element is a dot product), without any of the faster kernels. It is the
+// reference the other kernels are checked against (see
+// 'matrices_verification'). If the matrices can't be multiplied, it returns
+// NULL.
+matrix_ptr multiply_matrices_reference(matrix_ptr m1, matrix_ptr m2)
+{
+	if (m1->n != m2->m)
+		return NULL;
+
+	matrix_ptr mat = multiply_matrices_alloc_utility(m1->m, m2->n);
+	multiply_matrices_dot_utility(m1, m2, mat);
+	matrix_update_sum(mat);
+
+	return mat;
+}
+
+// This utility allocates a (m x n) matrix for a product
+matrix_ptr multiply_matrices_alloc_utility(int m, int n)
+{
+	matrix_ptr mat = safe_malloc(sizeof(matrix));
+	mat->m = m;
+	mat->n = n;
+	mat->refs = NULL;
 	mat->elem_sum = 0;
-	mat->info = safe_malloc((mat->m) * sizeof(int *));
+	mat->info = alloc_matrix_lines(m, n);
+	return mat;
+}
+
+// This utility computes mat = m1 x m2 (mat is already allocated), every
+// element on its own, as a dot product
+void multiply_matrices_dot_utility(matrix_ptr m1, matrix_ptr m2,
+								   matrix_ptr mat)
+{
 	for (int i = 0; i < (m1->m); ++i) {
-		mat->info[i] = safe_malloc((mat->n) * sizeof(int));
 		for (int j = 0; j < (m2->n); ++j) {
-			mat->info[i][j] = 0;
-			for (int k = 0; k < (m1->n); ++k) {
-				// long long is used to avoid overflow
-				long long aux = m1->info[i][k];
-				aux *= (long long)m2->info[k][j];
-				aux %= (long long)MOD;
-				mat->info[i][j] += (int)aux;
-				mat->info[i][j] %= MOD;
-			}
+			// The elements are widened to long long on load. Every product is
+			// smaller than MOD^2 (in absolute value), so the whole sum fits and
+			// only has to be reduced once
+			long long sum = 0;
+			for (int k = 0; k < (m1->n); ++k)
+				sum += (long long)m1->info[i][k] * m2->info[k][j];
 			// Correct for the last statement update
-			mat->info[i][j] = (mat->info[i][j] + MOD) % MOD;
+			mat->info[i][j] = (matrix_elem)((sum % MOD + MOD) % MOD);
 		}
 	}
+}
+
+// This function multiplies two matrices when one of them, or the result, is a
+// vector: (m x 1) x (1 x p) is an outer product, (m x n) x (n x 1) is a
+// matrix-vector product and (1 x n) x (n x p) is a vector-matrix product
+matrix_ptr multiply_matrices_thin(matrix_ptr m1, matrix_ptr m2)
+{
+	matrix_ptr mat = multiply_matrices_alloc_utility(m1->m, m2->n);
+	if (m1->n == 1)
+		multiply_matrices_outer_utility(m1, m2, mat);
+	else if (m2->n == 1)
+		multiply_matrices_gemv_utility(m1, m2, mat);
+	else
+		multiply_matrices_blocked_utility(m1, m2, mat, MULTIPLY_VECTOR_BLOCK);
 
 	// The sum of the elements has to be computed at the end, since it has been
 	// lost during the operations
@@ -49,23 +133,396 @@ matrix_ptr multiply_matrices(matrix_ptr m1, matrix_ptr m2)
 	return mat;
 }
 
+// This utility computes the outer product mat = m1 x m2, where m1 is a column
+// (m x 1) and m2 is a line (1 x p). There is nothing to add up, so every
+// element is a single product, reduced on the spot.
+void multiply_matrices_outer_utility(matrix_ptr m1, matrix_ptr m2,
+									 matrix_ptr mat)
+{
+	const matrix_elem *b = m2->info[0];
+	for (int i = 0; i < (mat->m); ++i) {
+		multiply_acc ai = m1->info[i][0];
+		matrix_elem *line = mat->info[i];
+		for (int j = 0; j < (mat->n); ++j)
+			line[j] = (matrix_elem)((ai * b[j] % MOD + MOD) % MOD);
+	}
+}
+
+// This utility computes the matrix-vector product mat = m1 x m2, where m2 is a
+// column (n x 1). Every element of the result is the dot product of a line of
+// m1 and the vector, so m1 is streamed line by line. The products are added up
+// in MULTIPLY_LANES independent ints (one for every lane of the vector
+// registers), each of which gets at most MULTIPLY_CHUNK of them before they
+// are added to a long long - the reduction modulo MOD is only done once.
+void multiply_matrices_gemv_utility(matrix_ptr m1, matrix_ptr m2,
+									matrix_ptr mat)
+{
+	int n = m1->n;
+
+	// The vector is gathered first, since its elements are on different lines
+	matrix_elem *v = safe_malloc(safe_mul(n, sizeof(matrix_elem)));
+	for (int k = 0; k < n; ++k)
+		v[k] = m2->info[k][0];
+
+	const int segment = MULTIPLY_CHUNK * MULTIPLY_LANES;
+	for (int i = 0; i < (mat->m); ++i) {
+		const matrix_elem *a = m1->info[i];
+		long long sum = 0;
+		for (int k0 = 0; k0 < n; k0 += segment) {
+			int k1 = n - k0 < segment ? n : k0 + segment;
+			multiply_acc acc[MULTIPLY_LANES] = {0};
+			int k = k0;
+			for (; k + MULTIPLY_LANES <= k1; k += MULTIPLY_LANES)
+				for (int l = 0; l < MULTIPLY_LANES; ++l)
+					acc[l] += (multiply_acc)a[k + l] * v[k + l];
+			for (int l = 0; l < MULTIPLY_LANES; ++l)
+				sum += acc[l];
+			// The last few elements don't fill the lanes
+			for (; k < k1; ++k)
+				sum += (long long)a[k] * v[k];
+		}
+		mat->info[i][0] = (matrix_elem)((sum % MOD + MOD) % MOD);
+	}
+
+	free(v);
+}
+
+// This utility computes mat = m1 x m2 (mat is already allocated) using the
+// i-k-j order, which walks through m2 line by line. A line of the result is
+// accumulated a block of columns at a time, so that part of m2 stays in the
+// cache while the lines of m1 go by.
+void multiply_matrices_blocked_utility(matrix_ptr m1, matrix_ptr m2,
+									   matrix_ptr mat, int block)
+{
+	if (block > mat->n)
+		block = mat->n;
+	long long *line = safe_malloc(safe_mul(block ? block : 1,
+										   sizeof(long long)));
+	multiply_acc *acc = safe_malloc(safe_mul(block ? block : 1,
+											 sizeof(multiply_acc)));
+	for (int j0 = 0; j0 < (mat->n); j0 += block) {
+		int width = j0 + block < mat->n ? block : mat->n - j0;
+		for (int i = 0; i < (m1->m); ++i) {
+			for (int j = 0; j < width; ++j)
+				line[j] = 0;
+			// Every product is smaller than MOD^2 (in absolute value), so
+			// MULTIPLY_CHUNK of them fit in the narrow accumulators, and the
+			// whole sum fits in the long longs - it only has to be reduced once
+			for (int k0 = 0; k0 < (m1->n); k0 += MULTIPLY_CHUNK) {
+				int k1 = k0 + MULTIPLY_CHUNK < m1->n ? k0 + MULTIPLY_CHUNK
+													 : m1->n;
+				for (int j = 0; j < width; ++j)
+					acc[j] = 0;
+				// Four lines of the second matrix are added at once, so every
+				// accumulator is loaded (and stored) four times less
+				int k = k0;
+				for (; k + 4 <= k1; k += 4) {
+					const matrix_elem *ai = m1->info[i] + k;
+					multiply_acc a0 = ai[0], a1 = ai[1], a2 = ai[2], a3 = ai[3];
+					const matrix_elem *b0 = m2->info[k] + j0;
+					const matrix_elem *b1 = m2->info[k + 1] + j0;
+					const matrix_elem *b2 = m2->info[k + 2] + j0;
+					const matrix_elem *b3 = m2->info[k + 3] + j0;
+					for (int j = 0; j < width; ++j)
+						acc[j] += a0 * b0[j] + a1 * b1[j] + a2 * b2[j] +
+								  a3 * b3[j];
+				}
+				for (; k < k1; ++k) {
+					multiply_acc aik = m1->info[i][k];
+					const matrix_elem *bk = m2->info[k] + j0;
+					for (int j = 0; j < width; ++j)
+						acc[j] += aik * bk[j];
+				}
+				for (int j = 0; j < width; ++j)
+					line[j] += acc[j];
+			}
+			// Correct for the last statement update
+			for (int j = 0; j < width; ++j)
+				mat->info[i][j0 + j] = (matrix_elem)((line[j] % MOD + MOD) %
+													 MOD);
+		}
+	}
+	free(line);
+	free(acc);
+}
+
+// This function selects the arithmetic back end of the naive method (one of
+// the MULTIPLY_BACKEND_* values). It returns 0 if the back end can't be used
+// with this MOD.
+int multiply_set_backend(int backend)
+{
+	if (backend < 0 || backend >= MULTIPLY_BACKENDS)
+		return 0;
+#ifndef MULTIPLY_MADD_CHUNK
+	if (backend == MULTIPLY_BACKEND_MADD)
+		return 0;
+#endif
+	multiply_backend = backend;
+	return 1;
+}
+
+// This function returns the arithmetic back end of the naive method
+int multiply_get_backend(void)
+{
+	return multiply_backend;
+}
+
+// This function returns the name of a back end (as used by --backend)
+const char *multiply_backend_name(int backend)
+{
+	static const char *names[MULTIPLY_BACKENDS] = {"int64", "fma", "madd"};
+	return names[backend];
+}
+
+// This function looks up a back end by its name. It returns -1 if there is no
+// such back end.
+int multiply_backend_lookup(const char *name)
+{
+	for (int backend = 0; backend < MULTIPLY_BACKENDS; ++backend)
+		if (!strcmp(name, multiply_backend_name(backend)))
+			return backend;
+	return -1;
+}
+
+// This utility computes mat = m1 x m2 (mat is already allocated) using
+// doubles. A block of MULTIPLY_FMA_BLOCK columns of m2 is converted at a time;
+// every line of the result is then accumulated MULTIPLY_FMA_STRIP columns at
+// once (in registers). Every product and every partial sum is an integer
+// below 2^53, so nothing is ever rounded; after MULTIPLY_FMA_CHUNK products,
+// the sums are moved to long longs anyway.
+void multiply_matrices_fma_utility(matrix_ptr m1, matrix_ptr m2,
+								   matrix_ptr mat)
+{
+	int n = m1->n;
+	double *panel = safe_malloc(safe_mul(safe_mul(n, MULTIPLY_FMA_BLOCK),
+										 sizeof(double)));
+	long long line[MULTIPLY_FMA_BLOCK];
+
+	for (int j0 = 0; j0 < (mat->n); j0 += MULTIPLY_FMA_BLOCK) {
+		int width = mat->n - j0 < MULTIPLY_FMA_BLOCK ? mat->n - j0
+													 : MULTIPLY_FMA_BLOCK;
+		for (int k = 0; k < n; ++k)
+			for (int j = 0; j < width; ++j)
+				panel[(size_t)k * width + j] = m2->info[k][j0 + j];
+
+		for (int i = 0; i < (m1->m); ++i) {
+			const matrix_elem *ai = m1->info[i];
+			for (int j = 0; j < width; ++j)
+				line[j] = 0;
+			for (int k0 = 0; k0 < n; k0 += MULTIPLY_FMA_CHUNK) {
+				int k1 = n - k0 < MULTIPLY_FMA_CHUNK ? n
+													 : k0 + MULTIPLY_FMA_CHUNK;
+				int j = 0;
+				for (; j + MULTIPLY_FMA_STRIP <= width;
+					 j += MULTIPLY_FMA_STRIP) {
+					double acc[MULTIPLY_FMA_STRIP] = {0};
+					for (int k = k0; k < k1; ++k) {
+						double aik = ai[k];
+						const double *bk = panel + (size_t)k * width + j;
+						for (int s = 0; s < MULTIPLY_FMA_STRIP; ++s)
+							acc[s] = multiply_fma(aik, bk[s], acc[s]);
+					}
+					for (int s = 0; s < MULTIPLY_FMA_STRIP; ++s)
+						line[j + s] += (long long)acc[s];
+				}
+				// The last few columns don't fill a strip
+				for (; j < width; ++j) {
+					double acc = 0;
+					for (int k = k0; k < k1; ++k)
+						acc = multiply_fma(ai[k], panel[(size_t)k * width + j],
+										   acc);
+					line[j] += (long long)acc;
+				}
+			}
+			// Correct for the last statement update
+			for (int j = 0; j < width; ++j)
+				mat->info[i][j0 + j] = (matrix_elem)((line[j] % MOD + MOD) %
+													 MOD);
+		}
+	}
+
+	free(panel);
+}
+
+#ifdef MULTIPLY_MADD_CHUNK
+// This utility adds up the products of a line of m1 (pairs q0 to q1) and a
+// strip of MULTIPLY_MADD_STRIP columns of a block (whose lines are interleaved
+// two by two, see below) into line. Every pair of products fits in an int;
+// MULTIPLY_MADD_CHUNK pairs fit in the accumulators.
+static void multiply_matrices_madd_strip(const matrix_elem *bq, int width,
+										 const matrix_elem *ai, int n,
+										 int q0, int q1, long long *line)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+	// The pair (a0, a1) is repeated in every 32-bit lane; pmaddwd multiplies
+	// it by (b[k][j], b[k + 1][j]) and adds up the two products
+#ifdef __AVX2__
+	__m256i acc = _mm256_setzero_si256();
+#else
+	__m128i acc[2] = {_mm_setzero_si128(), _mm_setzero_si128()};
+#endif
+	for (int q = q0; q < q1; ++q) {
+		int a0 = ai[2 * q], a1 = 2 * q + 1 < n ? ai[2 * q + 1] : 0;
+		int pair = (int)((unsigned int)(unsigned short)a0 |
+						 (unsigned int)(unsigned short)a1 << 16);
+		const matrix_elem *b = bq + (size_t)q * 2 * width;
+#ifdef __AVX2__
+		acc = _mm256_add_epi32(acc, _mm256_madd_epi16(
+			_mm256_loadu_si256((const __m256i *)b), _mm256_set1_epi32(pair)));
+#else
+		__m128i ab = _mm_set1_epi32(pair);
+		for (int r = 0; r < 2; ++r)
+			acc[r] = _mm_add_epi32(acc[r], _mm_madd_epi16(
+				_mm_loadu_si128((const __m128i *)b + r), ab));
+#endif
+	}
+	int sums[MULTIPLY_MADD_STRIP];
+#ifdef __AVX2__
+	_mm256_storeu_si256((__m256i *)sums, acc);
+#else
+	_mm_storeu_si128((__m128i *)sums, acc[0]);
+	_mm_storeu_si128((__m128i *)sums + 1, acc[1]);
+#endif
+	for (int s = 0; s < MULTIPLY_MADD_STRIP; ++s)
+		line[s] += sums[s];
+#else
+	// Without pmaddwd, the same pairs are added up by plain C
+	int acc[MULTIPLY_MADD_STRIP] = {0};
+	for (int q = q0; q < q1; ++q) {
+		int a0 = ai[2 * q], a1 = 2 * q + 1 < n ? ai[2 * q + 1] : 0;
+		const matrix_elem *b = bq + (size_t)q * 2 * width;
+		for (int s = 0; s < MULTIPLY_MADD_STRIP; ++s)
+			acc[s] += a0 * b[2 * s] + a1 * b[2 * s + 1];
+	}
+	for (int s = 0; s < MULTIPLY_MADD_STRIP; ++s)
+		line[s] += acc[s];
+#endif
+}
+#endif
+
+// This utility computes mat = m1 x m2 (mat is already allocated) using pairs
+// of 16-bit products (pmaddwd). In a block of MULTIPLY_MADD_BLOCK columns of
+// m2, the lines k and k + 1 are interleaved, so the two elements that are
+// multiplied by a pair of m1's elements are next to each other. The pairs are
+// added up in ints, MULTIPLY_MADD_CHUNK at a time, before they are added to
+// long longs. It only works for MOD <= 32768 (16-bit elements).
+void multiply_matrices_madd_utility(matrix_ptr m1, matrix_ptr m2,
+									matrix_ptr mat)
+{
+#ifdef MULTIPLY_MADD_CHUNK
+	int n = m1->n, pairs = (n + 1) / 2;
+	matrix_elem *panel = safe_malloc(safe_mul(safe_mul(pairs,
+													   2 * MULTIPLY_MADD_BLOCK),
+											  sizeof(matrix_elem)));
+	long long line[MULTIPLY_MADD_BLOCK];
+
+	for (int j0 = 0; j0 < (mat->n); j0 += MULTIPLY_MADD_BLOCK) {
+		int width = mat->n - j0 < MULTIPLY_MADD_BLOCK ? mat->n - j0
+													  : MULTIPLY_MADD_BLOCK;
+		// If n is odd, the last line is paired with a line of zeros
+		for (int k = 0; k < 2 * pairs; ++k)
+			for (int j = 0; j < width; ++j)
+				panel[(size_t)(k / 2) * 2 * width + 2 * j + k % 2] =
+					k < n ? m2->info[k][j0 + j] : 0;
+
+		for (int i = 0; i < (m1->m); ++i) {
+			const matrix_elem *ai = m1->info[i];
+			for (int j = 0; j < width; ++j)
+				line[j] = 0;
+			for (int q0 = 0; q0 < pairs; q0 += MULTIPLY_MADD_CHUNK) {
+				int q1 = pairs - q0 < MULTIPLY_MADD_CHUNK
+						 ? pairs : q0 + MULTIPLY_MADD_CHUNK;
+				int j = 0;
+				for (; j + MULTIPLY_MADD_STRIP <= width;
+					 j += MULTIPLY_MADD_STRIP)
+					multiply_matrices_madd_strip(panel + 2 * j, width, ai, n,
+												 q0, q1, line + j);
+				// The last few columns don't fill a strip
+				for (; j < width; ++j) {
+					int acc = 0;
+					for (int q = q0; q < q1; ++q) {
+						const matrix_elem *b = panel + (size_t)q * 2 * width;
+						acc += ai[2 * q] * b[2 * j] +
+							   (2 * q + 1 < n ? ai[2 * q + 1] : 0) *
+							   b[2 * j + 1];
+					}
+					line[j] += acc;
+				}
+			}
+			// Correct for the last statement update
+			for (int j = 0; j < width; ++j)
+				mat->info[i][j0 + j] = (matrix_elem)((line[j] % MOD + MOD) %
+													 MOD);
+		}
+	}
+
+	free(panel);
+#else
+	multiply_matrices_dot_utility(m1, m2, mat);
+#endif
+}
+
 // This function  multiplies two matrices using the Strassen method. It is worth
 // mentioning that this algorithm is theoretically faster than the naive one,
 // computing the result in O(n^log7) complexity.
-// Please note: this function only works for (2^n) x (2^n) matrices!
+// Please note: this function only works for (2^n) x (2^n) matrices! Anything
+// else is passed to the naive algorithm.
 matrix_ptr multiply_matrices_strassen(matrix_ptr m1, matrix_ptr m2)
 {
-	// Check that we can perform the multiplication
-	if (m1->n != m2->m) {
-		printf(INVALID_MULTIPLY);
+	// Check that we can perform the multiplication (the caller reports the
+	// error, since it knows where the output goes)
+	if (m1->n != m2->m)
 		return NULL;
+
+	int n = m1->n;
+	if (m1->m != n || m2->n != n || (n & (n - 1)))
+		return multiply_matrices(m1, m2);
+
+	// The recursion can't be split between the workers without sending the
+	// sums of the blocks around at every level, so big products are passed to
+	// the SUMMA-style multiplication instead (see 'matrices_distributed')
+	if (dist_worth(n, n, n)) {
+		matrix_ptr mat = dist_multiply(m1, m2);
+		if (mat)
+			return mat;
 	}
 
+	// The operands are packed (and widened) into contiguous arrays. The
+	// recursion needs another n^2 ints of workspace (see the utility below).
+	// n^2 doesn't fit in an int for n >= 2^16, so every index is a size_t.
+	size_t bytes = safe_mul((long long)n * n, sizeof(int));
+	int *a = safe_malloc(bytes);
+	int *b = safe_malloc(bytes);
+	int *c = safe_malloc(bytes);
+	int *work = safe_malloc(bytes);
+	for (int i = 0; i < n; ++i) {
+		for (int j = 0; j < n; ++j) {
+			a[(size_t)i * n + j] = m1->info[i][j];
+			b[(size_t)i * n + j] = m2->info[i][j];
+		}
+	}
+
+	// The "brain" of the multiplication is called. The size below which the
+	// blocks are multiplied using the naive method is tuned (see
+	// 'octave_tuning')
+	multiply_matrices_strassen_utility(a, n, MOD - 1, b, n, MOD - 1,
+									   c, n, n, work,
+									   tune_lookup(n)->strassen_cutoff);
+
 	// Abbreviation for the resulting matrix
 	matrix_ptr mat = safe_malloc(sizeof(matrix));
+	mat->m = n;
+	mat->n = n;
+	mat->refs = NULL;
+	mat->info = alloc_matrix_lines(n, n);
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			mat->info[i][j] = (matrix_elem)c[(size_t)i * n + j];
 
-	// The "brain" of the multiplication is called
-	multiply_matrices_strassen_utility(m1, m2, mat);
+	free(a);
+	free(b);
+	free(c);
+	free(work);
 
 	// The sum of the elements has to be computed at the end, since it has been
 	// lost during the operations
@@ -75,247 +532,166 @@ matrix_ptr multiply_matrices_strassen(matrix_ptr m1, matrix_ptr m2)
 }
 
 // This function is the "brain" of the Strassen multiplication algorithm. This
-// is a recursively called function that computes this result: c = a x b.
-void multiply_matrices_strassen_utility(matrix_ptr a,
-										matrix_ptr b,
-										matrix_ptr c)
+// is a recursively called function that computes this result: c = a x b, where
+// every matrix is a (n x n) block of a bigger array (a starts at a[0] and its
+// lines are lda ints apart, and so on). The elements of a and b are at most
+// bound_a / bound_b in absolute value; the elements of c are reduced to
+// [0, MOD). work must have room for n^2 ints. Blocks of at most cutoff x cutoff
+// elements are multiplied using the naive method.
+//
+// The Winograd variant is used - it only needs 15 additions per level instead
+// of 18. The additions of the operands (s1-s4, t1-t4) are fused into packing
+// them, while the combination of the 7 products is accumulated, without any
+// reduction, straight into the blocks of c, which are reduced once, at the end:
+//   s1 = a21 + a22   s2 = s1 - a11   s3 = a11 - a21   s4 = a12 - s2
+//   t1 = b12 - b11   t2 = b22 - t1   t3 = b22 - b12   t4 = t2 - b21
+//   p1 = a11 b11  p2 = a12 b21  p3 = s4 b22  p4 = a22 t4
+//   p5 = s1 t1    p6 = s2 t2    p7 = s3 t3
+//   c11 = p1 + p2            c12 = p1 + p6 + p5 + p3
+//   c21 = p1 + p6 + p7 - p4  c22 = p1 + p6 + p7 + p5
+void multiply_matrices_strassen_utility(const int *a, size_t lda,
+										long long bound_a,
+										const int *b, size_t ldb,
+										long long bound_b,
+										int *c, size_t ldc, int n, int *work,
+										int cutoff)
 {
-	if (a->n == 1) { // Multiplying two numbers is trivial - a and b are 1x1
-		c->n = 1;
-		c->m = 1;
-		c->info = safe_malloc(sizeof(int *));
-		c->info[0] = safe_malloc(sizeof(int));
-		long long aux = a->info[0][0];
-		aux *= (long long)b->info[0][0];
-		aux %= (long long)MOD;
-		c->info[0][0] = aux;
+	if (n <= cutoff) {
+		multiply_matrices_strassen_base_utility(a, lda, b, ldb, c, ldc, n);
 		return;
 	}
 
-	// Matrix a will be divided in four submatrices of equal size, called am1,
-	// am2, am3 and am4. Similarly, b will be divided into bm1, bm2, bm3, bm4.
-	int nn = a->n / 2;
-	matrix am1, am2, am3, am4, bm1, bm2, bm3, bm4;
-	multiply_matrices_strassen_set_abm_utility(&am1, &am2, &am3, &am4,
-											   &bm1, &bm2, &bm3, &bm4,
-											   nn, a, b, c);
-
-	// Auxiliar variables, used to compute sums / diffs and in-between results;
-	// Compute the 7 "m" variables (see details bellow)
-	matrix m_1, m_2, m1, m2, m3, m4, m5, m6, m7;
-	multiply_matrices_strassen_set_m17_utility(&am1, &am2, &am3, &am4,
-											   &bm1, &bm2, &bm3, &bm4,
-											   &m1, &m2, &m3, &m4, &m5,
-											   &m6, &m7, &m_1, &m_2);
-
-	// Using the calculated matrices, create the final result
-	for (int i = 0; i < nn; ++i) {
-		for (int j = 0; j < nn; ++j) {
-			c->info[i][j] = // c1 = m1 + m4 -m5 + m7
-				m1.info[i][j] + m4.info[i][j] - m5.info[i][j] + m7.info[i][j];
-			c->info[i][j + nn] = // c2 = m3 + m5
-				m3.info[i][j] + m5.info[i][j];
-			c->info[i + nn][j] = // c3 = m2 + m4
-				m2.info[i][j] + m4.info[i][j];
-			c->info[i + nn][j + nn] = // c4 = m1 - m2 + m3 + m6
-				m1.info[i][j] - m2.info[i][j] + m3.info[i][j] + m6.info[i][j];
+	// Both matrices are divided in four submatrices of equal size. Those are
+	// never copied - they are just pointers inside the bigger arrays.
+	int h = n / 2;
+	const int *a11 = a, *a12 = a + h, *a21 = a + h * lda, *a22 = a21 + h;
+	const int *b11 = b, *b12 = b + h, *b21 = b + h * ldb, *b22 = b21 + h;
+	int *c11 = c, *c12 = c + h, *c21 = c + h * ldc, *c22 = c21 + h;
 
-			// Correct for the last statement update
-			c->info[i][j] = ((c->info[i][j] % MOD) + MOD) % MOD;
-			c->info[i][j + nn] = ((c->info[i][j + nn] % MOD) + MOD) % MOD;
-			c->info[i + nn][j] = ((c->info[i + nn][j] % MOD) + MOD) % MOD;
-			c->info[i + nn][j + nn] = ((c->info[i + nn][j + nn] % MOD) + MOD)
-									  % MOD;
-		}
-	}
-	// Free the used resources that are no longer required
-	free_matrix(&am1);
-	free_matrix(&am2);
-	free_matrix(&am3);
-	free_matrix(&am4);
-	free_matrix(&bm1);
-	free_matrix(&bm2);
-	free_matrix(&bm3);
-	free_matrix(&bm4);
-	free_matrix(&m_1);
-	free_matrix(&m_2);
-	free_matrix(&m1);
-	free_matrix(&m2);
-	free_matrix(&m3);
-	free_matrix(&m4);
-	free_matrix(&m5);
-	free_matrix(&m6);
-	free_matrix(&m7);
+	// The workspace holds the packed operands (s, t) and a product (p). The
+	// rest of it is passed down to the recursive calls.
+	size_t hh = (size_t)h * h;
+	int *s = work, *t = work + hh, *p = work + 2 * hh;
+	int *next = work + 3 * hh;
+	long long bound_s, bound_t;
+
+	// c12 = p1, c11 = p1 + p2
+	multiply_matrices_strassen_utility(a11, lda, bound_a, b11, ldb, bound_b,
+									   c12, ldc, h, next, cutoff);
+	multiply_matrices_strassen_utility(a12, lda, bound_a, b21, ldb, bound_b,
+									   p, h, h, next, cutoff);
+	multiply_matrices_strassen_add_utility(c11, ldc, c12, ldc, p, h, 1, h);
+
+	// c22 = p5
+	bound_s = multiply_matrices_strassen_pack_utility(s, a21, lda, bound_a,
+													  a22, lda, bound_a, 1, h);
+	bound_t = multiply_matrices_strassen_pack_utility(t, b12, ldb, bound_b,
+													  b11, ldb, bound_b, -1, h);
+	multiply_matrices_strassen_utility(s, h, bound_s, t, h, bound_t,
+									   c22, ldc, h, next, cutoff);
+
+	// c12 = p1 + p6, c22 = p1 + p6 + p5
+	bound_s = multiply_matrices_strassen_pack_utility(s, s, h, bound_s,
+													  a11, lda, bound_a, -1, h);
+	bound_t = multiply_matrices_strassen_pack_utility(t, b22, ldb, bound_b,
+													  t, h, bound_t, -1, h);
+	multiply_matrices_strassen_utility(s, h, bound_s, t, h, bound_t,
+									   p, h, h, next, cutoff);
+	multiply_matrices_strassen_add_utility(c12, ldc, c12, ldc, p, h, 1, h);
+	multiply_matrices_strassen_add_utility(c22, ldc, c22, ldc, c12, ldc, 1, h);
+
+	// c21 = p1 + p6 - p4
+	bound_t = multiply_matrices_strassen_pack_utility(t, t, h, bound_t,
+													  b21, ldb, bound_b, -1, h);
+	multiply_matrices_strassen_utility(a22, lda, bound_a, t, h, bound_t,
+									   p, h, h, next, cutoff);
+	multiply_matrices_strassen_add_utility(c21, ldc, c12, ldc, p, h, -1, h);
+
+	// c12 = p1 + p6 + p5 + p3 (the final value)
+	bound_s = multiply_matrices_strassen_pack_utility(s, a12, lda, bound_a,
+													  s, h, bound_s, -1, h);
+	multiply_matrices_strassen_utility(s, h, bound_s, b22, ldb, bound_b,
+									   p, h, h, next, cutoff);
+	multiply_matrices_strassen_add_utility(c12, ldc, c22, ldc, p, h, 1, h);
+
+	// c21 += p7, c22 += p7 (the final values)
+	bound_s = multiply_matrices_strassen_pack_utility(s, a11, lda, bound_a,
+													  a21, lda, bound_a, -1, h);
+	bound_t = multiply_matrices_strassen_pack_utility(t, b22, ldb, bound_b,
+													  b12, ldb, bound_b, -1, h);
+	multiply_matrices_strassen_utility(s, h, bound_s, t, h, bound_t,
+									   p, h, h, next, cutoff);
+	multiply_matrices_strassen_add_utility(c21, ldc, c21, ldc, p, h, 1, h);
+	multiply_matrices_strassen_add_utility(c22, ldc, c22, ldc, p, h, 1, h);
+
+	// Every block is at most 4 products away from [0, MOD); reduce them once
+	multiply_matrices_strassen_reduce_utility(c, ldc, n);
 }
 
-// This function divides matrices a and b into 4 chunks each. This function also
-// allocates the memory needed by the final matrix, matrix c.
-void multiply_matrices_strassen_set_abm_utility(matrix_ptr am1, matrix_ptr am2,
-												matrix_ptr am3, matrix_ptr am4,
-												matrix_ptr bm1, matrix_ptr bm2,
-												matrix_ptr bm3, matrix_ptr bm4,
-												int nn,
-												matrix_ptr a,
-												matrix_ptr b,
-												matrix_ptr c)
+// This function multiplies two small blocks using the naive method: c = a x b.
+// The elements of a and b are small enough (see STRASSEN_BOUND) for a whole
+// line of c to be accumulated in long longs, which are only reduced at the end.
+void multiply_matrices_strassen_base_utility(const int *a, size_t lda,
+											 const int *b, size_t ldb,
+											 int *c, size_t ldc, int n)
 {
-	am1->n = nn;
-	am1->m = nn;
-	am1->info = safe_malloc(nn * sizeof(int *));
-	am2->n = nn;
-	am2->m = nn;
-	am2->info = safe_malloc(nn * sizeof(int *));
-	am3->n = nn;
-	am3->m = nn;
-	am3->info = safe_malloc(nn * sizeof(int *));
-	am4->n = nn;
-	am4->m = nn;
-	am4->info = safe_malloc(nn * sizeof(int *));
-	bm1->n = nn;
-	bm1->m = nn;
-	bm1->info = safe_malloc(nn * sizeof(int *));
-	bm2->n = nn;
-	bm2->m = nn;
-	bm2->info = safe_malloc(nn * sizeof(int *));
-	bm3->n = nn;
-	bm3->m = nn;
-	bm3->info = safe_malloc(nn * sizeof(int *));
-	bm4->n = nn;
-	bm4->m = nn;
-	bm4->info = safe_malloc(nn * sizeof(int *));
-
-	// Inserting the information into our new submatrices.
-	// Also, setting some of the resulting matrix's parameters
-	c->info = safe_malloc((a->n) * sizeof(int *));
-	c->n = 2 * nn;
-	c->m = 2 * nn;
-	for (int i = 0; i < nn; ++i) {
-		// An engineer's trick, if you may - since we are only passing through
-		// nn steps, we will use a similar trick to the one we use to visit a
-		// binary tree - go to positions 2*i and 2*i+1. This means we will go
-		// to all 2*nn arrays of c->info.
-		c->info[2 * i] = safe_malloc((a->n) * sizeof(int));
-		c->info[2 * i + 1] = safe_malloc((a->n) * sizeof(int));
-
-		am1->info[i] = safe_malloc(nn * sizeof(int));
-		am2->info[i] = safe_malloc(nn * sizeof(int));
-		am3->info[i] = safe_malloc(nn * sizeof(int));
-		am4->info[i] = safe_malloc(nn * sizeof(int));
-		bm1->info[i] = safe_malloc(nn * sizeof(int));
-		bm2->info[i] = safe_malloc(nn * sizeof(int));
-		bm3->info[i] = safe_malloc(nn * sizeof(int));
-		bm4->info[i] = safe_malloc(nn * sizeof(int));
-
-		for (int j = 0; j < nn; ++j) {
-			am1->info[i][j] = a->info[i][j];
-			am2->info[i][j] = a->info[i][j + nn];
-			am3->info[i][j] = a->info[i + nn][j];
-			am4->info[i][j] = a->info[i + nn][j + nn];
-			bm1->info[i][j] = b->info[i][j];
-			bm2->info[i][j] = b->info[i][j + nn];
-			bm3->info[i][j] = b->info[i + nn][j];
-			bm4->info[i][j] = b->info[i + nn][j + nn];
+	long long line[TUNE_MAX_STRASSEN_CUTOFF];
+	for (int i = 0; i < n; ++i) {
+		for (int j = 0; j < n; ++j)
+			line[j] = 0;
+		// The i-k-j order walks through b line by line
+		for (int k = 0; k < n; ++k) {
+			long long aik = a[i * lda + k];
+			const int *bk = b + k * ldb;
+			for (int j = 0; j < n; ++j)
+				line[j] += aik * bk[j];
 		}
+		for (int j = 0; j < n; ++j)
+			c[i * ldc + j] = (int)((line[j] % MOD + MOD) % MOD);
 	}
 }
 
-// This part of the algorithm requires us to compute 7 matrices with some
-// specific formulas. These can be found in the document that was provided
-// with the task's instructions. This function is responsible with those
-// computations.
-void multiply_matrices_strassen_set_m17_utility(matrix_ptr am1,
-												matrix_ptr am2,
-												matrix_ptr am3,
-												matrix_ptr am4,
-												matrix_ptr bm1,
-												matrix_ptr bm2,
-												matrix_ptr bm3,
-												matrix_ptr bm4,
-												matrix_ptr m1,
-												matrix_ptr m2,
-												matrix_ptr m3,
-												matrix_ptr m4,
-												matrix_ptr m5,
-												matrix_ptr m6,
-												matrix_ptr m7,
-												matrix_ptr m_1,
-												matrix_ptr m_2)
+// This utility packs x + sign * y (two (n x n) blocks) into dst, which has
+// lines of n ints. dst may be x or y itself. The bounds of x and y are added;
+// if the result gets too big (see STRASSEN_BOUND), the sum is reduced while it
+// is packed. The function returns the bound of dst.
+long long multiply_matrices_strassen_pack_utility(int *dst,
+												  const int *x, size_t ldx,
+												  long long bound_x,
+												  const int *y, size_t ldy,
+												  long long bound_y,
+												  int sign, int n)
 {
-	multiply_matrices_strassen_sum_utility(am1, am4, m_1); // am1 + am4
-	multiply_matrices_strassen_sum_utility(bm1, bm4, m_2); // bm1 + bm4
-	multiply_matrices_strassen_utility(m_1, m_2, m1); // (am1+am4)*(bm1+bm4)
-	free_matrix(m_1); // Reusable, has to be freed
-	free_matrix(m_2); // Reusable, has to be freed
-
-	multiply_matrices_strassen_sum_utility(am3, am4, m_1); // am3 + am4
-	multiply_matrices_strassen_utility(m_1, bm1, m2); // (am3+am4)*bm1
-	free_matrix(m_1); // Reusable, has to be freed
-
-	multiply_matrices_strassen_dif_utility(bm2, bm4, m_2); // bm2 - bm4
-	multiply_matrices_strassen_utility(am1, m_2, m3); // am1*(bm2-bm4)
-	free_matrix(m_2); // Reusable, has to be freed
-
-	multiply_matrices_strassen_dif_utility(bm3, bm1, m_2); // bm3 - bm1
-	multiply_matrices_strassen_utility(am4, m_2, m4); // am4*(bm3-bm1)
-	free_matrix(m_2); // Reusable, has to be freed
-
-	multiply_matrices_strassen_sum_utility(am1, am2, m_1); // am1 - am2
-	multiply_matrices_strassen_utility(m_1, bm4, m5); // (am1-am2)*bm4
-	free_matrix(m_1); // Reusable, has to be freed
-
-	multiply_matrices_strassen_dif_utility(am3, am1, m_1); // am3 - am1
-	multiply_matrices_strassen_sum_utility(bm1, bm2, m_2); // bm1 - bm2
-	multiply_matrices_strassen_utility(m_1, m_2, m6); // (am3-am1)*(bm1-bm2)
-	free_matrix(m_1); // Reusable, has to be freed
-	free_matrix(m_2); // Reusable, has to be freed
-
-	multiply_matrices_strassen_dif_utility(am2, am4, m_1); // am2 - am4
-	multiply_matrices_strassen_sum_utility(bm3, bm4, m_2); // bm3 - bm4
-	multiply_matrices_strassen_utility(m_1, m_2, m7); // (am2-am4)*(bm3-bm4)
-	free_matrix(m_1); // Reusable, has to be freed
-	free_matrix(m_2); // Reusable, has to be freed
+	long long bound = bound_x + bound_y;
+	if (bound <= STRASSEN_BOUND) {
+		for (int i = 0; i < n; ++i)
+			for (int j = 0; j < n; ++j)
+				dst[(size_t)i * n + j] = x[i * ldx + j] + sign * y[i * ldy + j];
+		return bound;
+	}
+
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			dst[(size_t)i * n + j] = (x[i * ldx + j] +
+									  sign * y[i * ldy + j]) % MOD;
+	return MOD - 1;
 }
 
-// This utility is used to compute c = a + b
-void multiply_matrices_strassen_sum_utility(matrix_ptr a,
-											matrix_ptr b,
-											matrix_ptr c)
+// This utility is used to compute dst = x + sign * y, without any reduction
+void multiply_matrices_strassen_add_utility(int *dst, size_t ldd,
+											const int *x, size_t ldx,
+											const int *y, size_t ldy,
+											int sign, int n)
 {
-	// Initially, c = a.
-	// Note: to skip the "free_matrix" call inside clone_matrix, we set these
-	// variables to 0. This ensures no signal 11 and a faster algorithm overall
-	c->info = NULL;
-	c->n = 0;
-	c->m = 0;
-	clone_matrix(c, a);
-
-	// Then, for all practical reasons, we do c += b
-	for (int i = 0; i < (c->n); ++i) {
-		for (int j = 0; j < (c->n); ++j) {
-			c->info[i][j] += b->info[i][j];
-			c->info[i][j] %= MOD;
-		}
-	}
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			dst[i * ldd + j] = x[i * ldx + j] + sign * y[i * ldy + j];
 }
 
-// This utility is used to compute c = a - b
-void multiply_matrices_strassen_dif_utility(matrix_ptr a,
-											matrix_ptr b,
-											matrix_ptr c)
+// This utility reduces every element of a (n x n) block to [0, MOD)
+void multiply_matrices_strassen_reduce_utility(int *c, size_t ldc, int n)
 {
-	// Initially, c = a.
-	// Note: to skip the "free_matrix" call inside clone_matrix, we set these
-	// variables to 0. This ensures no signal 11 and a faster algorithm overall
-	c->info = NULL;
-	c->n = 0;
-	c->m = 0;
-	clone_matrix(c, a);
-
-	// Then, for all practical reasons, we do c -= b
-	for (int i = 0; i < (c->n); ++i) {
-		for (int j = 0; j < (c->n); ++j) {
-			c->info[i][j] -= b->info[i][j];
-			c->info[i][j] %= MOD;
-		}
-	}
+	for (int i = 0; i < n; ++i)
+		for (int j = 0; j < n; ++j)
+			c[i * ldc + j] = (c[i * ldc + j] % MOD + MOD) % MOD;
 }
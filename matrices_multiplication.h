@@ -8,74 +8,194 @@
 // multiplication algorithm).
 
 // Standard library dependencies
+#include <math.h> // fma, FP_FAST_FMA
 #include <stdio.h> // printf, scanf
+#include <string.h> // strcmp
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h> // _mm_madd_epi16, _mm256_madd_epi16
+#endif
 
 // Other dependencies
 #include "matrices_base.h"
+#include "matrices_distributed.h" // dist_worth, dist_multiply
 #include "matrices_output.h"
 #include "matrices_errors.h"
+#include "matrices_shared.h" // alloc_matrix_lines
+#include "octave_tuning.h" // tune_lookup
 #include "safe_utilities.h" // safe_malloc
 
 // This function multiplies two matrices (indexes at1, at2) and appends the
 // result to the dynamically allocated array of matrices. The function uses
-// the naive method to compute the result.
+// the naive method to compute the result. If the matrices can't be multiplied,
+// it returns NULL.
 extern matrix_ptr multiply_matrices(matrix_ptr m1, matrix_ptr m2);
 
+// This utility computes mat = m1 x m2 (mat is already allocated) using the
+// naive method, with the back end that was selected and the tuned block. The
+// operands may be views of bigger matrices (see 'matrices_linear').
+extern void multiply_matrices_naive_utility(matrix_ptr m1, matrix_ptr m2,
+											matrix_ptr mat);
+
+// This function multiplies two matrices using the original method (every
+// element is a dot product), without any of the faster kernels. It is the
+// reference the other kernels are checked against.
+extern matrix_ptr multiply_matrices_reference(matrix_ptr m1, matrix_ptr m2);
+
+// This utility allocates a (m x n) matrix for a product
+extern matrix_ptr multiply_matrices_alloc_utility(int m, int n);
+
+// This utility computes mat = m1 x m2 (mat is already allocated), every
+// element on its own, as a dot product
+extern void multiply_matrices_dot_utility(matrix_ptr m1, matrix_ptr m2,
+										  matrix_ptr mat);
+
+// This function multiplies two matrices when one of them, or the result, is a
+// vector (an outer, matrix-vector or vector-matrix product)
+extern matrix_ptr multiply_matrices_thin(matrix_ptr m1, matrix_ptr m2);
+
+// This utility computes the outer product of a column and a line
+extern void multiply_matrices_outer_utility(matrix_ptr m1, matrix_ptr m2,
+											matrix_ptr mat);
+
+// This utility computes the product of a matrix and a column
+extern void multiply_matrices_gemv_utility(matrix_ptr m1, matrix_ptr m2,
+										   matrix_ptr mat);
+
+// This utility computes mat = m1 x m2 (mat is already allocated) using the
+// i-k-j order, a block of columns of the result at a time
+extern void multiply_matrices_blocked_utility(matrix_ptr m1, matrix_ptr m2,
+											  matrix_ptr mat, int block);
+
+// The naive method adds up the products in narrow accumulators (which
+// vectorize better), MULTIPLY_CHUNK products at a time (a multiple of four),
+// before adding them to long longs. With the default MOD, 20 products fit in
+// an int.
+#if MOD <= 23171
+#define MULTIPLY_CHUNK (0x7fffffff / ((MOD - 1) * (MOD - 1)) / 4 * 4)
+typedef int multiply_acc;
+#else
+#define MULTIPLY_CHUNK 1
+typedef long long multiply_acc;
+#endif
+
+// The matrix-vector product adds up the products in this many independent
+// accumulators (16 ints fill a 512-bit vector register)
+#define MULTIPLY_LANES 16
+
+// The vector-matrix product computes this many columns of the result at once,
+// so the accumulators stay in the cache while the second matrix is streamed
+#define MULTIPLY_VECTOR_BLOCK 4096
+
+// The arithmetic back ends of the naive method (--backend). Every one of them
+// computes the exact result; they only differ in the units of the CPU they use.
+#define MULTIPLY_BACKEND_INT64 0 // products widened to long long (the default)
+#define MULTIPLY_BACKEND_FMA 1 // doubles, multiplied and added at once
+#define MULTIPLY_BACKEND_MADD 2 // pairs of 16-bit products (pmaddwd)
+#define MULTIPLY_BACKENDS 3
+
+// A double represents every integer below 2^53 exactly, and every product is
+// smaller than MOD^2 (in absolute value), so this many products can be added up
+// in a double without any rounding (about 90 million for the default MOD)
+#define MULTIPLY_FMA_CHUNK \
+	((int)((1LL << 53) / ((long long)(MOD - 1) * (MOD - 1))))
+// The FMA back end converts this many columns of the second matrix at once and
+// computes MULTIPLY_FMA_STRIP of them at a time (in registers)
+#define MULTIPLY_FMA_BLOCK 64
+#define MULTIPLY_FMA_STRIP 8
+
+// The multiplication and the addition are only fused if the CPU can do it fast
+// (otherwise, fma would be a slow library call). Both are exact anyway.
+#ifdef FP_FAST_FMA
+#define multiply_fma(a, b, c) fma(a, b, c)
+#else
+#define multiply_fma(a, b, c) ((a) * (b) + (c))
+#endif
+
+// The madd back end needs 16-bit elements. A pair of products is smaller than
+// 2 * MOD^2, so it fits in an int, and MULTIPLY_MADD_CHUNK pairs do too (10 for
+// the default MOD).
+#if MOD <= 32768
+#define MULTIPLY_MADD_CHUNK \
+	((int)(0x7fffffff / (2LL * (MOD - 1) * (MOD - 1))))
+#endif
+// The madd back end interleaves this many columns of the second matrix at once
+// and computes MULTIPLY_MADD_STRIP of them at a time (a 256-bit register)
+#define MULTIPLY_MADD_BLOCK 64
+#define MULTIPLY_MADD_STRIP 8
+
+// The packed operands of the Strassen algorithm are only reduced once their
+// elements could get bigger than this. With operands this small, a whole line
+// of a block multiplied using the naive method (see TUNE_MAX_STRASSEN_CUTOFF)
+// fits in a long long: 256 * 2^26 * 2^26 < 2^63.
+#define STRASSEN_BOUND (1LL << 26)
+
+// This function selects the arithmetic back end of the naive method (one of
+// the MULTIPLY_BACKEND_* values). It returns 0 if the back end can't be used
+// with this MOD.
+extern int multiply_set_backend(int backend);
+
+// This function returns the arithmetic back end of the naive method
+extern int multiply_get_backend(void);
+
+// This function returns the name of a back end (as used by --backend)
+extern const char *multiply_backend_name(int backend);
+
+// This function looks up a back end by its name. It returns -1 if there is no
+// such back end.
+extern int multiply_backend_lookup(const char *name);
+
+// This utility computes mat = m1 x m2 (mat is already allocated) using doubles
+// (see MULTIPLY_FMA_CHUNK)
+extern void multiply_matrices_fma_utility(matrix_ptr m1, matrix_ptr m2,
+										  matrix_ptr mat);
+
+// This utility computes mat = m1 x m2 (mat is already allocated) using pairs
+// of 16-bit products (see MULTIPLY_MADD_CHUNK)
+extern void multiply_matrices_madd_utility(matrix_ptr m1, matrix_ptr m2,
+										   matrix_ptr mat);
+
 // This function  multiplies two matrices using the Strassen method. It is worth
 // mentioning that this algorithm is theoretically faster than the naive one,
 // computing the result in O(n^log7) complexity.
-// Please note: this function only works for (2^n) x (2^n) matrices!
+// Please note: this function only works for (2^n) x (2^n) matrices! Anything
+// else is passed to the naive algorithm.
 extern matrix_ptr multiply_matrices_strassen(matrix_ptr m1, matrix_ptr m2);
 
 // This function is the "brain" of the Strassen multiplication algorithm. This
-// is a recursively called function that computes this result: c = a x b.
-extern void multiply_matrices_strassen_utility(matrix_ptr a,
-											   matrix_ptr b,
-											   matrix_ptr c);
-
-// This function divides matrices a and b into 4 chunks each. This function also
-// allocates the memory needed by the final matrix, matrix c.
-extern void multiply_matrices_strassen_set_abm_utility(matrix_ptr am1,
-													   matrix_ptr am2,
-													   matrix_ptr am3,
-													   matrix_ptr am4,
-													   matrix_ptr bm1,
-													   matrix_ptr bm2,
-													   matrix_ptr bm3,
-													   matrix_ptr bm4,
-													   int nn,
-													   matrix_ptr a,
-													   matrix_ptr b,
-													   matrix_ptr c);
-
-// This part of the algorithm requires us to compute 7 matrices with some
-// specific formulas. These can be found in the document that was provided
-// with the task's instructions. This function is responsible with those
-// computations.
-extern void multiply_matrices_strassen_set_m17_utility(matrix_ptr am1,
-													   matrix_ptr am2,
-													   matrix_ptr am3,
-													   matrix_ptr am4,
-													   matrix_ptr bm1,
-													   matrix_ptr bm2,
-													   matrix_ptr bm3,
-													   matrix_ptr bm4,
-													   matrix_ptr m1,
-													   matrix_ptr m2,
-													   matrix_ptr m3,
-													   matrix_ptr m4,
-													   matrix_ptr m5,
-													   matrix_ptr m6,
-													   matrix_ptr m7,
-													   matrix_ptr m_1,
-													   matrix_ptr m_2);
-
-// This utility is used to compute c = a + b
-extern void multiply_matrices_strassen_sum_utility(matrix_ptr a, matrix_ptr b,
-												   matrix_ptr c);
-
-// This utility is used to compute c = a - b
-extern void multiply_matrices_strassen_dif_utility(matrix_ptr a, matrix_ptr b,
-												   matrix_ptr c);
+// is a recursively called function that computes this result: c = a x b, where
+// every matrix is a (n x n) block of a bigger array. It uses the Winograd
+// variant, which needs 15 additions per level. Below cutoff, the blocks are
+// multiplied using the naive method, which is faster for small matrices.
+extern void multiply_matrices_strassen_utility(const int *a, size_t lda,
+											   long long bound_a,
+											   const int *b, size_t ldb,
+											   long long bound_b,
+											   int *c, size_t ldc, int n,
+											   int *work, int cutoff);
+
+// This function multiplies two small blocks using the naive method: c = a x b
+extern void multiply_matrices_strassen_base_utility(const int *a, size_t lda,
+													const int *b, size_t ldb,
+													int *c, size_t ldc, int n);
+
+// This utility packs x + sign * y into dst and returns the bound of dst
+extern long long multiply_matrices_strassen_pack_utility(int *dst,
+														 const int *x,
+														 size_t ldx,
+														 long long bound_x,
+														 const int *y,
+														 size_t ldy,
+														 long long bound_y,
+														 int sign, int n);
+
+// This utility is used to compute dst = x + sign * y, without any reduction
+extern void multiply_matrices_strassen_add_utility(int *dst, size_t ldd,
+												   const int *x, size_t ldx,
+												   const int *y, size_t ldy,
+												   int sign, int n);
+
+// This utility reduces every element of a (n x n) block to [0, MOD)
+extern void multiply_matrices_strassen_reduce_utility(int *c, size_t ldc,
+													  int n);
 
 #endif // MATRICES_MULTIPLICATION_H
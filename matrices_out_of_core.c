@@ -0,0 +1,192 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// pread and pwrite are POSIX functions; the spill file may grow past 2GB
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+// Include the asscociated header file
+#include "matrices_out_of_core.h"
+
+// Standard library dependencies
+#include <errno.h> // errno, EINTR
+#include <string.h> // memcpy, memset
+#include <unistd.h> // pread, pwrite
+
+// This function returns 1 if the product of two matrices doesn't fit in the
+// memory budget and should be computed out of core
+int ooc_worth(matrix_ptr m1, matrix_ptr m2)
+{
+	if (!mm_budget() || m1->n != m2->m)
+		return 0;
+
+	// The result's bytes are computed just like mm_matrix_bytes does
+	unsigned long long result = (unsigned long long)m1->m *
+								(sizeof(matrix_elem *) +
+								 (unsigned long long)m2->n *
+								 sizeof(matrix_elem));
+	return mm_matrix_bytes(m1) + mm_matrix_bytes(m2) + result > mm_budget();
+}
+
+// This function reads some lines of a matrix (see 'ooc_read'). It can be used
+// as a thread's function.
+void *ooc_read_lines(void *arg)
+{
+	ooc_read_ptr req = arg;
+	matrix_ptr mat = req->mat;
+
+	// A pinned matrix can't be spilled in the meantime, so it's either in
+	// memory or in the spill file for the whole multiplication
+	if (!mat->spilled) {
+		for (long long i = 0; i < req->count; ++i)
+			memcpy(req->dst + i * mat->n, mat->info[req->first + i],
+				   mat->n * sizeof(matrix_elem));
+		return NULL;
+	}
+
+	char *dst = (char *)req->dst;
+	size_t left = req->count * mat->n * sizeof(matrix_elem);
+	off_t at = mat->spill_offset + req->first * mat->n * sizeof(matrix_elem);
+	while (left) {
+		ssize_t r = pread(req->fd, dst, left, at);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			mm_fatal("read from");
+		dst += r;
+		at += r;
+		left -= r;
+	}
+	return NULL;
+}
+
+// This function writes count elements of the result to the spill file
+void ooc_write_elems(int fd, long long offset, const matrix_elem *src,
+					 long long count)
+{
+	const char *p = (const char *)src;
+	size_t left = count * sizeof(matrix_elem);
+	while (left) {
+		ssize_t w = pwrite(fd, p, left, (off_t)offset);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w <= 0)
+			mm_fatal("write to");
+		p += w;
+		offset += w;
+		left -= w;
+	}
+}
+
+// This function starts reading a panel on another thread. If no thread can be
+// created, the panel is read right away. It returns 1 if a thread was created.
+static int ooc_prefetch(ooc_read_ptr req, pthread_t *thread)
+{
+	if (!pthread_create(thread, NULL, ooc_read_lines, req))
+		return 1;
+
+	ooc_read_lines(req);
+	return 0;
+}
+
+// This function multiplies two matrices out of core. Both of them must be
+// pinned (see 'mm_pin'); the result is spilled (and already tracked).
+matrix_ptr ooc_multiply(matrix_ptr m1, matrix_ptr m2)
+{
+	long long m = m1->m, n = m1->n, p = m2->n;
+	unsigned long long budget = mm_budget();
+	int fd = mm_spill_fd();
+
+	// Half of the window holds the two panels of the second matrix, the other
+	// half a block of lines of the first matrix and the same lines of the
+	// result (in long longs and as they are written). Even with a tiny budget,
+	// a single line is used.
+	long long panel = budget / 2 / (2 * p * sizeof(matrix_elem));
+	panel = panel < 1 ? 1 : (panel > n ? n : panel);
+	long long block = budget / 2 / (n * sizeof(matrix_elem) +
+									p * (sizeof(long long) +
+										 sizeof(matrix_elem)));
+	block = block < 1 ? 1 : (block > m ? m : block);
+
+	matrix_elem *a = safe_malloc(safe_mul(block * n, sizeof(matrix_elem)));
+	matrix_elem *b[2];
+	b[0] = safe_malloc(safe_mul(panel * p, sizeof(matrix_elem)));
+	b[1] = safe_malloc(safe_mul(panel * p, sizeof(matrix_elem)));
+	long long *acc = safe_malloc(safe_mul(block * p, sizeof(long long)));
+	matrix_elem *c = safe_malloc(safe_mul(block * p, sizeof(matrix_elem)));
+	matrix_elem **lines = safe_malloc(safe_mul(block, sizeof(matrix_elem *)));
+
+	// The result's content goes straight to the spill file
+	matrix_ptr mat = safe_malloc(sizeof(matrix));
+	mat->m = m;
+	mat->n = p;
+	mat->refs = NULL;
+	long long offset = mm_allocate_extent(m * p * sizeof(matrix_elem));
+	long long sum = 0;
+
+	// The first panel is requested before anything else
+	ooc_read req[2];
+	pthread_t thread;
+	req[0] = (ooc_read){m2, 0, panel, b[0], fd};
+	int pending = ooc_prefetch(&req[0], &thread), cur = 0;
+
+	for (long long r0 = 0; r0 < m; r0 += block) {
+		long long rows = m - r0 < block ? m - r0 : block;
+		ooc_read lines_a = {m1, r0, rows, a, fd};
+		ooc_read_lines(&lines_a);
+		memset(acc, 0, rows * p * sizeof(long long));
+
+		for (long long k0 = 0; k0 < n; k0 += panel) {
+			long long kb = n - k0 < panel ? n - k0 : panel;
+			if (pending)
+				pthread_join(thread, NULL);
+
+			// Request the next panel (the first one again, for the next block
+			// of lines) while this one is multiplied
+			pending = 0;
+			if (k0 + panel < n || r0 + block < m) {
+				long long next = k0 + panel < n ? k0 + panel : 0;
+				long long count = n - next < panel ? n - next : panel;
+				req[!cur] = (ooc_read){m2, next, count, b[!cur], fd};
+				pending = ooc_prefetch(&req[!cur], &thread);
+			}
+
+			// acc += a[:, k0:k0 + kb] x panel, in the i-k-j order. Every
+			// product is smaller than MOD^2, so n of them fit in a long long.
+			for (long long i = 0; i < rows; ++i) {
+				long long *line = acc + i * p;
+				const matrix_elem *ai = a + i * n + k0;
+				for (long long k = 0; k < kb; ++k) {
+					long long aik = ai[k];
+					const matrix_elem *bk = b[cur] + k * p;
+					for (long long j = 0; j < p; ++j)
+						line[j] += aik * bk[j];
+				}
+			}
+			cur = !cur;
+		}
+
+		// Reduce the block, add it to the sum and write it
+		for (long long i = 0; i < rows; ++i) {
+			const long long *line = acc + i * p;
+			for (long long j = 0; j < p; ++j)
+				c[i * p + j] = (matrix_elem)((line[j] % MOD + MOD) % MOD);
+			lines[i] = c + i * p;
+		}
+		matrix view = {.info = lines, .m = rows, .n = p};
+		matrix_update_sum(&view);
+		sum = (sum + view.elem_sum) % MOD;
+		ooc_write_elems(fd, offset + r0 * p * sizeof(matrix_elem), c,
+						rows * p);
+	}
+
+	free(a);
+	free(b[0]);
+	free(b[1]);
+	free(acc);
+	free(c);
+	free(lines);
+
+	mat->elem_sum = sum;
+	mm_track_spilled(mat, offset);
+	return mat;
+}
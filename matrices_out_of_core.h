@@ -0,0 +1,58 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef MATRICES_OUT_OF_CORE_H
+#define MATRICES_OUT_OF_CORE_H
+
+// This file contains the out-of-core multiplication. When a memory budget is
+// set (see 'matrices_memory') and the operands and the result of a product
+// don't fit in it together, the operands are not read back - the product is
+// computed from the spill file, through a window of memory that respects the
+// budget. The result is written straight to the spill file, too.
+//
+// The result is computed in blocks of whole lines: a block of lines of the
+// first matrix is read once, then the second matrix is streamed, a panel of
+// lines at a time, and the block of the result is accumulated in long longs.
+// While a panel is multiplied, the next one is read by another thread (double
+// buffering). Every read is a single, contiguous one, since the spill file
+// stores the matrices line by line.
+
+// Standard library dependencies
+#include <pthread.h> // pthread_create, pthread_join
+#include <stdlib.h> // free
+
+// Other dependencies
+#include "matrices_base.h"
+#include "matrices_memory.h" // mm_budget, mm_pin, mm_track_spilled
+#include "safe_utilities.h" // safe_malloc
+
+// A read of some lines of a matrix (which may or may not be spilled)
+typedef struct {
+	matrix_ptr mat;
+	// The lines [first, first + count) are read into dst
+	long long first, count;
+	matrix_elem *dst;
+	// The spill file
+	int fd;
+} ooc_read;
+
+// Note: The following typedef is kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef ooc_read * ooc_read_ptr;
+
+// This function returns 1 if the product of two matrices doesn't fit in the
+// memory budget and should be computed out of core
+extern int ooc_worth(matrix_ptr m1, matrix_ptr m2);
+
+// This function reads some lines of a matrix (see 'ooc_read'). It can be used
+// as a thread's function.
+extern void *ooc_read_lines(void *arg);
+
+// This function writes count elements of the result to the spill file
+extern void ooc_write_elems(int fd, long long offset, const matrix_elem *src,
+							long long count);
+
+// This function multiplies two matrices out of core. Both of them must be
+// pinned (see 'mm_pin'); the result is spilled (and already tracked).
+extern matrix_ptr ooc_multiply(matrix_ptr m1, matrix_ptr m2);
+
+#endif // MATRICES_OUT_OF_CORE_H
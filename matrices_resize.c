@@ -3,24 +3,49 @@
 // Include the asscociated header file
 #include "matrices_resize.h"
 
+// This function returns 1 if the given lines and columns are every line and
+// every column of the matrix, in order (so resizing it changes nothing)
+int resize_keeps_all(matrix_ptr mat, const int *lines, int lines_count,
+					 const int *cols, int cols_count)
+{
+	if (lines_count != mat->m || cols_count != mat->n)
+		return 0;
+	for (int i = 0; i < lines_count; ++i)
+		if (lines[i] != i)
+			return 0;
+	for (int j = 0; j < cols_count; ++j)
+		if (cols[j] != j)
+			return 0;
+	return 1;
+}
+
 // It creates a new matrix which only contains the given lines and columns. In
-// the end, the new matrix is moved in place of the one to be modified
+// the end, the new matrix is moved in place of the one to be modified. If
+// everything is kept, the new matrix shares the old one's content (see
+// 'matrices_shared'), so the old one has to be released before it is freed.
 matrix_ptr resize_matrix(matrix_ptr old_matrix,
 						 int *lines, int lines_count,
 						 int *cols, int cols_count)
 {
 	// Create the new matrix
 	matrix_ptr new_matrix = safe_malloc(sizeof(matrix));
+
+	// Nothing changes, so nothing has to be copied
+	if (resize_keeps_all(old_matrix, lines, lines_count, cols, cols_count)) {
+		share_matrix(new_matrix, old_matrix);
+		return new_matrix;
+	}
+
 	new_matrix->m = lines_count;
 	new_matrix->n = cols_count;
+	new_matrix->refs = NULL;
 
 	// Add the needed info to the new matrix. Also, make sure the required
 	// memory is correctly allocated. Also also, make sure the sum is computed
 	// in the meantime
-	new_matrix->info = safe_malloc((new_matrix->m) * sizeof(int *));
+	new_matrix->info = alloc_matrix_lines(lines_count, cols_count);
 	new_matrix->elem_sum = 0;
 	for (int i = 0; i < lines_count; ++i) {
-		new_matrix->info[i] = safe_malloc((new_matrix->n) * sizeof(int));
 		for (int j = 0; j < cols_count; ++j) {
 			new_matrix->info[i][j] = old_matrix->info[lines[i]][cols[j]];
 			new_matrix->elem_sum += new_matrix->info[i][j];
@@ -13,10 +13,18 @@
 // Other dependencies
 #include "matrices_errors.h"
 #include "matrices_base.h"
+#include "matrices_shared.h" // share_matrix, alloc_matrix_lines
 #include "safe_utilities.h" // safe_malloc
 
+// This function returns 1 if the given lines and columns are every line and
+// every column of the matrix, in order (so resizing it changes nothing)
+extern int resize_keeps_all(matrix_ptr mat, const int *lines, int lines_count,
+							const int *cols, int cols_count);
+
 // It creates a new matrix which only contains the given lines and columns. In
-// the end, the new matrix is moved in place of the one to be modified
+// the end, the new matrix is moved in place of the one to be modified. If
+// everything is kept, the new matrix shares the old one's content (see
+// 'matrices_shared'), so the old one has to be released before it is freed.
 extern matrix_ptr resize_matrix(matrix_ptr old_matrix,
 								int *lines, int lines_count,
 								int *cols, int cols_count);
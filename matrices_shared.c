@@ -0,0 +1,133 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "matrices_shared.h"
+
+// The counters of every shared content are protected by this lock
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// This function allocates the content of a (m x n) matrix: the array of lines
+// and every line (which isn't initialized)
+matrix_elem **alloc_matrix_lines(int m, int n)
+{
+	size_t row = safe_mul(n, sizeof(matrix_elem));
+	size_t whole = safe_mul(m, row);
+	matrix_elem **info = safe_malloc(safe_mul(m, sizeof(*info)));
+
+	// Every line is allocated before the hints are given, while (apart from
+	// malloc's headers) the memory wasn't touched yet
+	uintptr_t low = UINTPTR_MAX, high = 0;
+	for (int i = 0; i < m; ++i) {
+		info[i] = safe_malloc(row);
+		if ((uintptr_t)info[i] < low)
+			low = (uintptr_t)info[i];
+		if ((uintptr_t)info[i] + row > high)
+			high = (uintptr_t)info[i] + row;
+	}
+	if (!m)
+		return info;
+
+	// Small lines are usually next to each other, so the memory between the
+	// first and the last one (nothing but lines and headers) is advised at
+	// once. Otherwise (e.g. big lines that malloc mapped on their own), every
+	// line is advised by itself.
+	if (high - low <= whole + (size_t)m * 64)
+		safe_advise((void *)low, high - low, whole);
+	else
+		for (int i = 0; i < m; ++i)
+			safe_advise(info[i], row, whole);
+	return info;
+}
+
+// This function makes a matrix use the content of another one (mathematically,
+// to = from, just like clone_matrix), without copying it
+void share_matrix(matrix_ptr to, matrix_ptr from)
+{
+	// The first clone creates the counter (the original is its first user).
+	// It is allocated outside of the lock, since safe_malloc may spill.
+	int *refs = from->refs ? NULL : safe_malloc(sizeof(int));
+	pthread_mutex_lock(&shared_lock);
+	if (!from->refs) {
+		from->refs = refs;
+		*from->refs = 1;
+		refs = NULL;
+	}
+	++*from->refs;
+	to->refs = from->refs;
+	pthread_mutex_unlock(&shared_lock);
+	free(refs);
+
+	to->info = from->info;
+	to->m = from->m;
+	to->n = from->n;
+	to->elem_sum = from->elem_sum;
+}
+
+// This function must be called before a matrix's content is changed in place.
+// If the content is used by other matrices too, the matrix gets its own copy.
+void unshare_matrix(matrix_ptr mat)
+{
+	if (!mat->refs)
+		return;
+
+	// If everyone else let go, the content is this matrix's own again
+	pthread_mutex_lock(&shared_lock);
+	int alone = *mat->refs == 1;
+	if (alone) {
+		free(mat->refs);
+		mat->refs = NULL;
+	}
+	pthread_mutex_unlock(&shared_lock);
+	if (alone)
+		return;
+
+	// The copy is made before the content is let go: safe_malloc may spill
+	// the other users (which would free the content if we didn't use it)
+	size_t row = safe_mul(mat->n, sizeof(matrix_elem));
+	matrix_elem **info = alloc_matrix_lines(mat->m, mat->n);
+	for (int i = 0; i < mat->m; ++i)
+		memcpy(info[i], mat->info[i], row);
+
+	// Everyone else may have let go in the meantime
+	if (!unref_matrix(mat)) {
+		for (int i = 0; i < mat->m; ++i)
+			free(mat->info[i]);
+		free(mat->info);
+	}
+	mat->info = info;
+}
+
+// This function makes a matrix stop using its content. It returns 1 if the
+// content is still used by other matrices (so it must not be freed).
+int unref_matrix(matrix_ptr mat)
+{
+	if (!mat->refs)
+		return 0;
+
+	pthread_mutex_lock(&shared_lock);
+	int shared = --*mat->refs > 0;
+	pthread_mutex_unlock(&shared_lock);
+	if (!shared)
+		free(mat->refs);
+	mat->refs = NULL;
+	return shared;
+}
+
+// This function must be called before a matrix is freed (or removed from the
+// array). A matrix whose content is still used by others is left empty.
+void release_matrix(matrix_ptr mat)
+{
+	if (unref_matrix(mat)) {
+		mat->info = NULL;
+		mat->m = 0;
+		mat->n = 0;
+	}
+}
+
+// This function releases every matrix in the array (it has to be called before
+// dm_free_all_matrices)
+void dm_release_all_matrices(d_matrices_ptr dm)
+{
+	for (int i = 0; i < dm->matrices_count; ++i)
+		release_matrix(dm->matrices[i]);
+}
@@ -0,0 +1,66 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef MATRICES_SHARED_H
+#define MATRICES_SHARED_H
+
+// This file contains the shared (copy-on-write) matrices. A matrix's content
+// (info and its lines) may be used by more than one matrix at a time: a clone
+// made by share_matrix doesn't copy anything, it just counts one more user of
+// the content. The content is only copied when one of the matrices is about
+// to be changed in place (unshare_matrix), and it is only freed by its last
+// user.
+//
+// The clones are made by 'C' (and resize_matrix) when every line and every
+// column is kept, and by the library (olib_matrix_clone, olib_resize). 'C' and
+// 'T' build new matrices anyway; the in-place commands (a, b, h, k) unshare
+// the matrix they change.
+//
+// The functions in 'matrices_base' free the content without asking, so every
+// matrix has to be released (release_matrix) before it is freed - a matrix
+// whose content is still used by others is left empty, so free_matrix,
+// dm_free_matrix and dm_replace_matrix don't free anything. The library's
+// batches clone matrices from several threads, so the counters have a lock of
+// their own.
+//
+// The content of a new matrix is allocated by alloc_matrix_lines: every line
+// is still a block of its own (so the functions in 'matrices_base' can free
+// it), but the kernel's hints for big allocations (see 'octave_topology') are
+// given for the matrix as a whole. The lines of a big matrix are usually small
+// (those of a 4096 x 4096 matrix have 16K), so safe_malloc alone wouldn't
+// advise any of them.
+
+// Standard library dependencies
+#include <pthread.h> // pthread_mutex_lock
+#include <stdint.h> // uintptr_t
+#include <stdlib.h> // free
+#include <string.h> // memcpy
+
+// Other dependencies
+#include "matrices_base.h"
+#include "safe_utilities.h" // safe_malloc, safe_mul, safe_advise
+
+// This function allocates the content of a (m x n) matrix: the array of lines
+// and every line (which isn't initialized)
+extern matrix_elem **alloc_matrix_lines(int m, int n);
+
+// This function makes a matrix use the content of another one (mathematically,
+// to = from, just like clone_matrix), without copying it
+extern void share_matrix(matrix_ptr to, matrix_ptr from);
+
+// This function must be called before a matrix's content is changed in place.
+// If the content is used by other matrices too, the matrix gets its own copy.
+extern void unshare_matrix(matrix_ptr mat);
+
+// This function makes a matrix stop using its content. It returns 1 if the
+// content is still used by other matrices (so it must not be freed).
+extern int unref_matrix(matrix_ptr mat);
+
+// This function must be called before a matrix is freed (or removed from the
+// array). A matrix whose content is still used by others is left empty.
+extern void release_matrix(matrix_ptr mat);
+
+// This function releases every matrix in the array (it has to be called before
+// dm_free_all_matrices)
+extern void dm_release_all_matrices(d_matrices_ptr dm);
+
+#endif // MATRICES_SHARED_H
@@ -10,7 +10,7 @@ void merge_sort(matrix_ptr_ptr to_sort, int from, int to)
 {
 	// We need a temporary array to use with the same size
 	int tmp_size = to - from + 1;
-	matrix_ptr_ptr tmp = safe_malloc(tmp_size * sizeof(matrix_ptr));
+	matrix_ptr_ptr tmp = safe_malloc(safe_mul(tmp_size, sizeof(matrix_ptr)));
 	for (int i = 0; i < tmp_size; ++i)
 		tmp[i] = NULL;
 
@@ -12,17 +12,16 @@ matrix_ptr transpose_matrix(matrix_ptr old_matrix)
 	// Switch m and n
 	new_matrix->m = old_matrix->n;
 	new_matrix->n = old_matrix->m;
+	new_matrix->refs = NULL;
 
 	// The sum doesn't change
 	new_matrix->elem_sum = old_matrix->elem_sum;
 
 	// Compute the transposed matrix
-	new_matrix->info = safe_malloc((new_matrix->m) * sizeof(int *));
-	for (int i = 0; i < (new_matrix->m); ++i) {
-		new_matrix->info[i] = safe_malloc((new_matrix->n) * sizeof(int));
+	new_matrix->info = alloc_matrix_lines(new_matrix->m, new_matrix->n);
+	for (int i = 0; i < (new_matrix->m); ++i)
 		for (int j = 0; j < (new_matrix->n); ++j)
 			new_matrix->info[i][j] = old_matrix->info[j][i];
-	}
 
 	return new_matrix;
 }
@@ -7,7 +7,8 @@
 
 // Other dependencies
 #include "matrices_base.h"
-#include "safe_utilities.h" // safe_malloc
+#include "matrices_shared.h" // alloc_matrix_lines
+#include "safe_utilities.h" // safe_malloc, safe_mul
 
 // This function transforms a matrix of size m x n into a matrix with size n x m
 extern matrix_ptr transpose_matrix(matrix_ptr old_matrix);
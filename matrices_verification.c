@@ -0,0 +1,153 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "matrices_verification.h"
+
+// The verification is shared by the whole program
+static matrices_verification verify;
+
+// This function returns the next pseudo-random number (xorshift64*)
+static unsigned long long verify_next(unsigned long long *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+// This function returns the dot product of a line and a vector, in [0, MOD).
+// The elements of the vector are in [0, MOD), so every product is smaller than
+// MOD^2 and the sum only has to be reduced once.
+static int verify_dot(const matrix_elem *line, const int *v, int n)
+{
+	long long sum = 0;
+	for (int k = 0; k < n; ++k)
+		sum += (long long)line[k] * v[k];
+	return (int)((sum % MOD + MOD) % MOD);
+}
+
+// This function sets up the verification. fraction is the fraction of the
+// products that are checked (0 = none, 1 = all of them).
+void verify_init(double fraction, int fallback, unsigned long long seed)
+{
+	verify.fraction = fraction;
+	verify.fallback = fallback;
+	verify.state = seed ? seed : 1;
+	verify.products = 0;
+	verify.checked = 0;
+	verify.failed = 0;
+	verify.skipped = 0;
+	verify.product_ns = 0;
+	verify.verify_ns = 0;
+	pthread_mutex_init(&verify.lock, NULL);
+}
+
+// This function returns 1 if the products are verified
+int verify_enabled(void)
+{
+	return verify.fraction > 0;
+}
+
+// This function checks if mat is the product of m1 and m2. It returns 0 if it
+// isn't (for VERIFY_ROUNDS random vectors, see above).
+int verify_freivalds(matrix_ptr m1, matrix_ptr m2, matrix_ptr mat,
+					 const unsigned long long *seeds)
+{
+	int m = m1->m, n = m1->n, p = m2->n;
+	if (mat->m != m || mat->n != p)
+		return 0;
+
+	int *r = safe_malloc(safe_mul(p, sizeof(int)));
+	int *x = safe_malloc(safe_mul(n, sizeof(int)));
+	int ok = 1;
+	for (int round = 0; ok && round < VERIFY_ROUNDS; ++round) {
+		unsigned long long state = seeds[round] | 1;
+		for (int j = 0; j < p; ++j)
+			r[j] = (int)(verify_next(&state) % MOD);
+
+		// x = B r, then C r and A x are compared line by line
+		for (int k = 0; k < n; ++k)
+			x[k] = verify_dot(m2->info[k], r, p);
+		for (int i = 0; ok && i < m; ++i)
+			ok = verify_dot(mat->info[i], r, p) ==
+				 verify_dot(m1->info[i], x, n);
+	}
+
+	free(r);
+	free(x);
+	return ok;
+}
+
+// This function is called for every product (command at1 at2), which took ns
+// nanoseconds to compute. It returns the product (or, if it was wrong and the
+// fallback is enabled, the right one).
+matrix_ptr verify_product(char command, int at1, int at2,
+						  matrix_ptr m1, matrix_ptr m2, matrix_ptr mat,
+						  unsigned long long ns)
+{
+	// The decision and the random vectors are drawn together, so the sessions
+	// of the server don't share the generator while verifying
+	unsigned long long seeds[VERIFY_ROUNDS];
+	pthread_mutex_lock(&verify.lock);
+	++verify.products;
+	verify.product_ns += ns;
+	double draw = (verify_next(&verify.state) >> 11) / 9007199254740992.0;
+	for (int round = 0; round < VERIFY_ROUNDS; ++round)
+		seeds[round] = verify_next(&verify.state);
+	pthread_mutex_unlock(&verify.lock);
+
+	if (draw >= verify.fraction)
+		return mat;
+
+	unsigned long long start = octave_stats_clock();
+	int ok = verify_freivalds(m1, m2, mat, seeds);
+	if (!ok) {
+		fprintf(stderr, "Verification failed: %c %d %d ((%d x %d) x (%d x %d))"
+				"%s\n", command, at1, at2, m1->m, m1->n, m2->m, m2->n,
+				verify.fallback ? ", computing it again" : "");
+		if (verify.fallback) {
+			free_matrix(mat);
+			free(mat);
+			mat = multiply_matrices_reference(m1, m2);
+		}
+	}
+	ns = octave_stats_clock() - start;
+
+	pthread_mutex_lock(&verify.lock);
+	++verify.checked;
+	verify.failed += !ok;
+	verify.verify_ns += ns;
+	pthread_mutex_unlock(&verify.lock);
+
+	return mat;
+}
+
+// This function counts a product that can't be verified (e.g. one that was
+// computed out of core, whose result isn't in memory)
+void verify_skip(void)
+{
+	pthread_mutex_lock(&verify.lock);
+	++verify.products;
+	++verify.skipped;
+	pthread_mutex_unlock(&verify.lock);
+}
+
+// This function outputs the counters and the overhead of the verification
+void verify_report(FILE *out)
+{
+	double product_ms = verify.product_ns / 1e6;
+	double verify_ms = verify.verify_ns / 1e6;
+	fprintf(out, "Verification: %llu of %llu products checked, %llu failed, "
+			"%llu skipped\n", verify.checked, verify.products, verify.failed,
+			verify.skipped);
+	fprintf(out, "Verification: %.3f ms spent verifying, %.3f ms spent "
+			"multiplying (%.2f%% overhead)\n", verify_ms, product_ms,
+			product_ms > 0 ? verify_ms / product_ms * 100 : 0.0);
+}
+
+// This function frees everything
+void verify_free(void)
+{
+	pthread_mutex_destroy(&verify.lock);
+	verify.fraction = 0;
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef MATRICES_VERIFICATION_H
+#define MATRICES_VERIFICATION_H
+
+// This file contains the verification of the products ('M' and 'S'). With
+// --verify, every product (or, with --verify=FRACTION, a random fraction of
+// them) is checked using Freivalds' algorithm: for a random vector r, the
+// result C of A x B is right if C r = A (B r) (mod MOD). That only takes three
+// matrix-vector products - O(n^2) instead of the O(n^3) of a second
+// multiplication. A wrong result passes the test with a probability of at most
+// 1 / MOD for every vector; VERIFY_ROUNDS vectors are tried.
+//
+// A failure is reported to stderr, with the command and the operands' sizes.
+// With --verify-fallback, the wrong result is replaced by the one of the
+// reference (dot product) kernel, multiply_matrices_reference. The time spent
+// verifying is compared to the time spent multiplying when the program ends.
+
+// Standard library dependencies
+#include <pthread.h> // pthread_mutex_t
+#include <stdio.h> // fprintf
+#include <stdlib.h> // free
+
+// Other dependencies
+#include "matrices_base.h"
+#include "matrices_multiplication.h" // multiply_matrices_reference
+#include "octave_stats.h" // octave_stats_clock
+#include "safe_utilities.h" // safe_malloc, safe_mul
+
+// The number of random vectors every product is checked with
+#define VERIFY_ROUNDS 1
+
+// The verification structure (there is a single one per program)
+typedef struct {
+	// fraction = the fraction of the products that are checked (0 = none)
+	double fraction;
+	// fallback = 1 if a wrong result should be computed again
+	int fallback;
+	// The state of the pseudo-random number generator (xorshift64*)
+	unsigned long long state;
+	// The counters, for the report
+	unsigned long long products, checked, failed, skipped;
+	unsigned long long product_ns, verify_ns;
+	// The sessions of the server verify their products at the same time
+	pthread_mutex_t lock;
+} matrices_verification;
+
+// This function sets up the verification. fraction is the fraction of the
+// products that are checked (0 = none, 1 = all of them).
+extern void verify_init(double fraction, int fallback, unsigned long long seed);
+
+// This function returns 1 if the products are verified
+extern int verify_enabled(void);
+
+// This function checks if mat is the product of m1 and m2. It returns 0 if it
+// isn't (for VERIFY_ROUNDS random vectors, see above).
+extern int verify_freivalds(matrix_ptr m1, matrix_ptr m2, matrix_ptr mat,
+							const unsigned long long *seeds);
+
+// This function is called for every product (command at1 at2), which took ns
+// nanoseconds to compute. It returns the product (or, if it was wrong and the
+// fallback is enabled, the right one).
+extern matrix_ptr verify_product(char command, int at1, int at2,
+								 matrix_ptr m1, matrix_ptr m2, matrix_ptr mat,
+								 unsigned long long ns);
+
+// This function counts a product that can't be verified (e.g. one that was
+// computed out of core, whose result isn't in memory)
+extern void verify_skip(void);
+
+// This function outputs the counters and the overhead of the verification
+extern void verify_report(FILE *out);
+
+// This function frees everything
+extern void verify_free(void);
+
+#endif // MATRICES_VERIFICATION_H
@@ -1,80 +1,152 @@
 // Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
 
+// pthread_rwlock_t is a POSIX feature
+#define _POSIX_C_SOURCE 200809L
+
 // Include the asscociated header file
 #include "octave.h"
 
+// These functions lock / unlock the array of matrices (for reading or, if
+// exclusive is set, for writing). They do nothing if the array isn't shared.
+void octave_lock(octave_session_ptr s, int exclusive)
+{
+	// If the whole command is exclusive, the lock is already held
+	if (!s->lock || s->exclusive)
+		return;
+
+	if (exclusive)
+		pthread_rwlock_wrlock(s->lock);
+	else
+		pthread_rwlock_rdlock(s->lock);
+}
+
+void octave_unlock(octave_session_ptr s)
+{
+	if (s->lock && !s->exclusive)
+		pthread_rwlock_unlock(s->lock);
+}
+
+// Checks if a given index is valid. If it isn't, it outputs an error message
+// and returns 0.
+int octave_is_valid_at(octave_session_ptr s, int at)
+{
+	if (s->out == stdout)
+		return dm_is_valid_at(s->dm, at);
+
+	if (at < 0 || at >= s->dm->matrices_count) {
+		fprintf(s->out, INVALID_INDEX);
+		return 0;
+	}
+	return 1;
+}
+
+// This function outputs a matrix's dimensions
+void octave_print_matrix_size(octave_session_ptr s, matrix_ptr mat)
+{
+	if (s->out == stdout)
+		print_matrix_size(mat);
+	else
+		fprintf(s->out, "%d %d\n", mat->m, mat->n);
+}
+
+// This function outputs a matrix's content
+void octave_print_matrix(octave_session_ptr s, matrix_ptr mat)
+{
+	if (s->out == stdout) {
+		print_matrix(mat);
+		return;
+	}
+
+	for (int i = 0; i < mat->m; ++i) {
+		for (int j = 0; j < mat->n; ++j)
+			fprintf(s->out, "%d ", mat->info[i][j]);
+		fprintf(s->out, "\n");
+	}
+}
+
 // This function is called when the 'L' command is issued. It reads the new
 // matrix's size and its content and appends the matrix to the end of the
 // dynamically allocated array
-void octave_task1(d_matrices_ptr dm)
+void octave_task1(octave_session_ptr s)
 {
 	// Allocate the space
 	matrix *mat = safe_malloc(sizeof(matrix));
 	// Read the matrix
-	read_matrix(mat);
+	fread_matrix(s->in, mat);
 	// Append it
-	dm_append_matrix(dm, mat);
+	octave_lock(s, 1);
+	dm_append_matrix(s->dm, mat);
+	mm_track(mat);
+	octave_unlock(s);
 }
 
 // This function is called when the 'D' command is issued. It outputs m and n,
 // the number of lines and columns of a given matrix
-void octave_task2(d_matrices_ptr dm)
+void octave_task2(octave_session_ptr s)
 {
 	int at;
-	scanf("%d", &at);
+	fscanf(s->in, "%d", &at);
 
 	// Make sure that the given index is valid
-	if (!dm_is_valid_at(dm, at))
-		return;
-
-	print_matrix_size(dm->matrices[at]);
+	octave_lock(s, 0);
+	if (octave_is_valid_at(s, at))
+		octave_print_matrix_size(s, s->dm->matrices[at]);
+	octave_unlock(s);
 }
 
 // This function is called when the 'P' command is issued. It outputs a matrix's
 // content (info)
-void octave_task3(d_matrices_ptr dm)
+void octave_task3(octave_session_ptr s)
 {
 	int at;
-	scanf("%d", &at);
+	fscanf(s->in, "%d", &at);
 
 	// Make sure that the given index is valid
-	if (!dm_is_valid_at(dm, at))
-		return;
-
-	print_matrix(dm->matrices[at]);
+	octave_lock(s, 0);
+	if (octave_is_valid_at(s, at)) {
+		mm_touch(s->dm->matrices[at]);
+		octave_print_matrix(s, s->dm->matrices[at]);
+	}
+	octave_unlock(s);
 }
 
 // This function is called when the 'C' command is issued. It reads the lines
 // and columns to be kept and then creates a new matrix which only contains
 // those. In the end, the new matrix is moved in place of the one to be modified
-void octave_task4(d_matrices_ptr dm)
+void octave_task4(octave_session_ptr s)
 {
 	int at;
-	scanf("%d", &at);
+	fscanf(s->in, "%d", &at);
 
 	// Read and allocate the lines' array
 	int lines_count, *lines;
-	scanf("%d", &lines_count);
-	lines = safe_malloc(lines_count * sizeof(int));
+	fscanf(s->in, "%d", &lines_count);
+	lines = safe_malloc(safe_mul(lines_count, sizeof(int)));
 	for (int i = 0; i < lines_count; ++i)
-		scanf("%d", &lines[i]);
+		fscanf(s->in, "%d", &lines[i]);
 
 	// Read and allocate the columns' array
 	int cols_count, *cols;
-	scanf("%d", &cols_count);
-	cols = safe_malloc(cols_count * sizeof(int));
+	fscanf(s->in, "%d", &cols_count);
+	cols = safe_malloc(safe_mul(cols_count, sizeof(int)));
 	for (int i = 0; i < cols_count; ++i)
-		scanf("%d", &cols[i]);
+		fscanf(s->in, "%d", &cols[i]);
 
 	// Make sure that the given index is valid
-	if (dm_is_valid_at(dm, at)) {
+	octave_lock(s, 1);
+	if (octave_is_valid_at(s, at)) {
 		// Call the real function
-		matrix *om = dm->matrices[at];
+		matrix *om = s->dm->matrices[at];
+		mm_touch(om);
 		matrix *nm = resize_matrix(om, lines, lines_count, cols, cols_count);
 
 		// Use the new matrix instead now
-		dm_replace_matrix(dm, at, nm);
+		mm_release(om);
+		release_matrix(om);
+		dm_replace_matrix(s->dm, at, nm);
+		mm_track(nm);
 	}
+	octave_unlock(s);
 
 	// Make sure there are no memory leaks
 	free(lines);
@@ -84,100 +156,642 @@ void octave_task4(d_matrices_ptr dm)
 // This function is called when the 'M' command is issued. It uses the obvious
 // multiplication method to multiply two matrices together and append the result
 // to the dynamically allocated array of matrices
-void octave_task5(d_matrices_ptr dm)
+void octave_task5(octave_session_ptr s)
 {
 	int at1, at2;
-	scanf("%d %d", &at1, &at2);
+	fscanf(s->in, "%d %d", &at1, &at2);
 
-	// Make sure that the given indexes are valid
-	if (!dm_is_valid_at(dm, at1) || !dm_is_valid_at(dm, at2))
+	// Make sure that the given indexes are valid. The multiplication only
+	// reads the array, so other sessions may read it at the same time
+	octave_lock(s, 0);
+	if (!octave_is_valid_at(s, at1) || !octave_is_valid_at(s, at2)) {
+		octave_unlock(s);
 		return;
+	}
 
 	// Abbreviation for the given matrices
-	matrix *m1 = dm->matrices[at1], *m2 = dm->matrices[at2];
-
-	// Call the real function
-	matrix *rez = multiply_matrices(m1, m2);
-
+	matrix *m1 = s->dm->matrices[at1], *m2 = s->dm->matrices[at2];
+
+	// Call the real function. Products that don't fit in the memory budget
+	// are computed straight from (and to) the spill file
+	matrix *rez;
+	int out_of_core = ooc_worth(m1, m2);
+	if (out_of_core) {
+		mm_pin(m1);
+		mm_pin(m2);
+		rez = ooc_multiply(m1, m2);
+		if (rez && verify_enabled())
+			verify_skip();
+	} else {
+		mm_touch(m1);
+		mm_touch(m2);
+		rez = olib_product(m1, m2, 0, 'M', at1, at2);
+	}
 	if (rez)
-		dm_append_matrix(dm, rez);
+		s->flops += 2ULL * m1->m * m1->n * m2->n;
+	else
+		fprintf(s->out, INVALID_MULTIPLY);
+	octave_unlock(s);
+
+	if (rez) {
+		octave_lock(s, 1);
+		dm_append_matrix(s->dm, rez);
+		if (!out_of_core)
+			mm_track(rez);
+		octave_unlock(s);
+	}
 }
 
 // This function is called when the 'O' command is issued. It passes the torch
 // to a more potent function, merge_sort
-void octave_task6(d_matrices_ptr dm)
+void octave_task6(octave_session_ptr s)
 {
-	merge_sort(dm->matrices, 0, dm->matrices_count - 1);
+	octave_lock(s, 1);
+	merge_sort(s->dm->matrices, 0, s->dm->matrices_count - 1);
+	octave_unlock(s);
 }
 
 // This function is called when the 'T' command is issued. It transposes a given
 // matrix by creating a new matrix with the new size (n x m) and then simply
 // fills its content with the given information
-void octave_task7(d_matrices_ptr dm)
+void octave_task7(octave_session_ptr s)
 {
 	int at;
-	scanf("%d", &at);
+	fscanf(s->in, "%d", &at);
 
 	// Make sure that the given index is valid
-	if (!dm_is_valid_at(dm, at))
+	octave_lock(s, 1);
+	if (!octave_is_valid_at(s, at)) {
+		octave_unlock(s);
 		return;
+	}
 
 	// Call the real function
-	matrix *rez = transpose_matrix(dm->matrices[at]);
+	matrix *old = s->dm->matrices[at];
+	mm_touch(old);
+	matrix *rez = transpose_matrix(old);
 
 	if (rez) {
 		// Use the new matrix instead now
-		free_matrix(dm->matrices[at]);
-		free(dm->matrices[at]);
-		dm->matrices[at] = rez;
+		mm_release(old);
+		release_matrix(old);
+		mm_track(rez);
+		free_matrix(old);
+		free(old);
+		s->dm->matrices[at] = rez;
 	}
+	octave_unlock(s);
 }
 
 // This function is called when the 'F' command is issued. It removes a matrix
 // from the array, moving every following matrix one position to the left.
-void octave_task8(d_matrices_ptr dm)
+void octave_task8(octave_session_ptr s)
 {
 	int at;
-	scanf("%d", &at);
+	fscanf(s->in, "%d", &at);
 
 	// Make sure that the given index is valid
-	if (!dm_is_valid_at(dm, at))
-		return;
-
-	// Call the real function
-	dm_free_matrix(dm, at);
+	octave_lock(s, 1);
+	if (octave_is_valid_at(s, at)) {
+		// Call the real function
+		mm_release(s->dm->matrices[at]);
+		release_matrix(s->dm->matrices[at]);
+		dm_free_matrix(s->dm, at);
+	}
+	octave_unlock(s);
 }
 
-void octave_task10(d_matrices_ptr dm)
+// This function is called when the 'S' command is issued. It multiplies two
+// matrices using the Strassen algorithm and appends the result to the
+// dynamically allocated array of matrices
+void octave_task10(octave_session_ptr s)
 {
 	int at1, at2;
-	scanf("%d %d", &at1, &at2);
+	fscanf(s->in, "%d %d", &at1, &at2);
 
 	// Make sure that the given index is valid
-	if (at1 >= dm->matrices_count || at2 >= dm->matrices_count) {
-		printf(INVALID_INDEX);
+	octave_lock(s, 0);
+	if (at1 >= s->dm->matrices_count || at2 >= s->dm->matrices_count) {
+		fprintf(s->out, INVALID_INDEX);
+		octave_unlock(s);
 		return;
 	}
 
 	// Abbreviation for the given matrices
-	matrix *m1 = dm->matrices[at1], *m2 = dm->matrices[at2];
+	matrix *m1 = s->dm->matrices[at1], *m2 = s->dm->matrices[at2];
+
+	// Call the real function. Products that don't fit in the memory budget
+	// are computed straight from (and to) the spill file (without Strassen)
+	matrix *rez;
+	int out_of_core = ooc_worth(m1, m2);
+	if (out_of_core) {
+		mm_pin(m1);
+		mm_pin(m2);
+		rez = ooc_multiply(m1, m2);
+		if (rez && verify_enabled())
+			verify_skip();
+	} else {
+		mm_touch(m1);
+		mm_touch(m2);
+		rez = olib_product(m1, m2, 1, 'S', at1, at2);
+	}
+	if (rez)
+		s->flops += 2ULL * m1->m * m1->n * m2->n;
+	else
+		fprintf(s->out, INVALID_MULTIPLY);
+	octave_unlock(s);
 
-	// Call the real function
-	matrix *rez = multiply_matrices_strassen(m1, m2);
+	if (rez) {
+		octave_lock(s, 1);
+		dm_append_matrix(s->dm, rez);
+		if (!out_of_core)
+			mm_track(rez);
+		octave_unlock(s);
+	}
+}
+
+// This function is called when the 'E' command is issued. It outputs the
+// determinant of a square matrix (modulo MOD)
+void octave_task11(octave_session_ptr s)
+{
+	int at;
+	fscanf(s->in, "%d", &at);
+
+	// Make sure that the given index is valid
+	octave_lock(s, 0);
+	if (octave_is_valid_at(s, at)) {
+		matrix *mat = s->dm->matrices[at];
+		mm_touch(mat);
+		if (mat->m != mat->n) {
+			fprintf(s->out, INVALID_SQUARE);
+		} else {
+			fprintf(s->out, "%d\n", determinant_matrix(mat));
+			s->flops += 2ULL * mat->n * mat->n * mat->n / 3;
+		}
+	}
+	octave_unlock(s);
+}
+
+// This function is called when the 'R' command is issued. It outputs the rank
+// of a matrix
+void octave_task12(octave_session_ptr s)
+{
+	int at;
+	fscanf(s->in, "%d", &at);
+
+	// Make sure that the given index is valid
+	octave_lock(s, 0);
+	if (octave_is_valid_at(s, at)) {
+		matrix *mat = s->dm->matrices[at];
+		mm_touch(mat);
+		fprintf(s->out, "%d\n", rank_matrix(mat));
+		s->flops += 2ULL * mat->m * mat->n * (mat->m < mat->n ? mat->m
+															  : mat->n) / 3;
+	}
+	octave_unlock(s);
+}
+
+// This function is called when the 'V' command is issued. It inverts a square
+// matrix and appends the inverse to the dynamically allocated array of
+// matrices
+void octave_task13(octave_session_ptr s)
+{
+	int at;
+	fscanf(s->in, "%d", &at);
+
+	// Make sure that the given index is valid. Just like the products, the
+	// inverse only reads the array
+	octave_lock(s, 0);
+	if (!octave_is_valid_at(s, at)) {
+		octave_unlock(s);
+		return;
+	}
+
+	matrix *mat = s->dm->matrices[at], *rez = NULL;
+	mm_touch(mat);
+	if (mat->m != mat->n) {
+		fprintf(s->out, INVALID_SQUARE);
+	} else {
+		rez = invert_matrix(mat);
+		if (rez)
+			s->flops += 2ULL * mat->n * mat->n * mat->n;
+		else
+			fprintf(s->out, INVALID_SINGULAR);
+	}
+	octave_unlock(s);
+
+	if (rez) {
+		octave_lock(s, 1);
+		dm_append_matrix(s->dm, rez);
+		mm_track(rez);
+		octave_unlock(s);
+	}
+}
+
+// This function is called when the 'X' command is issued. It solves the linear
+// system A x = B (A is square, B has as many lines as A) and appends x to the
+// dynamically allocated array of matrices
+void octave_task14(octave_session_ptr s)
+{
+	int at1, at2;
+	fscanf(s->in, "%d %d", &at1, &at2);
+
+	// Make sure that the given indexes are valid
+	octave_lock(s, 0);
+	if (!octave_is_valid_at(s, at1) || !octave_is_valid_at(s, at2)) {
+		octave_unlock(s);
+		return;
+	}
+
+	matrix *a = s->dm->matrices[at1], *b = s->dm->matrices[at2], *rez = NULL;
+	mm_touch(a);
+	mm_touch(b);
+	if (a->m != a->n) {
+		fprintf(s->out, INVALID_SQUARE);
+	} else if (a->m != b->m) {
+		fprintf(s->out, INVALID_SOLVE);
+	} else {
+		rez = solve_matrices(a, b);
+		if (rez)
+			s->flops += 2ULL * a->n * a->n * a->n / 3 +
+						2ULL * a->n * a->n * b->n;
+		else
+			fprintf(s->out, INVALID_SINGULAR);
+	}
+	octave_unlock(s);
+
+	if (rez) {
+		octave_lock(s, 1);
+		dm_append_matrix(s->dm, rez);
+		mm_track(rez);
+		octave_unlock(s);
+	}
+}
+
+// This function is called when the 'A', 'B', 'H' and 'K' commands are issued.
+// It computes the sum, the difference or the Hadamard product of two matrices
+// (or a matrix multiplied by a number, for 'K') and appends the result to the
+// dynamically allocated array of matrices
+void octave_task15(octave_session_ptr s, int op)
+{
+	// For 'K', the second number is the factor
+	int at1, at2;
+	fscanf(s->in, "%d %d", &at1, &at2);
+
+	// Make sure that the given indexes are valid
+	octave_lock(s, 0);
+	if (!octave_is_valid_at(s, at1) ||
+		(op != ELEMENTWISE_SCALE && !octave_is_valid_at(s, at2))) {
+		octave_unlock(s);
+		return;
+	}
 
+	matrix *m1 = s->dm->matrices[at1], *m2 = NULL;
+	mm_touch(m1);
+	if (op != ELEMENTWISE_SCALE) {
+		m2 = s->dm->matrices[at2];
+		mm_touch(m2);
+	}
+	matrix *rez = elementwise_matrices(m1, m2, op, at2);
 	if (rez)
-		dm_append_matrix(dm, rez);
+		s->flops += (unsigned long long)m1->m * m1->n;
+	else
+		fprintf(s->out, INVALID_ELEMENTWISE);
+	octave_unlock(s);
+
+	if (rez) {
+		octave_lock(s, 1);
+		dm_append_matrix(s->dm, rez);
+		mm_track(rez);
+		octave_unlock(s);
+	}
+}
+
+// This function is called when the 'a', 'b', 'h' and 'k' commands are issued.
+// They are the in-place versions of 'A', 'B', 'H' and 'K': the result replaces
+// the first matrix, so nothing is allocated
+void octave_task16(octave_session_ptr s, int op)
+{
+	int at1, at2;
+	fscanf(s->in, "%d %d", &at1, &at2);
+
+	// Make sure that the given indexes are valid
+	octave_lock(s, 1);
+	if (!octave_is_valid_at(s, at1) ||
+		(op != ELEMENTWISE_SCALE && !octave_is_valid_at(s, at2))) {
+		octave_unlock(s);
+		return;
+	}
+
+	matrix *m1 = s->dm->matrices[at1], *m2 = m1;
+	mm_touch(m1);
+	if (op != ELEMENTWISE_SCALE) {
+		m2 = s->dm->matrices[at2];
+		mm_touch(m2);
+		if (m1->m != m2->m || m1->n != m2->n) {
+			fprintf(s->out, INVALID_ELEMENTWISE);
+			octave_unlock(s);
+			return;
+		}
+	}
+
+	elementwise_matrices_inplace(m1, m2, op, at2);
+	s->flops += (unsigned long long)m1->m * m1->n;
+	octave_unlock(s);
+}
+
+// This function is called when the 'U' command is issued. It appends the sums
+// of every line of a matrix (as a column) to the dynamically allocated array
+// of matrices
+void octave_task17(octave_session_ptr s)
+{
+	int at;
+	fscanf(s->in, "%d", &at);
+
+	// Make sure that the given index is valid
+	octave_lock(s, 0);
+	if (!octave_is_valid_at(s, at)) {
+		octave_unlock(s);
+		return;
+	}
+
+	matrix *mat = s->dm->matrices[at];
+	mm_touch(mat);
+	matrix *rez = sum_lines_matrix(mat);
+	s->flops += (unsigned long long)mat->m * mat->n;
+	octave_unlock(s);
+
+	octave_lock(s, 1);
+	dm_append_matrix(s->dm, rez);
+	mm_track(rez);
+	octave_unlock(s);
+}
+
+// This function is called when the 'W' command is issued. It appends the sums
+// of every column of a matrix (as a line) to the dynamically allocated array
+// of matrices
+void octave_task18(octave_session_ptr s)
+{
+	int at;
+	fscanf(s->in, "%d", &at);
+
+	// Make sure that the given index is valid
+	octave_lock(s, 0);
+	if (!octave_is_valid_at(s, at)) {
+		octave_unlock(s);
+		return;
+	}
+
+	matrix *mat = s->dm->matrices[at];
+	mm_touch(mat);
+	matrix *rez = sum_columns_matrix(mat);
+	s->flops += (unsigned long long)mat->m * mat->n;
+	octave_unlock(s);
+
+	octave_lock(s, 1);
+	dm_append_matrix(s->dm, rez);
+	mm_track(rez);
+	octave_unlock(s);
+}
+
+// This function is called when the 'N' command is issued. It multiplies a
+// chain of matrices (in the cheapest order, see 'matrices_chain') and appends
+// the result to the dynamically allocated array of matrices. Only the result
+// is appended, the intermediate matrices are freed right away.
+void octave_task19(octave_session_ptr s)
+{
+	// Read the chain's length and the indexes of its matrices. The length
+	// comes straight from the input, so at most CHAIN_MAX_LENGTH indexes are
+	// kept; the others are still read, so the next command starts where it
+	// should.
+	int count, read = 0;
+	if (fscanf(s->in, "%d", &count) != 1 || count < 1) {
+		fprintf(s->out, INVALID_MULTIPLY);
+		return;
+	}
+	int *ats = safe_malloc(safe_mul(count < CHAIN_MAX_LENGTH ? count :
+									CHAIN_MAX_LENGTH, sizeof(int)));
+	for (int at; read < count && fscanf(s->in, "%d", &at) == 1; ++read)
+		if (read < CHAIN_MAX_LENGTH)
+			ats[read] = at;
+	if (read < count || count > CHAIN_MAX_LENGTH) {
+		fprintf(s->out, INVALID_MULTIPLY);
+		free(ats);
+		return;
+	}
+
+	// Make sure that the given indexes are valid
+	octave_lock(s, 0);
+	int valid = 1;
+	for (int i = 0; valid && i < count; ++i)
+		valid = octave_is_valid_at(s, ats[i]);
+
+	matrix **mats = safe_malloc(safe_mul(count, sizeof(matrix *))), *rez = NULL;
+	if (valid) {
+		for (int i = 0; i < count; ++i)
+			mats[i] = s->dm->matrices[ats[i]];
+		rez = chain_multiply(mats, count, &s->flops);
+		if (!rez)
+			fprintf(s->out, INVALID_MULTIPLY);
+	}
+	octave_unlock(s);
+
+	if (rez) {
+		octave_lock(s, 1);
+		dm_append_matrix(s->dm, rez);
+		mm_track(rez);
+		octave_unlock(s);
+	}
+
+	// Make sure there are no memory leaks
+	free(ats);
+	free(mats);
+}
+
+// This function executes a single command (whose arguments are read from the
+// session's input). It returns 0 if the session has to end ('Q').
+int octave_execute(octave_session_ptr s, char command)
+{
+	unsigned long long start_ns = 0;
+	if (s->stats->enabled)
+		start_ns = octave_stats_clock();
+	s->flops = 0;
+
+	// The memory budget isn't shared between threads, so every command is
+	// executed by itself when there is one
+	s->exclusive = 0;
+	if (s->lock && mm_enabled()) {
+		pthread_rwlock_wrlock(s->lock);
+		s->exclusive = 1;
+	}
+
+	// Based on the user's option, the program has to execute different
+	// operations:
+	int go_on = 1;
+	switch (command) {
+	case 'L': // Load a matrix in memory
+		octave_task1(s);
+		break;
+
+	case 'D': // Output a matrix's size
+		octave_task2(s);
+		break;
+
+	case 'P': // Output a matrix's content
+		octave_task3(s);
+		break;
+
+	case 'C': // Resize a matrix based on the given input
+		octave_task4(s);
+		break;
+
+	case 'M': // Multiply two matrices using the naive approach
+		octave_task5(s);
+		break;
+
+	case 'O': // Sort all the matrices (merge sort)
+		octave_task6(s);
+		break;
+
+	case 'T': // Transpose a given matrix
+		octave_task7(s);
+		break;
+
+	case 'F': // Remove a matrix from the array
+		octave_task8(s);
+		break;
+
+	case 'S': // Multiply two (2^n) x (2^n) matrices using Strassen
+		octave_task10(s);
+		break;
+
+	case 'E': // Output the determinant of a matrix
+		octave_task11(s);
+		break;
+
+	case 'R': // Output the rank of a matrix
+		octave_task12(s);
+		break;
+
+	case 'V': // Invert a matrix
+		octave_task13(s);
+		break;
+
+	case 'X': // Solve a linear system
+		octave_task14(s);
+		break;
+
+	case 'A': // Add two matrices
+		octave_task15(s, ELEMENTWISE_ADD);
+		break;
+
+	case 'B': // Subtract two matrices
+		octave_task15(s, ELEMENTWISE_SUBTRACT);
+		break;
+
+	case 'H': // Multiply two matrices element by element (Hadamard)
+		octave_task15(s, ELEMENTWISE_HADAMARD);
+		break;
+
+	case 'K': // Multiply a matrix by a number
+		octave_task15(s, ELEMENTWISE_SCALE);
+		break;
+
+	case 'a': // The same operations, in place
+		octave_task16(s, ELEMENTWISE_ADD);
+		break;
+
+	case 'b':
+		octave_task16(s, ELEMENTWISE_SUBTRACT);
+		break;
+
+	case 'h':
+		octave_task16(s, ELEMENTWISE_HADAMARD);
+		break;
+
+	case 'k':
+		octave_task16(s, ELEMENTWISE_SCALE);
+		break;
+
+	case 'U': // Output the sums of a matrix's lines (as a new matrix)
+		octave_task17(s);
+		break;
+
+	case 'W': // Output the sums of a matrix's columns (as a new matrix)
+		octave_task18(s);
+		break;
+
+	case 'N': // Multiply a chain of matrices (in the cheapest order)
+		octave_task19(s);
+		break;
+
+	case 'I': // Output the statistics gathered so far
+		octave_lock(s, 0);
+		octave_stats_dump(s->stats, s->dm);
+		octave_unlock(s);
+		break;
+
+	case 'Q': // The caller frees the memory and quits
+		go_on = 0;
+		break;
+
+	default: // Insert coin ;)
+		fprintf(s->out, INVALID_COMMAND);
+		break;
+	}
+
+	// Make sure the budget is respected before the next command
+	if (mm_enabled()) {
+		octave_lock(s, 1);
+		mm_balance();
+		octave_unlock(s);
+	}
+	if (s->exclusive) {
+		s->exclusive = 0;
+		pthread_rwlock_unlock(s->lock);
+	}
+
+	if (s->stats->enabled) {
+		octave_lock(s, 0);
+		int matrices_count = s->dm->matrices_count;
+		octave_unlock(s);
+		octave_stats_record(s->stats, command,
+							octave_stats_clock() - start_ns, s->flops,
+							matrices_count);
+	}
+
+	return go_on;
 }
 
 // This is the 'driver' program. It is similar to the simulation of a terminal
 // like bash - the user inputs its option and then the required function is
-// called to execute the given command
-int octave_terminal(void)
+// called to execute the given command. The startup options (see
+// 'octave_options') decide which extra features are enabled
+int octave_terminal(octave_options_ptr opts)
 {
+	// Big products are split between the workers (which are started before
+	// anything else, so they don't inherit the spill file)
+	if (!dist_init(opts->workers, opts->local_workers))
+		return EXIT_FAILURE;
+
 	// A dynamically allocated array of matrices is required
 	d_matrices dm;
 	dm_init(&dm);
 
+	// The instrumentation only costs a branch per command when it is disabled
+	octave_stats stats;
+	octave_stats_init(&stats, opts->stats, opts->stats_path);
+
+	// Cold matrices are spilled to disk once the budget is exceeded
+	if (!mm_init(&dm, opts->memory_budget, opts->spill_path))
+		return EXIT_FAILURE;
+
+	// The terminal is a single session which isn't shared with anybody
+	octave_session session = {
+		.in = stdin, .out = stdout, .dm = &dm, .lock = NULL,
+		.exclusive = 0, .stats = &stats, .flops = 0
+	};
+
 	// Start the "terminal"
 	while (1) {
 		// Find out what the user wants to do - retry until a non-empty option
@@ -187,56 +801,19 @@ int octave_terminal(void)
 			scanf("%c", &current_option);
 		} while (current_option == '\n');
 
-		// Based on the user's option, the program has to execute different
-		// operations:
-		switch (current_option) {
-		case 'L': // Load a matrix in memory
-			// load_matrix(&dm);
-			octave_task1(&dm);
-			break;
-
-		case 'D': // Output a matrix's size
-			octave_task2(&dm);
-			break;
-
-		case 'P': // Output a matrix's content
-			octave_task3(&dm);
-			break;
-
-		case 'C': // Resize a matrix based on the given input
-			octave_task4(&dm);
+		if (!octave_execute(&session, current_option))
 			break;
-
-		case 'M': // Multiply two matrices using the naive approach
-			octave_task5(&dm);
-			break;
-
-		case 'O': // Sort all the matrices (merge sort)
-			octave_task6(&dm);
-			break;
-
-		case 'T': // Transpose a given matrix
-			octave_task7(&dm);
-			break;
-
-		case 'F': // Remove a matrix from the array
-			octave_task8(&dm);
-			break;
-
-		case 'S': // Multiply two (2^n) x (2^n) matrices using Strassen
-			octave_task10(&dm);
-			break;
-
-		case 'Q': // Free all the memory and quit
-			dm_free_all_matrices(&dm);
-			return 0;
-
-		default: // Insert coin ;)
-			printf(INVALID_COMMAND);
-			break;
-		}
 	}
 
-	// Returning from here should NOT be possible
-	return EXIT_FAILURE;
+	// Free all the memory and quit
+	if (stats.enabled)
+		octave_stats_dump(&stats, &dm);
+	octave_stats_free(&stats);
+	if (verify_enabled())
+		verify_report(stderr);
+	mm_free();
+	dist_free();
+	dm_release_all_matrices(&dm);
+	dm_free_all_matrices(&dm);
+	return 0;
 }
@@ -7,24 +7,84 @@
 // been placed in the main source file, but I've chosen not to in order to keep
 // the code cleaner.
 
+// Standard library dependencies
+#include <pthread.h> // pthread_rwlock_t
+
 // Other dependencies
 #include "matrices.h"
+#include "octave_library_private.h" // olib_product
+#include "octave_options.h"
+#include "octave_stats.h"
+
+// The session structure. The terminal has a single session (stdin / stdout),
+// while the server (see 'octave_server') has one for every command it executes
+typedef struct {
+	// The command's arguments are read from in; its results are written to out
+	FILE *in, *out;
+	// The array of matrices the commands work on
+	d_matrices_ptr dm;
+	// If the array is shared by multiple sessions, it is protected by this lock
+	// (NULL otherwise)
+	pthread_rwlock_t *lock;
+	// exclusive = 1 if the whole command is executed while holding the lock
+	// for writing (this is always the case when a memory budget is set)
+	int exclusive;
+	// The instrumentation
+	octave_stats_ptr stats;
+	// flops = the arithmetic operations performed by the current command
+	unsigned long long flops;
+} octave_session;
+
+// Note: The following typedef is kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef octave_session * octave_session_ptr;
+
+// These functions lock / unlock the array of matrices (for reading or, if
+// exclusive is set, for writing). They do nothing if the array isn't shared.
+extern void octave_lock(octave_session_ptr s, int exclusive);
+extern void octave_unlock(octave_session_ptr s);
+
+// Checks if a given index is valid. If it isn't, it outputs an error message
+// and returns 0.
+extern int octave_is_valid_at(octave_session_ptr s, int at);
+
+// These functions output a matrix's dimensions / content
+extern void octave_print_matrix_size(octave_session_ptr s, matrix_ptr mat);
+extern void octave_print_matrix(octave_session_ptr s, matrix_ptr mat);
 
 // These are the functions responsible for each task
-extern void octave_task1(d_matrices_ptr dm);
-extern void octave_task2(d_matrices_ptr dm);
-extern void octave_task3(d_matrices_ptr dm);
-extern void octave_task4(d_matrices_ptr dm);
-extern void octave_task5(d_matrices_ptr dm);
-extern void octave_task6(d_matrices_ptr dm);
-extern void octave_task7(d_matrices_ptr dm);
-extern void octave_task8(d_matrices_ptr dm);
+extern void octave_task1(octave_session_ptr s);
+extern void octave_task2(octave_session_ptr s);
+extern void octave_task3(octave_session_ptr s);
+extern void octave_task4(octave_session_ptr s);
+extern void octave_task5(octave_session_ptr s);
+extern void octave_task6(octave_session_ptr s);
+extern void octave_task7(octave_session_ptr s);
+extern void octave_task8(octave_session_ptr s);
 // Note: Task 9 is "Q", this is why it is missing
-extern void octave_task10(d_matrices_ptr dm);
+extern void octave_task10(octave_session_ptr s);
+// The linear algebra commands (see 'matrices_linear')
+extern void octave_task11(octave_session_ptr s);
+extern void octave_task12(octave_session_ptr s);
+extern void octave_task13(octave_session_ptr s);
+extern void octave_task14(octave_session_ptr s);
+// The element-wise commands (see 'matrices_elementwise'). op is one of the
+// ELEMENTWISE_* operations.
+extern void octave_task15(octave_session_ptr s, int op);
+extern void octave_task16(octave_session_ptr s, int op);
+extern void octave_task17(octave_session_ptr s);
+extern void octave_task18(octave_session_ptr s);
+// The chain multiplication (see 'matrices_chain')
+extern void octave_task19(octave_session_ptr s);
+
+// This function executes a single command (whose arguments are read from the
+// session's input). It returns 0 if the session has to end ('Q').
+extern int octave_execute(octave_session_ptr s, char command);
 
 // This is the 'driver' program. It is similar to the simulation of a terminal
 // like bash - the user inputs its option and then the required function is
-// called to execute the given command
-extern int octave_terminal(void);
+// called to execute the given command. The startup options (see
+// 'octave_options') decide which extra features are enabled
+extern int octave_terminal(octave_options_ptr opts);
 
 #endif // OCTAVE_H
@@ -0,0 +1,582 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "octave_benchmark.h"
+
+// The kernels, in the order in which they are benchmarked
+#define BENCH_MULTIPLY 0
+#define BENCH_STRASSEN 1
+#define BENCH_TRANSPOSE 2
+#define BENCH_RESIZE 3
+#define BENCH_SORT 4
+#define BENCH_READ 5
+#define BENCH_MULTIPLY_FMA 6
+#define BENCH_MULTIPLY_MADD 7
+#define BENCH_KERNELS 8
+
+// The number of matrices that are sorted by the merge_sort benchmark
+#define BENCH_SORT_COUNT (1 << 16)
+// The generator frees matrices once this many are loaded
+#define BENCH_MAX_LOADED 32
+// The line of a baseline file that holds the size it was measured with
+#define BENCH_SIZE_KEY "bench-size"
+
+// This function seeds the generator
+void bench_rng_seed(bench_rng_ptr rng, unsigned long long seed)
+{
+	// A zero state would only produce zeros
+	rng->state = seed ^ 0x9E3779B97F4A7C15ULL;
+	if (!rng->state)
+		rng->state = 1;
+}
+
+// This function returns the next pseudo-random number
+unsigned long long bench_rng_next(bench_rng_ptr rng)
+{
+	rng->state ^= rng->state >> 12;
+	rng->state ^= rng->state << 25;
+	rng->state ^= rng->state >> 27;
+	return rng->state * 0x2545F4914F6CDD1DULL;
+}
+
+// This function returns a pseudo-random number in [lo, hi]
+int bench_rng_range(bench_rng_ptr rng, int lo, int hi)
+{
+	return lo + (int)(bench_rng_next(rng) % (unsigned long long)(hi - lo + 1));
+}
+
+// This function returns a matrix dimension, as requested by the options
+int bench_random_size(bench_rng_ptr rng, octave_options_ptr opts)
+{
+	int size = bench_rng_range(rng, opts->size_min, opts->size_max);
+	if (!opts->size_pow2)
+		return size;
+
+	// Round down to a power of two (but never below size_min's power of two)
+	int pow2 = 1;
+	while (2 * pow2 <= size)
+		pow2 *= 2;
+	return pow2;
+}
+
+// This function creates a (m x n) matrix filled with pseudo-random elements
+matrix_ptr bench_random_matrix(bench_rng_ptr rng, int m, int n)
+{
+	matrix_ptr mat = safe_malloc(sizeof(matrix));
+	mat->m = m;
+	mat->n = n;
+	mat->refs = NULL;
+	mat->info = alloc_matrix_lines(m, n);
+	for (int i = 0; i < m; ++i)
+		for (int j = 0; j < n; ++j)
+			mat->info[i][j] = bench_rng_range(rng, 0, MOD - 1);
+	matrix_update_sum(mat);
+	return mat;
+}
+
+// This function picks a command according to the given mix (e.g. "L4M2S1",
+// already checked by octave_options_mix)
+char bench_pick_command(bench_rng_ptr rng, const char *mix)
+{
+	int total = 0;
+	for (const char *p = mix; *p; ++p)
+		if (strchr(OCTAVE_MIX_COMMANDS, *p))
+			total += octave_options_weight(p);
+
+	int pick = bench_rng_range(rng, 0, total - 1);
+	for (const char *p = mix; *p; ++p) {
+		if (!strchr(OCTAVE_MIX_COMMANDS, *p))
+			continue;
+		pick -= octave_options_weight(p);
+		if (pick < 0)
+			return *p;
+	}
+
+	return 'L';
+}
+
+// This function outputs the 'L' command for a new matrix and appends the
+// matrix to the generator's own array
+void bench_generate_load(bench_rng_ptr rng, d_matrices_ptr dm, int m, int n)
+{
+	matrix_ptr mat = bench_random_matrix(rng, m, n);
+	printf("L %d %d\n", m, n);
+	for (int i = 0; i < m; ++i)
+		for (int j = 0; j < n; ++j)
+			printf("%d%c", mat->info[i][j], j == n - 1 ? '\n' : ' ');
+	dm_append_matrix(dm, mat);
+}
+
+// This function looks for a matrix with the given number of lines (and, if n
+// isn't negative, with the given number of columns too), other than the one
+// at skip (-1 = none). It returns -1 if no such matrix exists.
+int bench_find_matrix(d_matrices_ptr dm, int m, int n, int skip)
+{
+	for (int i = 0; i < dm->matrices_count; ++i)
+		if (i != skip && dm->matrices[i]->m == m &&
+			(n < 0 || dm->matrices[i]->n == n))
+			return i;
+	return -1;
+}
+
+// This function outputs a deterministic workload made of opts->commands
+// commands, chosen according to opts->mix. The generator replays every command
+// on its own array of matrices, so the generated indexes are always valid and
+// the multiplications are mostly done on compatible operands.
+int bench_generate(octave_options_ptr opts)
+{
+	bench_rng rng;
+	bench_rng_seed(&rng, opts->seed);
+
+	d_matrices dm;
+	dm_init(&dm);
+
+	for (int c = 0; c < opts->commands; ++c) {
+		char cmd = bench_pick_command(&rng, opts->mix);
+
+		// Every other command needs at least one loaded matrix, and the
+		// generator shouldn't keep too many of them around
+		if (cmd != 'L' && cmd != 'O' && !dm.matrices_count)
+			cmd = 'L';
+		if (cmd == 'L' && dm.matrices_count >= BENCH_MAX_LOADED)
+			cmd = 'F';
+
+		int at = dm.matrices_count ?
+				 bench_rng_range(&rng, 0, dm.matrices_count - 1) : 0;
+		matrix_ptr mat = dm.matrices_count ? dm.matrices[at] : NULL;
+		switch (cmd) {
+		case 'L':
+			bench_generate_load(&rng, &dm, bench_random_size(&rng, opts),
+								bench_random_size(&rng, opts));
+			break;
+
+		case 'D':
+		case 'P':
+			printf("%c %d\n", cmd, at);
+			break;
+
+		case 'C': {
+			// Keep a random selection of lines and columns
+			int lines_count = bench_rng_range(&rng, 1, mat->m);
+			int cols_count = bench_rng_range(&rng, 1, mat->n);
+			int *lines = safe_malloc(safe_mul(lines_count, sizeof(int)));
+			int *cols = safe_malloc(safe_mul(cols_count, sizeof(int)));
+			printf("C %d\n%d", at, lines_count);
+			for (int i = 0; i < lines_count; ++i) {
+				lines[i] = bench_rng_range(&rng, 0, mat->m - 1);
+				printf(" %d", lines[i]);
+			}
+			printf("\n%d", cols_count);
+			for (int i = 0; i < cols_count; ++i) {
+				cols[i] = bench_rng_range(&rng, 0, mat->n - 1);
+				printf(" %d", cols[i]);
+			}
+			printf("\n");
+			matrix_ptr rez = resize_matrix(mat, lines, lines_count,
+										   cols, cols_count);
+			release_matrix(mat);
+			dm_replace_matrix(&dm, at, rez);
+			free(lines);
+			free(cols);
+			break;
+		}
+
+		case 'M': {
+			// Find a compatible operand, or load one
+			int at2 = bench_find_matrix(&dm, mat->n, -1, -1);
+			if (at2 < 0) {
+				bench_generate_load(&rng, &dm, mat->n,
+									bench_random_size(&rng, opts));
+				at2 = dm.matrices_count - 1;
+			}
+			printf("M %d %d\n", at, at2);
+			dm_append_matrix(&dm, multiply_matrices(dm.matrices[at],
+													dm.matrices[at2]));
+			break;
+		}
+
+		case 'S': {
+			// Strassen needs two (2^n x 2^n) matrices of the same size, a
+			// power of two in [size_min, size_max] (if there is none, the
+			// biggest one below size_max)
+			int lo = 0, hi = 0;
+			while ((2 << hi) <= opts->size_max)
+				++hi;
+			while (lo < hi && (1 << lo) < opts->size_min)
+				++lo;
+			int size = 1 << bench_rng_range(&rng, lo, hi);
+
+			// Two different matrices, so the product isn't always a square
+			int at1 = bench_find_matrix(&dm, size, size, -1);
+			if (at1 < 0) {
+				bench_generate_load(&rng, &dm, size, size);
+				at1 = dm.matrices_count - 1;
+			}
+			int at2 = bench_find_matrix(&dm, size, size, at1);
+			if (at2 < 0) {
+				bench_generate_load(&rng, &dm, size, size);
+				at2 = dm.matrices_count - 1;
+			}
+			printf("S %d %d\n", at1, at2);
+			dm_append_matrix(&dm, multiply_matrices_strassen(dm.matrices[at1],
+															 dm.matrices[at2]));
+			break;
+		}
+
+		case 'O':
+			printf("O\n");
+			if (dm.matrices_count)
+				merge_sort(dm.matrices, 0, dm.matrices_count - 1);
+			break;
+
+		case 'T':
+			printf("T %d\n", at);
+			dm.matrices[at] = transpose_matrix(mat);
+			release_matrix(mat);
+			free_matrix(mat);
+			free(mat);
+			break;
+
+		case 'F':
+			printf("F %d\n", at);
+			release_matrix(mat);
+			dm_free_matrix(&dm, at);
+			break;
+		}
+	}
+	printf("Q\n");
+
+	dm_release_all_matrices(&dm);
+	dm_free_all_matrices(&dm);
+	return 0;
+}
+
+// This function returns the name of a kernel
+const char *bench_kernel_name(int kernel)
+{
+	static const char *names[BENCH_KERNELS] = {
+		"multiply_matrices", "multiply_matrices_strassen", "transpose_matrix",
+		"resize_matrix", "merge_sort", "read_matrix", "multiply_matrices_fma",
+		"multiply_matrices_madd"
+	};
+	return names[kernel];
+}
+
+// This function measures a single kernel: the kernel is called until
+// opts->bench_ms milliseconds have passed and the best time is kept
+void bench_measure(octave_options_ptr opts, bench_rng_ptr rng, int kernel,
+				   bench_result *result)
+{
+	int n = opts->bench_size;
+
+	// Strassen only works for (2^n) x (2^n) matrices
+	if (kernel == BENCH_STRASSEN)
+		while (n & (n - 1))
+			n &= n - 1;
+
+	// Prepare the operands; they are not part of the measurement
+	matrix_ptr a = bench_random_matrix(rng, n, n);
+	matrix_ptr b = bench_random_matrix(rng, n, n);
+	int *lines = safe_malloc(n * sizeof(int));
+	int *cols = safe_malloc(n * sizeof(int));
+	for (int i = 0; i < n; ++i) {
+		lines[i] = bench_rng_range(rng, 0, n - 1);
+		cols[i] = bench_rng_range(rng, 0, n - 1);
+	}
+	matrix_ptr sorted = NULL;
+	matrix_ptr_ptr to_sort = NULL;
+	FILE *text = NULL;
+
+	// The naive multiplication is measured with every arithmetic back end
+	// ("multiply_matrices" is the default one, whatever --backend says)
+	int backend = multiply_get_backend();
+	if (kernel == BENCH_MULTIPLY_FMA)
+		multiply_set_backend(MULTIPLY_BACKEND_FMA);
+	else if (kernel == BENCH_MULTIPLY_MADD)
+		multiply_set_backend(MULTIPLY_BACKEND_MADD);
+	else
+		multiply_set_backend(MULTIPLY_BACKEND_INT64);
+
+	result->name = bench_kernel_name(kernel);
+	switch (kernel) {
+	case BENCH_MULTIPLY:
+	case BENCH_MULTIPLY_FMA:
+	case BENCH_MULTIPLY_MADD:
+	case BENCH_STRASSEN:
+		result->work = 2.0 * n * n * n / 1e9;
+		result->unit = "GFLOP/s";
+		break;
+	case BENCH_SORT:
+		sorted = safe_malloc(BENCH_SORT_COUNT * sizeof(matrix));
+		to_sort = safe_malloc(BENCH_SORT_COUNT * sizeof(matrix_ptr));
+		result->work = BENCH_SORT_COUNT / 1e6;
+		result->unit = "Mmatrices/s";
+		break;
+	case BENCH_READ:
+		text = tmpfile();
+		if (!text) {
+			fprintf(stderr, "Could not create a temporary file\n");
+			exit(EXIT_FAILURE);
+		}
+		fprintf(text, "%d %d\n", n, n);
+		for (int i = 0; i < n; ++i)
+			for (int j = 0; j < n; ++j)
+				fprintf(text, "%d%c", a->info[i][j], j == n - 1 ? '\n' : ' ');
+		// fall through
+	default:
+		result->work = (double)n * n / 1e6;
+		result->unit = "Melements/s";
+		break;
+	}
+
+	result->ns = -1;
+	unsigned long long deadline = octave_stats_clock() +
+								  opts->bench_ms * 1000000ULL;
+	do {
+		// Whatever has to be reset between runs is reset here
+		if (kernel == BENCH_SORT) {
+			for (int i = 0; i < BENCH_SORT_COUNT; ++i) {
+				sorted[i].elem_sum = bench_rng_range(rng, 0, MOD - 1);
+				to_sort[i] = &sorted[i];
+			}
+		} else if (kernel == BENCH_READ) {
+			rewind(text);
+		}
+
+		matrix_ptr rez = NULL;
+		matrix read;
+		unsigned long long start = octave_stats_clock();
+		switch (kernel) {
+		case BENCH_MULTIPLY:
+		case BENCH_MULTIPLY_FMA:
+		case BENCH_MULTIPLY_MADD:
+			rez = multiply_matrices(a, b);
+			break;
+		case BENCH_STRASSEN:
+			rez = multiply_matrices_strassen(a, b);
+			break;
+		case BENCH_TRANSPOSE:
+			rez = transpose_matrix(a);
+			break;
+		case BENCH_RESIZE:
+			rez = resize_matrix(a, lines, n, cols, n);
+			break;
+		case BENCH_SORT:
+			merge_sort(to_sort, 0, BENCH_SORT_COUNT - 1);
+			break;
+		case BENCH_READ:
+			fread_matrix(text, &read);
+			break;
+		}
+		double ns = (double)(octave_stats_clock() - start);
+		if (result->ns < 0 || ns < result->ns)
+			result->ns = ns;
+
+		if (rez) {
+			// The identity selection of resize_matrix shares a's content
+			release_matrix(rez);
+			free_matrix(rez);
+			free(rez);
+		}
+		if (kernel == BENCH_READ)
+			free_matrix(&read);
+	} while (octave_stats_clock() < deadline);
+
+	free_matrix(a);
+	free(a);
+	free_matrix(b);
+	free(b);
+	free(lines);
+	free(cols);
+	free(sorted);
+	free(to_sort);
+	if (text)
+		fclose(text);
+	multiply_set_backend(backend);
+}
+
+// This function looks up a kernel in a baseline file. It returns -1 if the
+// kernel is missing.
+double bench_baseline_lookup(const char *path, const char *name)
+{
+	FILE *in = fopen(path, "r");
+	if (!in)
+		return -1;
+
+	// Every line looks like "name ns" (lines starting with '#' are comments)
+	char line[256], kernel[128];
+	double ns, found = -1;
+	while (fgets(line, sizeof(line), in))
+		if (line[0] != '#' && sscanf(line, "%127s %lf", kernel, &ns) == 2 &&
+			!strcmp(kernel, name))
+			found = ns;
+
+	fclose(in);
+	return found;
+}
+
+// This function runs every microbenchmark, outputs the results and compares
+// them to the baseline. It returns EXIT_FAILURE if a regression was found.
+int bench_run(octave_options_ptr opts)
+{
+	bench_rng rng;
+	bench_rng_seed(&rng, opts->seed);
+
+	// The times only mean something for the same size of matrices. The size
+	// is checked before anything is measured (or the file is overwritten).
+	if (opts->baseline_path) {
+		double size = bench_baseline_lookup(opts->baseline_path,
+											BENCH_SIZE_KEY);
+		if (size < 0) {
+			fprintf(stderr, "Warning: the baseline doesn't record its "
+					"--bench-size\n");
+		} else if ((int)size != opts->bench_size) {
+			fprintf(stderr, "The baseline was measured with --bench-size=%d, "
+					"not %d\n", (int)size, opts->bench_size);
+			return EXIT_FAILURE;
+		}
+	}
+
+	FILE *save = NULL;
+	if (opts->save_baseline_path) {
+		save = fopen(opts->save_baseline_path, "w");
+		if (!save) {
+			fprintf(stderr, "Could not open the baseline file: %s\n",
+					opts->save_baseline_path);
+			return EXIT_FAILURE;
+		}
+		fprintf(save, "# kernel ns\n%s %d\n", BENCH_SIZE_KEY, opts->bench_size);
+	}
+
+	int regressions = 0;
+	printf("%-28s %14s %14s %9s\n", "kernel", "ns", "throughput", "baseline");
+	for (int kernel = 0; kernel < BENCH_KERNELS; ++kernel) {
+		bench_result result;
+		bench_measure(opts, &rng, kernel, &result);
+
+		printf("%-28s %14.0f %10.3f %s", result.name, result.ns,
+			   result.work / (result.ns / 1e9), result.unit);
+
+		// A kernel regresses if it got slower than the allowed tolerance
+		if (opts->baseline_path) {
+			double base = bench_baseline_lookup(opts->baseline_path,
+												result.name);
+			if (base > 0) {
+				double change = (result.ns / base - 1) * 100;
+				int regressed = change > opts->tolerance;
+				printf(" %+8.1f%%%s", change, regressed ? " REGRESSION" : "");
+				regressions += regressed;
+			} else {
+				printf(" %9s", "-");
+			}
+		}
+		printf("\n");
+
+		if (save)
+			fprintf(save, "%s %.0f\n", result.name, result.ns);
+	}
+
+	if (save)
+		fclose(save);
+	return regressions ? EXIT_FAILURE : 0;
+}
+
+// This function measures a kernel with the current parameters (see
+// 'octave_tuning'): the kernel is called until ms milliseconds have passed and
+// the best time of a single call is returned
+double bench_tune_measure(int kernel, matrix_ptr a, matrix_ptr b, int ms)
+{
+	double best = -1;
+	unsigned long long deadline = octave_stats_clock() + ms * 1000000ULL;
+	do {
+		unsigned long long start = octave_stats_clock();
+		matrix_ptr rez;
+		if (kernel == BENCH_MULTIPLY)
+			rez = multiply_matrices(a, b);
+		else
+			rez = multiply_matrices_strassen(a, b);
+		double ns = (double)(octave_stats_clock() - start);
+		if (best < 0 || ns < best)
+			best = ns;
+
+		free_matrix(rez);
+		free(rez);
+	} while (octave_stats_clock() < deadline);
+
+	return best;
+}
+
+// This function finds the best parameters of every size class on this machine
+// (every parameter is measured on its own, starting from the current ones) and
+// stores them in the tuning file
+int bench_tune(octave_options_ptr opts)
+{
+	static const int sizes[TUNE_CLASSES] = TUNE_CLASS_SIZES;
+	static const int cutoffs[] = {16, 32, 64, 128, 256};
+	static const int multiply_blocks[] = {0, 16, 32, 64, 128, 256, 512};
+	const int cutoffs_count = sizeof(cutoffs) / sizeof(*cutoffs);
+	const int multiply_count = sizeof(multiply_blocks) /
+							   sizeof(*multiply_blocks);
+
+	bench_rng rng;
+	bench_rng_seed(&rng, opts->seed);
+
+	// The multiplication blocks are only used by the default back end
+	multiply_set_backend(MULTIPLY_BACKEND_INT64);
+
+	for (int class = 0; class < TUNE_CLASSES; ++class) {
+		int n = sizes[class];
+		matrix_ptr a = bench_random_matrix(&rng, n, n);
+		matrix_ptr b = bench_random_matrix(&rng, n, n);
+		tune_params best = *tune_lookup(n), params;
+		double ns, best_ns;
+
+		// The crossover between the naive method and the Strassen algorithm
+		best_ns = -1;
+		for (int i = 0; i < cutoffs_count; ++i) {
+			params = best;
+			params.strassen_cutoff = cutoffs[i];
+			tune_set(class, &params);
+			ns = bench_tune_measure(BENCH_STRASSEN, a, b, opts->bench_ms);
+			if (best_ns < 0 || ns < best_ns) {
+				best_ns = ns;
+				best.strassen_cutoff = cutoffs[i];
+			}
+		}
+
+		// The blocks of the naive method (wider blocks than the matrix are
+		// the same as a single block)
+		best_ns = -1;
+		for (int i = 0; i < multiply_count; ++i) {
+			if (multiply_blocks[i] > n)
+				continue;
+			params = best;
+			params.multiply_block = multiply_blocks[i];
+			tune_set(class, &params);
+			ns = bench_tune_measure(BENCH_MULTIPLY, a, b, opts->bench_ms);
+			if (best_ns < 0 || ns < best_ns) {
+				best_ns = ns;
+				best.multiply_block = multiply_blocks[i];
+			}
+		}
+
+		tune_set(class, &best);
+		fprintf(stderr, "Tuned class %d (%d x %d)\n", class, n, n);
+
+		free_matrix(a);
+		free(a);
+		free_matrix(b);
+		free(b);
+	}
+
+	tune_report(stdout);
+	const char *path = opts->tuning_path ? opts->tuning_path
+										 : tune_default_path();
+	if (!tune_save(path)) {
+		fprintf(stderr, "Could not write the tuning file: %s\n",
+				path ? path : "(no home directory)");
+		return EXIT_FAILURE;
+	}
+	printf("Saved to %s\n", path);
+	return 0;
+}
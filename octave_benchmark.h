@@ -0,0 +1,105 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef OCTAVE_BENCHMARK_H
+#define OCTAVE_BENCHMARK_H
+
+// This file contains the means of measuring the simulator: a deterministic
+// workload generator (--generate), whose output can be fed back to the
+// simulator, and a microbenchmark for every kernel (--bench), which can be
+// compared against a stored baseline. The same measurements are used to tune
+// the kernels (--tune, see 'octave_tuning').
+
+// Standard library dependencies
+#include <stdio.h> // printf, fprintf, fopen
+#include <string.h> // strchr, strcmp
+
+// Other dependencies
+#include "matrices.h"
+#include "octave_options.h"
+#include "octave_stats.h" // octave_stats_clock
+#include "octave_tuning.h" // tune_lookup, tune_set, tune_save
+
+// A small and fast pseudo-random number generator (xorshift64*). The same seed
+// always produces the same sequence, on any machine.
+typedef struct {
+	unsigned long long state;
+} bench_rng;
+
+// The result of a single microbenchmark
+typedef struct {
+	// name = the name of the kernel (e.g. "multiply_matrices")
+	const char *name;
+	// ns = the best time of a single call, in nanoseconds
+	double ns;
+	// work = the amount of work done by a single call, measured in unit
+	double work;
+	const char *unit;
+} bench_result;
+
+// Note: The following typedef is kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef bench_rng * bench_rng_ptr;
+
+// This function seeds the generator
+extern void bench_rng_seed(bench_rng_ptr rng, unsigned long long seed);
+
+// This function returns the next pseudo-random number
+extern unsigned long long bench_rng_next(bench_rng_ptr rng);
+
+// This function returns a pseudo-random number in [lo, hi]
+extern int bench_rng_range(bench_rng_ptr rng, int lo, int hi);
+
+// This function returns a matrix dimension, as requested by the options
+extern int bench_random_size(bench_rng_ptr rng, octave_options_ptr opts);
+
+// This function creates a (m x n) matrix filled with pseudo-random elements
+extern matrix_ptr bench_random_matrix(bench_rng_ptr rng, int m, int n);
+
+// This function picks a command according to the given mix (e.g. "L4M2S1",
+// already checked by octave_options_mix)
+extern char bench_pick_command(bench_rng_ptr rng, const char *mix);
+
+// This function outputs the 'L' command for a new matrix and appends the
+// matrix to the generator's own array
+extern void bench_generate_load(bench_rng_ptr rng, d_matrices_ptr dm,
+								int m, int n);
+
+// This function looks for a matrix with the given number of lines (and, if n
+// isn't negative, with the given number of columns too), other than the one
+// at skip (-1 = none). It returns -1 if no such matrix exists.
+extern int bench_find_matrix(d_matrices_ptr dm, int m, int n, int skip);
+
+// This function outputs a deterministic workload made of opts->commands
+// commands, chosen according to opts->mix. The generator replays every command
+// on its own array of matrices, so the generated indexes are always valid and
+// the multiplications are mostly done on compatible operands.
+extern int bench_generate(octave_options_ptr opts);
+
+// This function returns the name of a kernel
+extern const char *bench_kernel_name(int kernel);
+
+// This function measures a single kernel: the kernel is called until
+// opts->bench_ms milliseconds have passed and the best time is kept
+extern void bench_measure(octave_options_ptr opts, bench_rng_ptr rng,
+						  int kernel, bench_result *result);
+
+// This function runs every microbenchmark, outputs the results and compares
+// them to the baseline. It returns EXIT_FAILURE if a regression was found.
+extern int bench_run(octave_options_ptr opts);
+
+// This function looks up a kernel in a baseline file. It returns -1 if the
+// kernel is missing.
+extern double bench_baseline_lookup(const char *path, const char *name);
+
+// This function measures a kernel with the current parameters (see
+// 'octave_tuning'): the kernel is called until ms milliseconds have passed and
+// the best time of a single call is returned
+extern double bench_tune_measure(int kernel, matrix_ptr a, matrix_ptr b,
+								 int ms);
+
+// This function finds the best parameters of every size class on this machine
+// (every parameter is measured on its own, starting from the current ones) and
+// stores them in the tuning file
+extern int bench_tune(octave_options_ptr opts);
+
+#endif // OCTAVE_BENCHMARK_H
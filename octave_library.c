@@ -0,0 +1,646 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "octave_library_private.h"
+
+// The public header doesn't see the simulator's definitions, so its copies of
+// them are checked here
+#if MOD > 32768
+#error "The elements of the library (olib_elem) are 16-bit"
+#endif
+#if OLIB_BACKEND_INT64 != MULTIPLY_BACKEND_INT64 || \
+	OLIB_BACKEND_FMA != MULTIPLY_BACKEND_FMA || \
+	OLIB_BACKEND_MADD != MULTIPLY_BACKEND_MADD
+#error "OLIB_BACKEND_* don't match MULTIPLY_BACKEND_*"
+#endif
+#if OLIB_ELEMENTWISE_ADD != ELEMENTWISE_ADD || \
+	OLIB_ELEMENTWISE_SUBTRACT != ELEMENTWISE_SUBTRACT || \
+	OLIB_ELEMENTWISE_HADAMARD != ELEMENTWISE_HADAMARD || \
+	OLIB_ELEMENTWISE_SCALE != ELEMENTWISE_SCALE
+#error "OLIB_ELEMENTWISE_* don't match ELEMENTWISE_*"
+#endif
+
+// The configuration is shared by the whole program. It is only changed by
+// olib_init, so it is never locked.
+static olib_config olib;
+
+// This function returns the version of the interface the library was built
+// with (OLIB_VERSION)
+int olib_version(void)
+{
+	return OLIB_VERSION;
+}
+
+// This function returns a message that describes a status code
+const char *olib_status_message(int status)
+{
+	switch (status) {
+	case OLIB_OK:
+		return "Success";
+	case OLIB_EINVAL:
+		return "Invalid argument";
+	case OLIB_ESIZE:
+		return "The sizes of the matrices don't fit";
+	case OLIB_EBACKEND:
+		return "The back end can't be used with this MOD";
+	case OLIB_ESINGULAR:
+		return "The matrix is singular";
+	default:
+		return "Unknown status";
+	}
+}
+
+// This function fills the configuration with the default values
+void olib_config_init(olib_config_ptr config)
+{
+	config->tuning_path = NULL;
+	config->backend = OLIB_BACKEND_INT64;
+	config->verify = 0;
+	config->verify_fallback = 0;
+	config->seed = 42;
+	config->threads = 0;
+}
+
+// This function sets up the library (the tuning, the back end and the
+// verification). It has to be called before anything else (NULL = the default
+// configuration).
+int olib_init(olib_config_ptr config)
+{
+	if (config)
+		olib = *config;
+	else
+		olib_config_init(&olib);
+
+	// The kernels use the parameters that were tuned for this CPU, if any, and
+	// the arithmetic back end that was selected
+	tune_init();
+	tune_load(olib.tuning_path);
+	if (!multiply_set_backend(olib.backend))
+		return OLIB_EBACKEND;
+
+	// The products may be checked (see 'matrices_verification')
+	verify_init(olib.verify, olib.verify_fallback, olib.seed);
+	return OLIB_OK;
+}
+
+// This function frees whatever olib_init allocated
+void olib_free(void)
+{
+	verify_free();
+}
+
+// This function returns the modulus (MOD) every operation is executed with
+int olib_modulus(void)
+{
+	return MOD;
+}
+
+// This utility creates an empty (m x n) matrix of the library. If rows is
+// set, its lines are allocated, too.
+static olib_matrix_ptr olib_matrix_alloc(int m, int n, int rows)
+{
+	olib_matrix_ptr mat = safe_malloc(sizeof(olib_matrix));
+	mat->mat.m = m;
+	mat->mat.n = n;
+	mat->mat.elem_sum = 0;
+	mat->mat.refs = NULL;
+	if (rows)
+		mat->mat.info = alloc_matrix_lines(m, n);
+	else
+		mat->mat.info = safe_malloc(safe_mul(m, sizeof(matrix_elem *)));
+	mat->borrowed = 0;
+	return mat;
+}
+
+// This utility turns a matrix of the simulator into a matrix of the library
+// (the matrix itself is freed, its content is moved)
+static olib_matrix_ptr olib_matrix_adopt(matrix_ptr mat)
+{
+	olib_matrix_ptr adopted = safe_malloc(sizeof(olib_matrix));
+	adopted->mat = *mat;
+	adopted->borrowed = 0;
+	free(mat);
+	return adopted;
+}
+
+// This function creates a (m x n) matrix that uses the caller's buffer: the
+// element (i, j) is data[i * ld + j]. Nothing is copied, but the elements are
+// checked (they have to be in (-MOD, MOD)). It returns NULL if anything is
+// invalid.
+olib_matrix_ptr olib_matrix_wrap(olib_elem *data, int m, int n, size_t ld)
+{
+	if (!data || m < 1 || n < 1 || ld < (size_t)n)
+		return NULL;
+
+	// The sum is needed anyway (for sorting), so the elements are checked
+	// while it is computed
+	long long sum = 0;
+	for (int i = 0; i < m; ++i) {
+		const olib_elem *line = data + i * ld;
+		for (int j = 0; j < n; ++j) {
+			if (line[j] <= -MOD || line[j] >= MOD)
+				return NULL;
+			sum += line[j];
+		}
+		sum %= MOD;
+	}
+
+	olib_matrix_ptr mat = olib_matrix_alloc(m, n, 0);
+	for (int i = 0; i < m; ++i)
+		mat->mat.info[i] = data + i * ld;
+	mat->mat.elem_sum = (int)((sum % MOD + MOD) % MOD);
+	mat->borrowed = 1;
+	return mat;
+}
+
+// This function creates a (m x n) matrix from a copy of the caller's buffer
+// (the element (i, j) is data[i * ld + j]). The elements are reduced modulo
+// MOD, just like the 'L' command does. It returns NULL if anything is invalid.
+olib_matrix_ptr olib_matrix_copy(const int *data, int m, int n, size_t ld)
+{
+	if (!data || m < 1 || n < 1 || ld < (size_t)n)
+		return NULL;
+
+	olib_matrix_ptr mat = olib_matrix_alloc(m, n, 1);
+	for (int i = 0; i < m; ++i)
+		for (int j = 0; j < n; ++j)
+			mat->mat.info[i][j] = (matrix_elem)(data[i * ld + j] % MOD);
+	matrix_update_sum(&mat->mat);
+	return mat;
+}
+
+// This function creates a copy of a matrix. Nothing is copied: the copy shares
+// the content of the original (see 'matrices_shared'), which is never changed
+// by the library. Only a wrapped matrix is copied for real, since the caller's
+// buffer may go away with it. It returns NULL if mat is NULL.
+olib_matrix_ptr olib_matrix_clone(olib_matrix_ptr mat)
+{
+	if (!mat)
+		return NULL;
+
+	olib_matrix_ptr clone;
+	if (mat->borrowed) {
+		clone = olib_matrix_alloc(mat->mat.m, mat->mat.n, 1);
+		for (int i = 0; i < mat->mat.m; ++i)
+			memcpy(clone->mat.info[i], mat->mat.info[i],
+				   mat->mat.n * sizeof(matrix_elem));
+		clone->mat.elem_sum = mat->mat.elem_sum;
+	} else {
+		clone = safe_malloc(sizeof(olib_matrix));
+		share_matrix(&clone->mat, &mat->mat);
+		clone->borrowed = 0;
+	}
+	return clone;
+}
+
+// This function frees a matrix (the caller's buffer of a wrapped matrix is
+// left alone, and so is a content that is shared with other matrices)
+void olib_matrix_free(olib_matrix_ptr mat)
+{
+	if (!mat)
+		return;
+
+	// Only the lines of its own matrices have to be freed
+	if (mat->borrowed) {
+		free(mat->mat.info);
+	} else {
+		release_matrix(&mat->mat);
+		free_matrix(&mat->mat);
+	}
+	free(mat);
+}
+
+// These functions return the size of a matrix, the sum of its elements
+// (modulo MOD) and a line of it (which must not be changed)
+int olib_matrix_lines(olib_matrix_ptr mat)
+{
+	return mat->mat.m;
+}
+
+int olib_matrix_columns(olib_matrix_ptr mat)
+{
+	return mat->mat.n;
+}
+
+int olib_matrix_sum(olib_matrix_ptr mat)
+{
+	return mat->mat.elem_sum;
+}
+
+const olib_elem *olib_matrix_line(olib_matrix_ptr mat, int i)
+{
+	if (i < 0 || i >= mat->mat.m)
+		return NULL;
+	return mat->mat.info[i];
+}
+
+// This function copies a matrix's elements to the caller's buffer (the element
+// (i, j) goes to data[i * ld + j])
+int olib_matrix_export(olib_matrix_ptr mat, olib_elem *data, size_t ld)
+{
+	if (!mat || !data || ld < (size_t)mat->mat.n)
+		return OLIB_EINVAL;
+
+	for (int i = 0; i < mat->mat.m; ++i)
+		memcpy(data + i * ld, mat->mat.info[i],
+			   mat->mat.n * sizeof(matrix_elem));
+	return OLIB_OK;
+}
+
+// This function computes a product (naive or Strassen) of two matrices of the
+// simulator and, if it was asked for, verifies it (see
+// 'matrices_verification'; command, at1 and at2 are only used to report
+// failures). The terminal computes its products this way, too. It returns
+// NULL if the matrices can't be multiplied.
+matrix_ptr olib_product(matrix_ptr m1, matrix_ptr m2, int strassen,
+						char command, int at1, int at2)
+{
+	unsigned long long start_ns = octave_stats_clock();
+	matrix_ptr rez = strassen ? multiply_matrices_strassen(m1, m2)
+							  : multiply_matrices(m1, m2);
+	if (rez && verify_enabled())
+		rez = verify_product(command, at1, at2, m1, m2, rez,
+							 octave_stats_clock() - start_ns);
+	return rez;
+}
+
+// This utility sets the status, if the caller wants it
+static void olib_set_status(int *status, int value)
+{
+	if (status)
+		*status = value;
+}
+
+// This utility multiplies two matrices of the library
+static olib_matrix_ptr olib_multiply_utility(olib_matrix_ptr a,
+											 olib_matrix_ptr b, int strassen,
+											 int *status)
+{
+	if (!a || !b) {
+		olib_set_status(status, OLIB_EINVAL);
+		return NULL;
+	}
+
+	matrix_ptr rez = olib_product(&a->mat, &b->mat, strassen,
+								  strassen ? 'S' : 'M', -1, -1);
+	if (!rez) {
+		olib_set_status(status, OLIB_ESIZE);
+		return NULL;
+	}
+	olib_set_status(status, OLIB_OK);
+	return olib_matrix_adopt(rez);
+}
+
+// These functions multiply two matrices (the naive method / Strassen), in the
+// calling thread. If status isn't NULL, it is set to one of the OLIB_* codes.
+olib_matrix_ptr olib_multiply(olib_matrix_ptr a, olib_matrix_ptr b,
+							  int *status)
+{
+	return olib_multiply_utility(a, b, 0, status);
+}
+
+olib_matrix_ptr olib_strassen(olib_matrix_ptr a, olib_matrix_ptr b,
+							  int *status)
+{
+	return olib_multiply_utility(a, b, 1, status);
+}
+
+// This function transposes a matrix, in the calling thread
+olib_matrix_ptr olib_transpose(olib_matrix_ptr a, int *status)
+{
+	if (!a) {
+		olib_set_status(status, OLIB_EINVAL);
+		return NULL;
+	}
+	olib_set_status(status, OLIB_OK);
+	return olib_matrix_adopt(transpose_matrix(&a->mat));
+}
+
+// This function keeps the given lines and columns of a matrix (in the given
+// order, just like 'C' does), in the calling thread. If every line and every
+// column is kept, the result is a clone (olib_matrix_clone).
+olib_matrix_ptr olib_resize(olib_matrix_ptr a, const int *lines,
+							int lines_count, const int *cols, int cols_count,
+							int *status)
+{
+	int valid = a && lines && cols && lines_count > 0 && cols_count > 0;
+	for (int i = 0; valid && i < lines_count; ++i)
+		valid = lines[i] >= 0 && lines[i] < a->mat.m;
+	for (int j = 0; valid && j < cols_count; ++j)
+		valid = cols[j] >= 0 && cols[j] < a->mat.n;
+	if (!valid) {
+		olib_set_status(status, OLIB_EINVAL);
+		return NULL;
+	}
+	olib_set_status(status, OLIB_OK);
+	if (resize_keeps_all(&a->mat, lines, lines_count, cols, cols_count))
+		return olib_matrix_clone(a);
+	return olib_matrix_adopt(resize_matrix(&a->mat, (int *)lines, lines_count,
+										   (int *)cols, cols_count));
+}
+
+// These functions return the determinant (modulo MOD) and the rank of a matrix
+// (see 'matrices_linear'), or an OLIB_* error code (the determinant is only
+// defined for square matrices)
+int olib_determinant(olib_matrix_ptr a)
+{
+	if (!a)
+		return OLIB_EINVAL;
+	if (a->mat.m != a->mat.n)
+		return OLIB_ESIZE;
+	return determinant_matrix(&a->mat);
+}
+
+int olib_rank(olib_matrix_ptr a)
+{
+	if (!a)
+		return OLIB_EINVAL;
+	return rank_matrix(&a->mat);
+}
+
+// This function inverts a square matrix, in the calling thread
+olib_matrix_ptr olib_invert(olib_matrix_ptr a, int *status)
+{
+	if (!a) {
+		olib_set_status(status, OLIB_EINVAL);
+		return NULL;
+	}
+	if (a->mat.m != a->mat.n) {
+		olib_set_status(status, OLIB_ESIZE);
+		return NULL;
+	}
+
+	matrix_ptr rez = invert_matrix(&a->mat);
+	olib_set_status(status, rez ? OLIB_OK : OLIB_ESINGULAR);
+	return rez ? olib_matrix_adopt(rez) : NULL;
+}
+
+// This function solves a x = b (a is square, b has as many lines as a), in the
+// calling thread
+olib_matrix_ptr olib_solve(olib_matrix_ptr a, olib_matrix_ptr b, int *status)
+{
+	if (!a || !b) {
+		olib_set_status(status, OLIB_EINVAL);
+		return NULL;
+	}
+	if (a->mat.m != a->mat.n || a->mat.m != b->mat.m) {
+		olib_set_status(status, OLIB_ESIZE);
+		return NULL;
+	}
+
+	matrix_ptr rez = solve_matrices(&a->mat, &b->mat);
+	olib_set_status(status, rez ? OLIB_OK : OLIB_ESINGULAR);
+	return rez ? olib_matrix_adopt(rez) : NULL;
+}
+
+// This function computes a op b (one of the OLIB_ELEMENTWISE_* operations; b
+// isn't used by OLIB_ELEMENTWISE_SCALE, which multiplies a by k), in the
+// calling thread
+olib_matrix_ptr olib_elementwise(olib_matrix_ptr a, olib_matrix_ptr b, int op,
+								 int k, int *status)
+{
+	if (!a || op < ELEMENTWISE_ADD || op > ELEMENTWISE_SCALE ||
+		(op != ELEMENTWISE_SCALE && !b)) {
+		olib_set_status(status, OLIB_EINVAL);
+		return NULL;
+	}
+
+	matrix_ptr rez = elementwise_matrices(&a->mat, b ? &b->mat : NULL, op, k);
+	olib_set_status(status, rez ? OLIB_OK : OLIB_ESIZE);
+	return rez ? olib_matrix_adopt(rez) : NULL;
+}
+
+// This function computes a = a op b in place (just like 'a', 'b', 'h' and 'k'
+// do), in the calling thread. It is the only function that changes an operand:
+// if a's content is shared with its clones, a gets its own copy first, so they
+// don't change. a must not be used by a batch that is being executed.
+int olib_elementwise_inplace(olib_matrix_ptr a, olib_matrix_ptr b, int op,
+							 int k)
+{
+	if (!a || op < ELEMENTWISE_ADD || op > ELEMENTWISE_SCALE ||
+		(op != ELEMENTWISE_SCALE && !b))
+		return OLIB_EINVAL;
+
+	// The element-wise kernel unshares a (see 'matrices_shared')
+	if (!elementwise_matrices_inplace(&a->mat, b ? &b->mat : &a->mat, op, k))
+		return OLIB_ESIZE;
+	return OLIB_OK;
+}
+
+// This function multiplies a chain of matrices (a[0] x a[1] x ...), in the
+// cheapest order (see 'matrices_chain'), in the calling thread
+olib_matrix_ptr olib_chain(olib_matrix_ptr *a, int count, int *status)
+{
+	if (!a || count < 1 || count > CHAIN_MAX_LENGTH) {
+		olib_set_status(status, OLIB_EINVAL);
+		return NULL;
+	}
+
+	matrix_ptr *mats = safe_malloc(safe_mul(count, sizeof(matrix_ptr)));
+	int valid = 1;
+	for (int i = 0; i < count; ++i) {
+		valid &= a[i] != NULL;
+		mats[i] = a[i] ? &a[i]->mat : NULL;
+	}
+	if (!valid) {
+		free(mats);
+		olib_set_status(status, OLIB_EINVAL);
+		return NULL;
+	}
+
+	matrix_ptr rez = chain_multiply(mats, count, NULL);
+	free(mats);
+	olib_set_status(status, rez ? OLIB_OK : OLIB_ESIZE);
+	return rez ? olib_matrix_adopt(rez) : NULL;
+}
+
+// This function executes a single job, in the calling thread
+void olib_run_job(olib_job_ptr job)
+{
+	switch (job->op) {
+	case OLIB_OP_MULTIPLY:
+		job->result = olib_multiply(job->a, job->b, &job->status);
+		break;
+	case OLIB_OP_STRASSEN:
+		job->result = olib_strassen(job->a, job->b, &job->status);
+		break;
+	case OLIB_OP_TRANSPOSE:
+		job->result = olib_transpose(job->a, &job->status);
+		break;
+	case OLIB_OP_RESIZE:
+		job->result = olib_resize(job->a, job->lines, job->lines_count,
+								  job->cols, job->cols_count, &job->status);
+		break;
+	case OLIB_OP_INVERT:
+		job->result = olib_invert(job->a, &job->status);
+		break;
+	case OLIB_OP_SOLVE:
+		job->result = olib_solve(job->a, job->b, &job->status);
+		break;
+	default:
+		job->result = NULL;
+		job->status = OLIB_EINVAL;
+		break;
+	}
+}
+
+// This function is executed by the threads of a batch: it runs jobs until
+// there are none left
+void *olib_batch_thread(void *arg)
+{
+	olib_batch_ptr batch = arg;
+	while (1) {
+		pthread_mutex_lock(&batch->lock);
+		int at = batch->next < batch->count ? batch->next++ : -1;
+		pthread_mutex_unlock(&batch->lock);
+		if (at < 0)
+			break;
+
+		olib_run_job(&batch->jobs[at]);
+
+		pthread_mutex_lock(&batch->lock);
+		++batch->done;
+		pthread_mutex_unlock(&batch->lock);
+	}
+	return NULL;
+}
+
+// This function starts executing a batch of jobs in the background and
+// returns right away. The jobs must not be touched until olib_wait returns.
+olib_batch_ptr olib_submit(olib_job_ptr jobs, int count)
+{
+	if (!jobs || count < 0)
+		return NULL;
+
+	olib_batch_ptr batch = safe_malloc(sizeof(olib_batch));
+	batch->jobs = jobs;
+	batch->count = count;
+	batch->next = 0;
+	batch->done = 0;
+	pthread_mutex_init(&batch->lock, NULL);
+	for (int i = 0; i < count; ++i) {
+		jobs[i].result = NULL;
+		jobs[i].status = OLIB_OK;
+	}
+
+	// Every thread picks the next job once it's done with its own
+	int threads = olib.threads;
+	if (threads < 1)
+		threads = topo_threads(OLIB_MAX_THREADS);
+	if (threads > OLIB_MAX_THREADS)
+		threads = OLIB_MAX_THREADS;
+	if (threads > count)
+		threads = count;
+	batch->threads_count = 0;
+	for (int t = 0; t < threads; ++t)
+		if (!pthread_create(&batch->threads[batch->threads_count], NULL,
+							olib_batch_thread, batch))
+			++batch->threads_count;
+
+	// If no thread could be created, the batch is executed right away
+	if (!batch->threads_count)
+		olib_batch_thread(batch);
+
+	return batch;
+}
+
+// This function returns 1 if every job of the batch is done
+int olib_poll(olib_batch_ptr batch)
+{
+	pthread_mutex_lock(&batch->lock);
+	int done = batch->done == batch->count;
+	pthread_mutex_unlock(&batch->lock);
+	return done;
+}
+
+// This function waits for a batch to be done and frees it. It returns the
+// number of jobs that failed.
+int olib_wait(olib_batch_ptr batch)
+{
+	for (int t = 0; t < batch->threads_count; ++t)
+		pthread_join(batch->threads[t], NULL);
+
+	int failed = 0;
+	for (int i = 0; i < batch->count; ++i)
+		failed += batch->jobs[i].status != OLIB_OK;
+
+	pthread_mutex_destroy(&batch->lock);
+	free(batch);
+	return failed;
+}
+
+// These functions create / free a workspace (which frees its matrices, too)
+void olib_workspace_init(olib_workspace_ptr ws)
+{
+	ws->matrices = NULL;
+	ws->count = 0;
+	ws->capacity = 0;
+}
+
+void olib_workspace_free(olib_workspace_ptr ws)
+{
+	for (int i = 0; i < ws->count; ++i)
+		olib_matrix_free(ws->matrices[i]);
+	free(ws->matrices);
+	olib_workspace_init(ws);
+}
+
+// This function appends a matrix to a workspace, which then owns it. It returns
+// its index.
+int olib_workspace_append(olib_workspace_ptr ws, olib_matrix_ptr mat)
+{
+	if (!mat)
+		return OLIB_EINVAL;
+
+	// The array doubles its size when it's full (just like 'd_matrices')
+	if (ws->count == ws->capacity) {
+		ws->capacity = ws->capacity ? 2 * ws->capacity : 1;
+		ws->matrices = safe_realloc(ws->matrices,
+									safe_mul(ws->capacity,
+											 sizeof(olib_matrix_ptr)));
+	}
+	ws->matrices[ws->count] = mat;
+	return ws->count++;
+}
+
+// This function returns the matrix with the given index (NULL if there is
+// none)
+olib_matrix_ptr olib_workspace_at(olib_workspace_ptr ws, int at)
+{
+	if (at < 0 || at >= ws->count)
+		return NULL;
+	return ws->matrices[at];
+}
+
+// This function frees the matrix with the given index, moving every following
+// matrix one position to the left (just like 'F' does)
+int olib_workspace_remove(olib_workspace_ptr ws, int at)
+{
+	if (at < 0 || at >= ws->count)
+		return OLIB_EINVAL;
+
+	olib_matrix_free(ws->matrices[at]);
+	for (int i = at; i + 1 < ws->count; ++i)
+		ws->matrices[i] = ws->matrices[i + 1];
+	--ws->count;
+	return OLIB_OK;
+}
+
+// This function sorts the matrices by the sum of their elements (just like 'O'
+// does)
+void olib_workspace_sort(olib_workspace_ptr ws)
+{
+	if (ws->count < 2)
+		return;
+
+	// merge_sort sorts the matrices of the simulator; every one of them is the
+	// first member of a matrix of the library, so it is turned back into one
+	matrix_ptr_ptr to_sort = safe_malloc(safe_mul(ws->count,
+												  sizeof(matrix_ptr)));
+	for (int i = 0; i < ws->count; ++i)
+		to_sort[i] = &ws->matrices[i]->mat;
+	merge_sort(to_sort, 0, ws->count - 1);
+	for (int i = 0; i < ws->count; ++i)
+		ws->matrices[i] = (olib_matrix_ptr)to_sort[i];
+	free(to_sort);
+}
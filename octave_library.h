@@ -0,0 +1,276 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef OCTAVE_LIBRARY_H
+#define OCTAVE_LIBRARY_H
+
+// This file contains the C interface of the simulator, for programs that hold
+// their matrices in memory and don't want to talk to the terminal (or to the
+// server) in text. The matrices_* modules, together with this one, are built
+// as a library (every source file except main.c, octave.c, octave_server.c,
+// octave_benchmark.c and octave_options.c, see the README); the terminal is
+// just one of its clients.
+//
+// A matrix is given to the library either as a copy (olib_matrix_copy) or
+// without any copy (olib_matrix_wrap) - the library then reads the caller's
+// buffer, which must stay alive (and unchanged) until the matrix is freed. The
+// library never changes an operand (except olib_elementwise_inplace): every
+// operation returns a new matrix, which belongs to the caller
+// (olib_matrix_free). A copy of a matrix (olib_matrix_clone) costs nothing -
+// the content is only copied if one of them is changed in place.
+//
+// Batches of operations are executed in the background, by a few threads
+// (olib_submit), while the caller does something else; olib_wait returns once
+// they are done. The operands of a batch may be shared between its jobs (and
+// other batches), since they are only read.
+//
+// The functions return one of the OLIB_* status codes (or NULL, for the ones
+// that return a matrix). Like the rest of the simulator, the library exits if
+// it runs out of memory (see 'safe_utilities').
+//
+// This header doesn't depend on the rest of the simulator: the matrices (and
+// the batches) are only handled through pointers, so their layout may change
+// without breaking the programs that use them. What the simulator itself needs
+// is in 'octave_library_private'.
+
+// Standard library dependencies
+#include <stddef.h> // size_t
+#include <stdint.h> // int16_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The version of the interface. It only changes when a program that uses the
+// library has to be changed too.
+#define OLIB_VERSION 1
+
+// The status codes
+#define OLIB_OK 0
+#define OLIB_EINVAL -1 // an invalid argument (NULL, size, index or element)
+#define OLIB_ESIZE -2 // the sizes don't fit (e.g. for a product)
+#define OLIB_EBACKEND -3 // the back end can't be used with this MOD
+#define OLIB_ESINGULAR -4 // the matrix can't be inverted
+
+// The arithmetic back ends of the naive multiplication (see
+// 'matrices_multiplication')
+#define OLIB_BACKEND_INT64 0 // products widened to 64 bits (the default)
+#define OLIB_BACKEND_FMA 1 // doubles, multiplied and added at once
+#define OLIB_BACKEND_MADD 2 // pairs of 16-bit products
+
+// The element-wise operations (see 'matrices_elementwise')
+#define OLIB_ELEMENTWISE_ADD 0 // a + b
+#define OLIB_ELEMENTWISE_SUBTRACT 1 // a - b
+#define OLIB_ELEMENTWISE_HADAMARD 2 // a * b, element by element
+#define OLIB_ELEMENTWISE_SCALE 3 // k * a (b isn't used)
+
+// The operations of a batch
+#define OLIB_OP_MULTIPLY 0 // result = a x b (the naive method)
+#define OLIB_OP_STRASSEN 1 // result = a x b (Strassen)
+#define OLIB_OP_TRANSPOSE 2 // result = the transpose of a
+#define OLIB_OP_RESIZE 3 // result = the given lines and columns of a
+#define OLIB_OP_INVERT 4 // result = a^-1
+#define OLIB_OP_SOLVE 5 // result = x, the solution of a x = b
+
+// The elements of the matrices. The library is built for a modulus (see
+// olib_modulus) that fits in 16 bits, so every element is in (-MOD, MOD).
+typedef int16_t olib_elem;
+
+// The configuration of the library
+typedef struct {
+	// tuning_path = the tuning file (see 'octave_tuning'; NULL = none)
+	const char *tuning_path;
+	// backend = the arithmetic back end of the naive multiplication (one of
+	// the OLIB_BACKEND_* values)
+	int backend;
+	// verify = the fraction of the products that are checked (see
+	// 'matrices_verification'); verify_fallback = 1 if a wrong product should
+	// be computed again
+	double verify;
+	int verify_fallback;
+	// seed = the seed of the verification's random vectors
+	unsigned long long seed;
+	// threads = the number of threads of a batch (0 = --threads, or one for
+	// every CPU, see 'octave_topology')
+	int threads;
+} olib_config;
+
+// A matrix of the library. Its content is only seen through the olib_matrix_*
+// functions.
+typedef struct olib_matrix olib_matrix;
+
+// A job of a batch. The caller fills in the operation and its operands;
+// result and status are filled in by the library.
+typedef struct {
+	// op = one of the OLIB_OP_* values
+	int op;
+	// a, b = the operands (b is only used by the products and the systems)
+	olib_matrix *a, *b;
+	// The lines and columns that are kept by OLIB_OP_RESIZE
+	const int *lines, *cols;
+	int lines_count, cols_count;
+	// The result (NULL if the job failed) and one of the OLIB_* status codes
+	olib_matrix *result;
+	int status;
+} olib_job;
+
+// A batch that is being executed (see olib_submit)
+typedef struct olib_batch olib_batch;
+
+// A workspace is an array of matrices that can be sorted (just like 'O' does)
+typedef struct {
+	olib_matrix **matrices;
+	int count, capacity;
+} olib_workspace;
+
+// Note: The following typedefs are kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef olib_config * olib_config_ptr;
+typedef olib_matrix * olib_matrix_ptr;
+typedef olib_job * olib_job_ptr;
+typedef olib_batch * olib_batch_ptr;
+typedef olib_workspace * olib_workspace_ptr;
+
+// This function returns the version of the interface the library was built
+// with (OLIB_VERSION)
+extern int olib_version(void);
+
+// This function returns a message that describes a status code
+extern const char *olib_status_message(int status);
+
+// This function fills the configuration with the default values
+extern void olib_config_init(olib_config_ptr config);
+
+// This function sets up the library (the tuning, the back end and the
+// verification). It has to be called before anything else (NULL = the default
+// configuration).
+extern int olib_init(olib_config_ptr config);
+
+// This function frees whatever olib_init allocated
+extern void olib_free(void);
+
+// This function returns the modulus (MOD) every operation is executed with
+extern int olib_modulus(void);
+
+// This function creates a (m x n) matrix that uses the caller's buffer: the
+// element (i, j) is data[i * ld + j]. Nothing is copied, but the elements are
+// checked (they have to be in (-MOD, MOD)). It returns NULL if anything is
+// invalid.
+extern olib_matrix_ptr olib_matrix_wrap(olib_elem *data, int m, int n,
+										size_t ld);
+
+// This function creates a (m x n) matrix from a copy of the caller's buffer
+// (the element (i, j) is data[i * ld + j]). The elements are reduced modulo
+// MOD, just like the 'L' command does. It returns NULL if anything is invalid.
+extern olib_matrix_ptr olib_matrix_copy(const int *data, int m, int n,
+										size_t ld);
+
+// This function creates a copy of a matrix. Nothing is copied: the copy shares
+// the content of the original (see 'matrices_shared'), which is never changed
+// by the library. Only a wrapped matrix is copied for real, since the caller's
+// buffer may go away with it. It returns NULL if mat is NULL.
+extern olib_matrix_ptr olib_matrix_clone(olib_matrix_ptr mat);
+
+// This function frees a matrix (the caller's buffer of a wrapped matrix is
+// left alone, and so is a content that is shared with other matrices)
+extern void olib_matrix_free(olib_matrix_ptr mat);
+
+// These functions return the size of a matrix, the sum of its elements
+// (modulo MOD) and a line of it (which must not be changed)
+extern int olib_matrix_lines(olib_matrix_ptr mat);
+extern int olib_matrix_columns(olib_matrix_ptr mat);
+extern int olib_matrix_sum(olib_matrix_ptr mat);
+extern const olib_elem *olib_matrix_line(olib_matrix_ptr mat, int i);
+
+// This function copies a matrix's elements to the caller's buffer (the element
+// (i, j) goes to data[i * ld + j])
+extern int olib_matrix_export(olib_matrix_ptr mat, olib_elem *data,
+							  size_t ld);
+
+// These functions multiply two matrices (the naive method / Strassen), in the
+// calling thread. If status isn't NULL, it is set to one of the OLIB_* codes.
+extern olib_matrix_ptr olib_multiply(olib_matrix_ptr a, olib_matrix_ptr b,
+									 int *status);
+extern olib_matrix_ptr olib_strassen(olib_matrix_ptr a, olib_matrix_ptr b,
+									 int *status);
+
+// This function transposes a matrix, in the calling thread
+extern olib_matrix_ptr olib_transpose(olib_matrix_ptr a, int *status);
+
+// This function keeps the given lines and columns of a matrix (in the given
+// order, just like 'C' does), in the calling thread. If every line and every
+// column is kept, the result is a clone (olib_matrix_clone).
+extern olib_matrix_ptr olib_resize(olib_matrix_ptr a, const int *lines,
+								   int lines_count, const int *cols,
+								   int cols_count, int *status);
+
+// These functions return the determinant (modulo MOD) and the rank of a matrix
+// (see 'matrices_linear'), or an OLIB_* error code (the determinant is only
+// defined for square matrices)
+extern int olib_determinant(olib_matrix_ptr a);
+extern int olib_rank(olib_matrix_ptr a);
+
+// This function inverts a square matrix, in the calling thread
+extern olib_matrix_ptr olib_invert(olib_matrix_ptr a, int *status);
+
+// This function solves a x = b (a is square, b has as many lines as a), in the
+// calling thread
+extern olib_matrix_ptr olib_solve(olib_matrix_ptr a, olib_matrix_ptr b,
+								  int *status);
+
+// This function computes a op b (one of the OLIB_ELEMENTWISE_* operations; b
+// isn't used by OLIB_ELEMENTWISE_SCALE, which multiplies a by k), in the
+// calling thread
+extern olib_matrix_ptr olib_elementwise(olib_matrix_ptr a, olib_matrix_ptr b,
+										int op, int k, int *status);
+
+// This function computes a = a op b in place (just like 'a', 'b', 'h' and 'k'
+// do), in the calling thread. It is the only function that changes an operand:
+// if a's content is shared with its clones, a gets its own copy first, so they
+// don't change. a must not be used by a batch that is being executed.
+extern int olib_elementwise_inplace(olib_matrix_ptr a, olib_matrix_ptr b,
+								   int op, int k);
+
+// This function multiplies a chain of matrices (a[0] x a[1] x ...), in the
+// cheapest order (see 'matrices_chain'), in the calling thread. At most
+// 1024 matrices (CHAIN_MAX_LENGTH) are accepted.
+extern olib_matrix_ptr olib_chain(olib_matrix_ptr *a, int count, int *status);
+
+// This function executes a single job, in the calling thread
+extern void olib_run_job(olib_job_ptr job);
+
+// This function starts executing a batch of jobs in the background and
+// returns right away. The jobs must not be touched until olib_wait returns.
+extern olib_batch_ptr olib_submit(olib_job_ptr jobs, int count);
+
+// This function returns 1 if every job of the batch is done
+extern int olib_poll(olib_batch_ptr batch);
+
+// This function waits for a batch to be done and frees it. It returns the
+// number of jobs that failed.
+extern int olib_wait(olib_batch_ptr batch);
+
+// These functions create / free a workspace (which frees its matrices, too)
+extern void olib_workspace_init(olib_workspace_ptr ws);
+extern void olib_workspace_free(olib_workspace_ptr ws);
+
+// This function appends a matrix to a workspace, which then owns it. It returns
+// its index.
+extern int olib_workspace_append(olib_workspace_ptr ws, olib_matrix_ptr mat);
+
+// This function returns the matrix with the given index (NULL if there is
+// none)
+extern olib_matrix_ptr olib_workspace_at(olib_workspace_ptr ws, int at);
+
+// This function frees the matrix with the given index, moving every following
+// matrix one position to the left (just like 'F' does)
+extern int olib_workspace_remove(olib_workspace_ptr ws, int at);
+
+// This function sorts the matrices by the sum of their elements (just like 'O'
+// does)
+extern void olib_workspace_sort(olib_workspace_ptr ws);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OCTAVE_LIBRARY_H
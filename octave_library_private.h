@@ -0,0 +1,56 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef OCTAVE_LIBRARY_PRIVATE_H
+#define OCTAVE_LIBRARY_PRIVATE_H
+
+// This file contains the parts of 'octave_library' that aren't given to the
+// programs that use it: the layout of its matrices and batches, and the
+// function that computes the products of the terminal (and of the server).
+
+// Standard library dependencies
+#include <pthread.h> // pthread_create, pthread_mutex_t
+#include <stdlib.h> // free
+#include <string.h> // memcpy
+
+// Other dependencies
+#include "matrices.h"
+#include "octave_library.h"
+#include "octave_stats.h" // octave_stats_clock
+#include "octave_topology.h" // topo_threads
+#include "octave_tuning.h" // tune_init, tune_load
+
+// The maximum number of threads of a batch
+#define OLIB_MAX_THREADS 16
+
+// A matrix of the library. The first member is a matrix of the simulator, so
+// a pointer to one is a pointer to the other (see olib_workspace_sort).
+struct olib_matrix {
+	matrix mat;
+	// borrowed = 1 if the elements belong to the caller (olib_matrix_wrap)
+	int borrowed;
+};
+
+// A batch that is being executed
+struct olib_batch {
+	olib_job *jobs;
+	int count;
+	// next = the next job to be started; done = the number of finished jobs
+	int next, done;
+	pthread_mutex_t lock;
+	int threads_count;
+	pthread_t threads[OLIB_MAX_THREADS];
+};
+
+// This function computes a product (naive or Strassen) of two matrices of the
+// simulator and, if it was asked for, verifies it (see
+// 'matrices_verification'; command, at1 and at2 are only used to report
+// failures). The terminal computes its products this way, too. It returns
+// NULL if the matrices can't be multiplied.
+extern matrix_ptr olib_product(matrix_ptr m1, matrix_ptr m2, int strassen,
+							   char command, int at1, int at2);
+
+// This function is executed by the threads of a batch: it runs jobs until
+// there are none left
+extern void *olib_batch_thread(void *arg);
+
+#endif // OCTAVE_LIBRARY_PRIVATE_H
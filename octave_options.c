@@ -0,0 +1,281 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "octave_options.h"
+
+// This function fills the options structure with the default values
+void octave_options_init(octave_options_ptr opts)
+{
+	opts->mode = OCTAVE_MODE_TERMINAL;
+	opts->stats = 0;
+	opts->stats_path = NULL;
+	opts->memory_budget = 0;
+	opts->spill_path = NULL;
+	opts->server_path = NULL;
+	opts->threads = 0;
+	opts->workers = NULL;
+	opts->local_workers = 0;
+	opts->worker_address = NULL;
+	opts->numa = TOPO_NUMA_OFF;
+	opts->pin_threads = 0;
+	opts->huge_pages = 0;
+	opts->huge_threshold = TOPO_DEFAULT_THRESHOLD;
+	opts->topology = 0;
+	opts->tuning_path = NULL;
+	opts->verify = 0;
+	opts->verify_fallback = 0;
+	opts->backend = MULTIPLY_BACKEND_INT64;
+
+	opts->seed = 42;
+	opts->commands = 1000;
+	opts->mix = "L4D1P1C1M2O1T1F1S1";
+	opts->size_min = 1;
+	opts->size_max = 64;
+	opts->size_pow2 = 0;
+	opts->bench_size = 256;
+	opts->bench_ms = 200;
+	opts->baseline_path = NULL;
+	opts->save_baseline_path = NULL;
+	opts->tolerance = 10.0;
+}
+
+// This function outputs the list of accepted arguments
+void octave_options_usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [options] < commands\n", name);
+	fprintf(stderr, "  --stats              dump statistics to stderr\n");
+	fprintf(stderr, "  --stats=FILE         append statistics to FILE\n");
+	fprintf(stderr, "  --memory-budget=SIZE spill cold matrices above SIZE\n");
+	fprintf(stderr, "  --spill-file=FILE    where the matrices are spilled\n");
+	fprintf(stderr, "  --server=PATH        serve clients on a Unix socket\n");
+	fprintf(stderr, "  --threads=N          threads of the server, a kernel\n");
+	fprintf(stderr, "  --workers=H:P,...    split big products\n");
+	fprintf(stderr, "  --local-workers=N    start N workers on this machine\n");
+	fprintf(stderr, "  --worker=[HOST:]PORT run as a worker\n");
+	fprintf(stderr, "  --numa=POLICY        off, local or interleave\n");
+	fprintf(stderr, "  --pin-threads        pin the workers to CPUs\n");
+	fprintf(stderr, "  --huge-pages         use huge pages for big blocks\n");
+	fprintf(stderr, "  --huge-threshold=SIZE size of a big allocation (2M)\n");
+	fprintf(stderr, "  --topology           output the topology at startup\n");
+	fprintf(stderr, "  --tune               tune the kernels for this CPU\n");
+	fprintf(stderr, "  --tuning-file=FILE   tuning to read (or --tune)\n");
+	fprintf(stderr, "  --verify             check every product (Freivalds)\n");
+	fprintf(stderr, "  --verify=FRACTION    check a fraction of them\n");
+	fprintf(stderr, "  --verify-fallback    compute wrong products again\n");
+	fprintf(stderr, "  --backend=NAME       int64, fma or madd products\n");
+	fprintf(stderr, "  --generate           output a workload and exit\n");
+	fprintf(stderr, "  --bench              run the microbenchmarks\n");
+	fprintf(stderr, "  --seed=N             seed of the generator (42)\n");
+	fprintf(stderr, "  --commands=N         commands per workload (1000)\n");
+	fprintf(stderr, "  --mix=L4D1...        weight of every command\n");
+	fprintf(stderr, "  --sizes=MIN:MAX      dimensions of the matrices\n");
+	fprintf(stderr, "  --pow2               only use powers of two\n");
+	fprintf(stderr, "  --bench-size=N       size of the benchmarked matrices\n");
+	fprintf(stderr, "  --bench-ms=N         time spent on every kernel\n");
+	fprintf(stderr, "  --baseline=FILE      compare against a baseline\n");
+	fprintf(stderr, "  --save-baseline=FILE store the results\n");
+	fprintf(stderr, "  --tolerance=PCT      allowed slowdown (10%%)\n");
+}
+
+// If arg looks like "name=value", this function returns value. Otherwise, it
+// returns NULL.
+const char *octave_options_value(const char *arg, const char *name)
+{
+	size_t len = strlen(name);
+	if (strncmp(arg, name, len) || arg[len] != '=')
+		return NULL;
+	return arg + len + 1;
+}
+
+// This function parses a size such as "512", "64K", "256M" or "2G". It returns
+// 0 if the size is invalid.
+int octave_options_size(const char *value, unsigned long long *size)
+{
+	char *end;
+	*size = strtoull(value, &end, 10);
+	switch (*end) {
+	case 'G':
+	case 'g':
+		*size <<= 10;
+		// fall through
+	case 'M':
+	case 'm':
+		*size <<= 10;
+		// fall through
+	case 'K':
+	case 'k':
+		*size <<= 10;
+		++end;
+		break;
+	}
+
+	return end != value && *end == '\0';
+}
+
+// This function returns the weight written after the command at p in a mix
+// (1 if there is none, so "L4D" = "L4D1")
+int octave_options_weight(const char *p)
+{
+	return isdigit((unsigned char)p[1]) ? atoi(p + 1) : 1;
+}
+
+// This function checks a mix such as "L4D1P1": every letter must be one of the
+// OCTAVE_MIX_COMMANDS and at least one of them must have a positive weight. It
+// returns 0 if the mix is invalid.
+int octave_options_mix(const char *mix)
+{
+	// The total is an int for the generator, so it can't overflow either
+	long long total = 0;
+	for (const char *p = mix; *p;) {
+		if (!strchr(OCTAVE_MIX_COMMANDS, *p))
+			return 0;
+		char *end = (char *)++p;
+		long weight = isdigit((unsigned char)*p) ? strtol(p, &end, 10) : 1;
+		if (weight > INT_MAX || (total += weight) > INT_MAX)
+			return 0;
+		p = end;
+	}
+
+	return total > 0;
+}
+
+// This function parses the command line arguments. If an unknown argument is
+// found, it outputs an error message (and the usage) and returns 0.
+int octave_options_parse(octave_options_ptr opts, int argc, char **argv)
+{
+	octave_options_init(opts);
+
+	for (int i = 1; i < argc; ++i) {
+		const char *value;
+		if (!strcmp(argv[i], "--stats")) {
+			opts->stats = 1;
+		} else if ((value = octave_options_value(argv[i], "--stats"))) {
+			opts->stats = 1;
+			opts->stats_path = value;
+		} else if ((value = octave_options_value(argv[i],
+												 "--memory-budget"))) {
+			if (!octave_options_size(value, &opts->memory_budget)) {
+				fprintf(stderr, "Invalid memory budget: %s\n", value);
+				return 0;
+			}
+		} else if ((value = octave_options_value(argv[i], "--spill-file"))) {
+			opts->spill_path = value;
+		} else if ((value = octave_options_value(argv[i], "--server"))) {
+			opts->mode = OCTAVE_MODE_SERVER;
+			opts->server_path = value;
+		} else if ((value = octave_options_value(argv[i], "--threads"))) {
+			opts->threads = atoi(value);
+			if (opts->threads < 1) {
+				fprintf(stderr, "Invalid number of threads: %s\n", value);
+				return 0;
+			}
+		} else if ((value = octave_options_value(argv[i], "--workers"))) {
+			opts->workers = value;
+		} else if ((value = octave_options_value(argv[i],
+												 "--local-workers"))) {
+			opts->local_workers = atoi(value);
+			if (opts->local_workers < 0) {
+				fprintf(stderr, "Invalid number of workers: %s\n", value);
+				return 0;
+			}
+		} else if ((value = octave_options_value(argv[i], "--worker"))) {
+			opts->mode = OCTAVE_MODE_WORKER;
+			opts->worker_address = value;
+		} else if ((value = octave_options_value(argv[i], "--numa"))) {
+			if (!strcmp(value, "off")) {
+				opts->numa = TOPO_NUMA_OFF;
+			} else if (!strcmp(value, "local")) {
+				opts->numa = TOPO_NUMA_LOCAL;
+			} else if (!strcmp(value, "interleave")) {
+				opts->numa = TOPO_NUMA_INTERLEAVE;
+			} else {
+				fprintf(stderr, "Invalid NUMA policy: %s\n", value);
+				return 0;
+			}
+		} else if (!strcmp(argv[i], "--pin-threads")) {
+			opts->pin_threads = 1;
+		} else if (!strcmp(argv[i], "--huge-pages")) {
+			opts->huge_pages = 1;
+		} else if ((value = octave_options_value(argv[i],
+												 "--huge-threshold"))) {
+			if (!octave_options_size(value, &opts->huge_threshold)) {
+				fprintf(stderr, "Invalid huge page threshold: %s\n", value);
+				return 0;
+			}
+		} else if (!strcmp(argv[i], "--verify")) {
+			opts->verify = 1;
+		} else if ((value = octave_options_value(argv[i], "--verify"))) {
+			char *end;
+			opts->verify = strtod(value, &end);
+			if (end == value || *end || opts->verify < 0 || opts->verify > 1) {
+				fprintf(stderr, "Invalid verification fraction: %s\n", value);
+				return 0;
+			}
+		} else if (!strcmp(argv[i], "--verify-fallback")) {
+			opts->verify_fallback = 1;
+		} else if ((value = octave_options_value(argv[i], "--backend"))) {
+			opts->backend = multiply_backend_lookup(value);
+			if (opts->backend < 0) {
+				fprintf(stderr, "Invalid back end: %s\n", value);
+				return 0;
+			}
+		} else if (!strcmp(argv[i], "--tune")) {
+			opts->mode = OCTAVE_MODE_TUNE;
+		} else if ((value = octave_options_value(argv[i], "--tuning-file"))) {
+			opts->tuning_path = value;
+		} else if (!strcmp(argv[i], "--topology")) {
+			opts->topology = 1;
+		} else if (!strcmp(argv[i], "--generate")) {
+			opts->mode = OCTAVE_MODE_GENERATE;
+		} else if (!strcmp(argv[i], "--bench")) {
+			opts->mode = OCTAVE_MODE_BENCH;
+		} else if ((value = octave_options_value(argv[i], "--seed"))) {
+			opts->seed = strtoull(value, NULL, 10);
+		} else if ((value = octave_options_value(argv[i], "--commands"))) {
+			opts->commands = atoi(value);
+			if (opts->commands < 1) {
+				fprintf(stderr, "Invalid number of commands: %s\n", value);
+				return 0;
+			}
+		} else if ((value = octave_options_value(argv[i], "--mix"))) {
+			opts->mix = value;
+			if (!octave_options_mix(value)) {
+				fprintf(stderr, "Invalid mix: %s\n", value);
+				return 0;
+			}
+		} else if ((value = octave_options_value(argv[i], "--sizes"))) {
+			if (sscanf(value, "%d:%d", &opts->size_min, &opts->size_max) != 2 ||
+				opts->size_min < 1 || opts->size_max < opts->size_min) {
+				fprintf(stderr, "Invalid sizes: %s\n", value);
+				return 0;
+			}
+		} else if (!strcmp(argv[i], "--pow2")) {
+			opts->size_pow2 = 1;
+		} else if ((value = octave_options_value(argv[i], "--bench-size"))) {
+			opts->bench_size = atoi(value);
+			if (opts->bench_size < 1) {
+				fprintf(stderr, "Invalid benchmark size: %s\n", value);
+				return 0;
+			}
+		} else if ((value = octave_options_value(argv[i], "--bench-ms"))) {
+			opts->bench_ms = atoi(value);
+			if (opts->bench_ms < 1) {
+				fprintf(stderr, "Invalid benchmark time: %s\n", value);
+				return 0;
+			}
+		} else if ((value = octave_options_value(argv[i], "--baseline"))) {
+			opts->baseline_path = value;
+		} else if ((value = octave_options_value(argv[i],
+												 "--save-baseline"))) {
+			opts->save_baseline_path = value;
+		} else if ((value = octave_options_value(argv[i], "--tolerance"))) {
+			opts->tolerance = strtod(value, NULL);
+		} else {
+			fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+			octave_options_usage(argv[0]);
+			return 0;
+		}
+	}
+
+	return 1;
+}
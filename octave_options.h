@@ -0,0 +1,132 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef OCTAVE_OPTIONS_H
+#define OCTAVE_OPTIONS_H
+
+// This file contains the startup options of the simulator. Running the program
+// without any argument keeps the original behaviour - every option is off.
+
+// Standard library dependencies
+#include <ctype.h> // isdigit
+#include <limits.h> // INT_MAX
+#include <stdio.h> // fprintf
+#include <stdlib.h> // strtoull, strtod
+#include <string.h> // strcmp, strncmp
+
+// Other dependencies
+#include "matrices_multiplication.h" // MULTIPLY_BACKEND_*
+#include "octave_topology.h" // TOPO_NUMA_*, TOPO_DEFAULT_THRESHOLD
+
+// The simulator can run in one of these modes
+#define OCTAVE_MODE_TERMINAL 0 // read commands from stdin (the default)
+#define OCTAVE_MODE_GENERATE 1 // output a workload (see 'octave_benchmark')
+#define OCTAVE_MODE_BENCH 2 // run the microbenchmarks
+#define OCTAVE_MODE_SERVER 3 // accept clients on a socket (see 'octave_server')
+#define OCTAVE_MODE_WORKER 4 // multiply blocks (see 'matrices_distributed')
+#define OCTAVE_MODE_TUNE 5 // tune the kernels (see 'octave_tuning')
+
+// The commands a generated workload is made of (see '--mix')
+#define OCTAVE_MIX_COMMANDS "LDPCMOTFS"
+
+// The options structure
+typedef struct {
+	// mode = one of the OCTAVE_MODE_* values
+	int mode;
+	// stats = 1 if the instrumentation (see 'octave_stats') is enabled
+	int stats;
+	// stats_path = the file the statistics are appended to (NULL = stderr)
+	const char *stats_path;
+	// memory_budget = the maximum number of bytes the loaded matrices may use
+	// before the cold ones are spilled (0 = unlimited, see 'matrices_memory')
+	unsigned long long memory_budget;
+	// spill_path = the spill file (NULL = an anonymous temporary file)
+	const char *spill_path;
+	// server_path = the Unix domain socket the server listens on
+	const char *server_path;
+	// threads = the number of worker threads of the server and the most
+	// threads a kernel may use (0 = the defaults, see 'octave_topology')
+	int threads;
+	// workers = the worker processes (HOST:PORT,...) big products are split
+	// between (NULL = none, see 'matrices_distributed')
+	const char *workers;
+	// local_workers = the number of worker processes started on this machine
+	int local_workers;
+	// worker_address = where a worker process listens ([HOST:]PORT)
+	const char *worker_address;
+	// The placement of the memory and of the threads (see 'octave_topology'):
+	// numa = one of the TOPO_NUMA_* values
+	int numa;
+	// pin_threads = 1 if the workers are pinned to CPUs
+	int pin_threads;
+	// huge_pages = 1 if big allocations use transparent huge pages
+	int huge_pages;
+	// huge_threshold = the size of a big allocation
+	unsigned long long huge_threshold;
+	// topology = 1 if the topology should be output at startup
+	int topology;
+	// tuning_path = the tuning file that is read at startup (see
+	// 'octave_tuning'; NULL = none, so the default parameters are used)
+	const char *tuning_path;
+	// verify = the fraction of the products that are checked (see
+	// 'matrices_verification'; 0 = none)
+	double verify;
+	// verify_fallback = 1 if a wrong product should be computed again
+	int verify_fallback;
+	// backend = the arithmetic back end of the naive multiplication (one of
+	// the MULTIPLY_BACKEND_* values)
+	int backend;
+
+	// The following options are only used by 'octave_benchmark'
+	// seed = the seed of the pseudo-random number generator
+	unsigned long long seed;
+	// commands = the number of commands in a generated workload
+	int commands;
+	// mix = the weight of every command, e.g. "L4D1P1C1M2O1T1F1S1"
+	const char *mix;
+	// The dimensions of the generated matrices are in [size_min, size_max]
+	int size_min, size_max;
+	// size_pow2 = 1 if the dimensions should be powers of two
+	int size_pow2;
+	// bench_size = the size of the (square) matrices used by the kernels
+	int bench_size;
+	// bench_ms = the minimum time (in ms) spent measuring every kernel
+	int bench_ms;
+	// The results are compared to / stored in these files (NULL = unused)
+	const char *baseline_path, *save_baseline_path;
+	// tolerance = how much slower (in %) a kernel may get before it is
+	// reported as a regression
+	double tolerance;
+} octave_options;
+
+// Note: The following typedef is kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef octave_options * octave_options_ptr;
+
+// This function fills the options structure with the default values
+extern void octave_options_init(octave_options_ptr opts);
+
+// This function outputs the list of accepted arguments
+extern void octave_options_usage(const char *name);
+
+// If arg looks like "name=value", this function returns value. Otherwise, it
+// returns NULL.
+extern const char *octave_options_value(const char *arg, const char *name);
+
+// This function parses a size such as "512", "64K", "256M" or "2G". It returns
+// 0 if the size is invalid.
+extern int octave_options_size(const char *value, unsigned long long *size);
+
+// This function returns the weight written after the command at p in a mix
+// (1 if there is none, so "L4D" = "L4D1")
+extern int octave_options_weight(const char *p);
+
+// This function checks a mix such as "L4D1P1": every letter must be one of the
+// OCTAVE_MIX_COMMANDS and at least one of them must have a positive weight. It
+// returns 0 if the mix is invalid.
+extern int octave_options_mix(const char *mix);
+
+// This function parses the command line arguments. If an unknown argument is
+// found, it outputs an error message (and the usage) and returns 0.
+extern int octave_options_parse(octave_options_ptr opts, int argc, char **argv);
+
+#endif // OCTAVE_OPTIONS_H
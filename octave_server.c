@@ -0,0 +1,626 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// epoll and eventfd are Linux features
+#define _GNU_SOURCE
+
+// Include the asscociated header file
+#include "octave_server.h"
+
+// Standard library dependencies
+#include <errno.h> // errno, EAGAIN, EINTR
+#include <fcntl.h> // fcntl, O_NONBLOCK
+#include <limits.h> // INT_MAX
+#include <signal.h> // sigaction, SIGINT, SIGTERM, SIGPIPE
+#include <stdint.h> // uint64_t
+#include <string.h> // memcpy, memmove, memset, strncpy, strlen
+#include <sys/epoll.h> // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/eventfd.h> // eventfd
+#include <sys/socket.h> // socket, bind, listen, accept, send, recv
+#include <sys/un.h> // sockaddr_un
+#include <unistd.h> // close, read, write, unlink
+
+// Set by the signal handler once the server has to stop
+static volatile sig_atomic_t stop_requested;
+
+// This function is called on SIGINT / SIGTERM
+static void server_stop(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
+
+// This function appends len bytes to a buffer
+void server_buffer_append(server_buffer *buf, const char *data, size_t len)
+{
+	if (!len)
+		return;
+	if (buf->len + len > buf->size) {
+		buf->size = buf->size ? buf->size : 256;
+		while (buf->len + len > buf->size)
+			buf->size *= 2;
+		buf->data = safe_realloc(buf->data, buf->size);
+	}
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+// This function removes the first len bytes of a buffer
+void server_buffer_consume(server_buffer *buf, size_t len)
+{
+	memmove(buf->data, buf->data + len, buf->len - len);
+	buf->len -= len;
+}
+
+// This function skips the whitespace and the next token (an integer) of a
+// command. It returns 0 if the token wasn't received entirely yet - a token
+// is only complete once the whitespace after it was received.
+static int server_next_token(const char *buf, size_t len, size_t *pos,
+							 long long *value)
+{
+	while (*pos < len && (buf[*pos] == ' ' || buf[*pos] == '\n' ||
+						  buf[*pos] == '\t' || buf[*pos] == '\r'))
+		++*pos;
+
+	size_t start = *pos;
+	while (*pos < len && buf[*pos] != ' ' && buf[*pos] != '\n' &&
+		   buf[*pos] != '\t' && buf[*pos] != '\r')
+		++*pos;
+	if (*pos == len || *pos == start)
+		return 0;
+
+	*value = strtoll(buf + start, NULL, 10);
+	return 1;
+}
+
+// This function reads the next token of a command, if it was received
+// entirely, and moves the scan past it
+static int server_scan_token(const char *buf, size_t len, server_scan *scan,
+							 long long *value)
+{
+	size_t pos = scan->pos;
+	if (!server_next_token(buf, len, &pos, value))
+		return 0;
+	scan->pos = pos;
+	return 1;
+}
+
+// This function returns the number of integers that follow a command which
+// doesn't tell it itself
+static long long server_command_tokens(char command)
+{
+	switch (command) {
+	case 'D':
+	case 'P':
+	case 'T':
+	case 'F':
+	case 'E':
+	case 'R':
+	case 'V':
+	case 'U':
+	case 'W':
+		return 1;
+
+	case 'M':
+	case 'S':
+	case 'X':
+	case 'A':
+	case 'B':
+	case 'H':
+	case 'K':
+	case 'a':
+	case 'b':
+	case 'h':
+	case 'k':
+		return 2;
+	}
+	return 0;
+}
+
+// This function returns the length of the first command in buf (leading
+// newlines included), 0 if the command wasn't received entirely yet or
+// SERVER_INVALID. The scan starts where the previous one stopped (the scan
+// structure has to be zeroed for every new command).
+size_t server_command_length(const char *buf, size_t len, server_scan *scan)
+{
+	// Exactly like the terminal, skip the empty lines
+	if (!scan->command) {
+		while (scan->pos < len && buf[scan->pos] == '\n')
+			++scan->pos;
+		if (scan->pos == len)
+			return 0;
+		scan->command = buf[scan->pos++];
+	}
+
+	long long value;
+	while (1) {
+		// The integers whose values don't matter are only skipped
+		for (; scan->remaining > 0; --scan->remaining)
+			if (!server_scan_token(buf, len, scan, &value))
+				return 0;
+
+		// The others tell how many integers follow
+		switch (scan->command) {
+		case 'L': // m, n and then (m x n) elements
+			if (scan->step == 2)
+				return scan->pos;
+			if (!server_scan_token(buf, len, scan, &value))
+				return 0;
+			// The dimensions are ints (and their product can't overflow)
+			if (value < 1 || value > INT_MAX)
+				return SERVER_INVALID;
+			if (scan->step++)
+				scan->remaining = scan->m * value;
+			else
+				scan->m = value;
+			break;
+
+		case 'C': // the index, then two arrays (each preceded by its length)
+			if (scan->step == 3)
+				return scan->pos;
+			if (!server_scan_token(buf, len, scan, &value))
+				return 0;
+			if (scan->step++)
+				scan->remaining = value > 0 ? value : 0;
+			break;
+
+		case 'N': // the length of the chain, then its indexes
+			if (scan->step == 1)
+				return scan->pos;
+			if (!server_scan_token(buf, len, scan, &value))
+				return 0;
+			scan->remaining = value > 0 ? value : 0;
+			++scan->step;
+			break;
+
+		default:
+			if (scan->step == 1)
+				return scan->pos;
+			scan->remaining = server_command_tokens(scan->command);
+			++scan->step;
+			break;
+		}
+	}
+}
+
+// This function makes a file descriptor non-blocking
+static int server_set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// This function updates the events epoll waits for on a connection: new input
+// (until the client stops sending it) and, if some output couldn't be sent
+// yet, room in the socket's buffer
+static void server_watch(octave_server_ptr server, server_connection_ptr conn)
+{
+	unsigned int events = 0;
+	if (conn->closing == SERVER_OPEN)
+		events |= EPOLLIN;
+	if (conn->out_sent < conn->out.len)
+		events |= EPOLLOUT;
+	if (conn->events == events)
+		return;
+
+	struct epoll_event ev;
+	ev.events = events;
+	ev.data.ptr = conn;
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+	conn->events = events;
+}
+
+// This function accepts every pending client
+void server_accept(octave_server_ptr server)
+{
+	while (1) {
+		int fd = accept(server->listen_fd, NULL, NULL);
+		if (fd < 0)
+			return;
+		server_set_nonblocking(fd);
+
+		server_connection_ptr conn = safe_malloc(sizeof(server_connection));
+		memset(conn, 0, sizeof(server_connection));
+		conn->fd = fd;
+		conn->events = EPOLLIN;
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = conn;
+		if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			close(fd);
+			free(conn);
+			continue;
+		}
+
+		conn->next_all = server->connections;
+		if (server->connections)
+			server->connections->prev_all = conn;
+		server->connections = conn;
+	}
+}
+
+// This function is called once a client is gone. The connection is freed
+// right away, unless one of its commands is being executed.
+void server_hangup(octave_server_ptr server, server_connection_ptr conn)
+{
+	conn->closing = SERVER_HANGUP;
+	if (!conn->busy) {
+		server_close(server, conn);
+		return;
+	}
+
+	// The socket is only closed with the connection (otherwise, its number
+	// could be reused by a new client in the meantime), but epoll should stop
+	// reporting it
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+}
+
+// This function closes a connection
+void server_close(octave_server_ptr server, server_connection_ptr conn)
+{
+	epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+	conn->closing = SERVER_CLOSED;
+
+	if (conn->prev_all)
+		conn->prev_all->next_all = conn->next_all;
+	else
+		server->connections = conn->next_all;
+	if (conn->next_all)
+		conn->next_all->prev_all = conn->prev_all;
+
+	conn->next = server->closed;
+	server->closed = conn;
+}
+
+// This function frees the connections that were closed
+void server_free_closed(octave_server_ptr server)
+{
+	while (server->closed) {
+		server_connection_ptr conn = server->closed;
+		server->closed = conn->next;
+
+		free(conn->in.data);
+		free(conn->out.data);
+		free(conn->command);
+		free(conn->result);
+		free(conn);
+	}
+}
+
+// This function reads whatever a client sent. It returns 0 if the client hung
+// up (the connection may have been freed already).
+int server_receive(octave_server_ptr server, server_connection_ptr conn)
+{
+	char chunk[SERVER_READ_SIZE];
+	while (conn->closing == SERVER_OPEN) {
+		ssize_t r = recv(conn->fd, chunk, sizeof(chunk), 0);
+		if (r > 0) {
+			server_buffer_append(&conn->in, chunk, r);
+		} else if (r == 0) {
+			// The client won't send anything else, but it may still wait for
+			// the output of what it sent - exactly like after 'Q'
+			conn->closing = SERVER_QUIT;
+			server_watch(server, conn);
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return 1;
+		} else if (errno != EINTR) {
+			server_hangup(server, conn);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// This function sends as much of a connection's output as the socket accepts.
+// It returns 0 if the connection was closed (and freed).
+int server_flush(octave_server_ptr server, server_connection_ptr conn)
+{
+	while (conn->out_sent < conn->out.len) {
+		ssize_t w = send(conn->fd, conn->out.data + conn->out_sent,
+						 conn->out.len - conn->out_sent, MSG_NOSIGNAL);
+		if (w < 0 && errno == EINTR)
+			continue;
+		if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (w < 0) {
+			server_hangup(server, conn);
+			return 0;
+		}
+		conn->out_sent += w;
+	}
+
+	// Wait until the client reads the rest of it (if there is any)
+	if (conn->out_sent == conn->out.len) {
+		conn->out.len = 0;
+		conn->out_sent = 0;
+	}
+	server_watch(server, conn);
+	return 1;
+}
+
+// This function passes the next command of a connection to the workers (if
+// the connection isn't already busy and a whole command was received)
+void server_dispatch(octave_server_ptr server, server_connection_ptr conn)
+{
+	if (conn->busy || conn->closing >= SERVER_HANGUP)
+		return;
+
+	size_t len = server_command_length(conn->in.data, conn->in.len,
+									   &conn->scan);
+	if (len == SERVER_INVALID) {
+		// Nothing after the command can be parsed, so the session ends here
+		// (once the error is sent)
+		server_buffer_append(&conn->out, INVALID_COMMAND,
+							 strlen(INVALID_COMMAND));
+		conn->in.len = 0;
+		memset(&conn->scan, 0, sizeof(conn->scan));
+		conn->closing = SERVER_QUIT;
+		server_watch(server, conn);
+		return;
+	}
+	if (len && conn->scan.command == 'Q') {
+		// 'Q' only ends this client's session (anything after it is ignored)
+		conn->in.len = 0;
+		memset(&conn->scan, 0, sizeof(conn->scan));
+		conn->closing = SERVER_QUIT;
+		server_watch(server, conn);
+		len = 0;
+	}
+
+	// Once the client stopped sending commands and every one of them was
+	// executed, the connection is closed as soon as the output is sent
+	if (!len) {
+		if (conn->closing == SERVER_QUIT && !conn->out.len)
+			server_close(server, conn);
+		return;
+	}
+
+	conn->command = safe_malloc(len);
+	memcpy(conn->command, conn->in.data, len);
+	conn->command_len = len;
+	server_buffer_consume(&conn->in, len);
+	memset(&conn->scan, 0, sizeof(conn->scan));
+	conn->busy = 1;
+
+	pthread_mutex_lock(&server->queue_lock);
+	conn->next = NULL;
+	if (server->jobs_tail)
+		server->jobs_tail->next = conn;
+	else
+		server->jobs = conn;
+	server->jobs_tail = conn;
+	pthread_cond_signal(&server->queue_cond);
+	pthread_mutex_unlock(&server->queue_lock);
+}
+
+// This function is executed by every worker thread
+void *server_worker(void *arg)
+{
+	octave_server_ptr server = arg;
+	topo_pin(__atomic_fetch_add(&server->workers_started, 1, __ATOMIC_RELAXED));
+	while (1) {
+		// Wait for a command
+		pthread_mutex_lock(&server->queue_lock);
+		while (!server->jobs && server->running)
+			pthread_cond_wait(&server->queue_cond, &server->queue_lock);
+		if (!server->running) {
+			pthread_mutex_unlock(&server->queue_lock);
+			return NULL;
+		}
+		server_connection_ptr conn = server->jobs;
+		server->jobs = conn->next;
+		if (!server->jobs)
+			server->jobs_tail = NULL;
+		pthread_mutex_unlock(&server->queue_lock);
+
+		// The command is executed exactly like in the terminal, except that
+		// it is read from (and writes to) memory
+		octave_session session = {
+			.in = fmemopen(conn->command, conn->command_len, "r"),
+			.out = open_memstream(&conn->result, &conn->result_len),
+			.dm = &server->dm, .lock = &server->lock, .exclusive = 0,
+			.stats = server->stats, .flops = 0
+		};
+		if (!session.in || !session.out) {
+			fprintf(stderr, "FATAL: Could not create the session streams.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		char command;
+		do {
+			command = fgetc(session.in);
+		} while (command == '\n');
+		octave_execute(&session, command);
+		fclose(session.in);
+		fclose(session.out);
+
+		// Let the event loop know the command is done
+		pthread_mutex_lock(&server->queue_lock);
+		conn->next = server->done;
+		server->done = conn;
+		pthread_mutex_unlock(&server->queue_lock);
+
+		uint64_t one = 1;
+		if (write(server->event_fd, &one, sizeof(one)) < 0)
+			perror("write");
+	}
+}
+
+// This function handles the commands that were executed by the workers
+void server_collect(octave_server_ptr server)
+{
+	uint64_t count;
+	if (read(server->event_fd, &count, sizeof(count)) < 0)
+		return;
+
+	pthread_mutex_lock(&server->queue_lock);
+	server_connection_ptr done = server->done;
+	server->done = NULL;
+	pthread_mutex_unlock(&server->queue_lock);
+
+	while (done) {
+		server_connection_ptr conn = done;
+		done = done->next;
+
+		conn->busy = 0;
+		free(conn->command);
+		conn->command = NULL;
+		server_buffer_append(&conn->out, conn->result, conn->result_len);
+		free(conn->result);
+		conn->result = NULL;
+
+		if (conn->closing == SERVER_HANGUP) {
+			server_close(server, conn);
+			continue;
+		}
+
+		// Send the output and start the client's next command
+		if (server_flush(server, conn))
+			server_dispatch(server, conn);
+	}
+}
+
+// This function creates the listening socket. It returns -1 on failure.
+static int server_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "The socket path is too long: %s\n", path);
+		return -1;
+	}
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	// A socket left behind by a previous run would make bind fail
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(fd, SOMAXCONN) < 0 || server_set_nonblocking(fd) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// This function runs the server until SIGINT / SIGTERM is received
+int octave_server_run(octave_options_ptr opts)
+{
+	// The workers are started before anything else (see 'octave_terminal')
+	if (!dist_init(opts->workers, opts->local_workers))
+		return EXIT_FAILURE;
+
+	octave_server server;
+	memset(&server, 0, sizeof(server));
+
+	octave_stats stats;
+	octave_stats_init(&stats, opts->stats, opts->stats_path);
+	server.stats = &stats;
+
+	dm_init(&server.dm);
+	pthread_rwlock_init(&server.lock, NULL);
+	pthread_mutex_init(&server.queue_lock, NULL);
+	pthread_cond_init(&server.queue_cond, NULL);
+	if (!mm_init(&server.dm, opts->memory_budget, opts->spill_path))
+		return EXIT_FAILURE;
+
+	server.listen_fd = server_listen(opts->server_path);
+	server.epoll_fd = epoll_create1(0);
+	server.event_fd = eventfd(0, EFD_NONBLOCK);
+	if (server.listen_fd < 0 || server.epoll_fd < 0 || server.event_fd < 0)
+		return EXIT_FAILURE;
+
+	// The two special file descriptors are told apart by their pointers
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = &server.listen_fd;
+	epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &ev);
+	ev.data.ptr = &server.event_fd;
+	epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.event_fd, &ev);
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = server_stop;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	server.running = 1;
+	server.workers_count = opts->threads > 0 ? opts->threads
+											 : SERVER_DEFAULT_THREADS;
+	server.workers = safe_malloc(server.workers_count * sizeof(pthread_t));
+	for (int i = 0; i < server.workers_count; ++i)
+		pthread_create(&server.workers[i], NULL, server_worker, &server);
+
+	struct epoll_event events[SERVER_MAX_EVENTS];
+	while (!stop_requested) {
+		int n = epoll_wait(server.epoll_fd, events, SERVER_MAX_EVENTS, -1);
+		if (n < 0 && errno != EINTR) {
+			perror("epoll_wait");
+			break;
+		}
+
+		for (int i = 0; i < n; ++i) {
+			if (events[i].data.ptr == &server.listen_fd) {
+				server_accept(&server);
+			} else if (events[i].data.ptr == &server.event_fd) {
+				server_collect(&server);
+			} else {
+				server_connection_ptr conn = events[i].data.ptr;
+				if (conn->closing == SERVER_CLOSED)
+					continue;
+				if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+					server_hangup(&server, conn);
+					continue;
+				}
+				if ((events[i].events & EPOLLOUT) &&
+					!server_flush(&server, conn))
+					continue;
+				if ((events[i].events & EPOLLIN) &&
+					!server_receive(&server, conn))
+					continue;
+				server_dispatch(&server, conn);
+			}
+		}
+		server_free_closed(&server);
+	}
+
+	// Stop the workers (the commands that are being executed are finished)
+	pthread_mutex_lock(&server.queue_lock);
+	server.running = 0;
+	pthread_cond_broadcast(&server.queue_cond);
+	pthread_mutex_unlock(&server.queue_lock);
+	for (int i = 0; i < server.workers_count; ++i)
+		pthread_join(server.workers[i], NULL);
+	free(server.workers);
+
+	while (server.connections)
+		server_close(&server, server.connections);
+	server_free_closed(&server);
+	close(server.listen_fd);
+	close(server.epoll_fd);
+	close(server.event_fd);
+	unlink(opts->server_path);
+
+	// Free all the memory and quit
+	if (stats.enabled)
+		octave_stats_dump(&stats, &server.dm);
+	octave_stats_free(&stats);
+	if (verify_enabled())
+		verify_report(stderr);
+	mm_free();
+	dist_free();
+	dm_release_all_matrices(&server.dm);
+	dm_free_all_matrices(&server.dm);
+	pthread_rwlock_destroy(&server.lock);
+	pthread_mutex_destroy(&server.queue_lock);
+	pthread_cond_destroy(&server.queue_cond);
+	return 0;
+}
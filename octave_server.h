@@ -0,0 +1,176 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef OCTAVE_SERVER_H
+#define OCTAVE_SERVER_H
+
+// This file contains the server mode of the simulator (--server=PATH). Instead
+// of reading stdin, the simulator listens on a Unix domain socket and accepts
+// any number of clients, which speak the same protocol as the terminal. All the
+// clients share the same array of matrices.
+//
+// A single thread waits for events on every connection (epoll), so an idle
+// client only costs its (small) connection structure. Once a whole command was
+// received, it is executed by one of the worker threads. The commands of a
+// client are executed in order; the array of matrices is protected by a
+// reader / writer lock, so commands that only read it ('D', 'P', the
+// multiplications) from different clients are executed at the same time.
+// 'Q' only ends the client's session; the server stops on SIGINT / SIGTERM.
+
+// Standard library dependencies
+#include <pthread.h> // pthread_t, pthread_mutex_t, pthread_cond_t
+#include <stdio.h> // fmemopen, open_memstream
+
+// Other dependencies
+#include "octave.h"
+#include "octave_topology.h" // topo_pin
+
+// The default number of worker threads
+#define SERVER_DEFAULT_THREADS 4
+// The maximum number of events that are handled at once
+#define SERVER_MAX_EVENTS 64
+// The size of a single read from a socket
+#define SERVER_READ_SIZE 65536
+
+// The states of a connection
+#define SERVER_OPEN 0
+#define SERVER_QUIT 1
+#define SERVER_HANGUP 2
+#define SERVER_CLOSED 3
+
+// server_command_length returns this for a command that can't be executed
+// (the rest of the client's input can't be parsed either)
+#define SERVER_INVALID ((size_t)-1)
+
+// A growable array of bytes
+typedef struct {
+	char *data;
+	size_t len, size;
+} server_buffer;
+
+// How far the first command of a connection was scanned, so the scan can go on
+// once more of it is received (instead of starting over)
+typedef struct {
+	// pos = where the last complete token ends
+	size_t pos;
+	// command = the command's letter (0 = not known yet)
+	char command;
+	// step = how many of the tokens that tell how many others follow were
+	// read; remaining = how many others are still expected
+	int step;
+	long long remaining;
+	// m = the number of lines of 'L', until the number of columns is read
+	long long m;
+} server_scan;
+
+// The connection structure (one for every client)
+typedef struct server_connection {
+	int fd;
+	// The bytes received from (in) / waiting to be sent to (out) the client;
+	// out_sent = how many bytes of out were already sent
+	server_buffer in, out;
+	size_t out_sent;
+	// How far the first command in "in" was scanned
+	server_scan scan;
+	// busy = 1 while one of the client's commands is being executed
+	int busy;
+	// closing = SERVER_OPEN, SERVER_QUIT (the client issued 'Q' or closed its
+	// end of the socket - the commands received so far are executed and the
+	// connection is closed once their output is sent) or SERVER_HANGUP (the
+	// client is gone, the connection is closed as soon as it isn't busy). The
+	// closed connections (SERVER_CLOSED) are only freed after the events that
+	// were received at the same time are handled.
+	int closing;
+	// events = the events epoll waits for on the socket
+	unsigned int events;
+	// The command that is being executed and its output
+	char *command;
+	size_t command_len;
+	char *result;
+	size_t result_len;
+	// The connections are linked in the job, done and closed queues...
+	struct server_connection *next;
+	// ...and in the list of all the connections
+	struct server_connection *prev_all, *next_all;
+} server_connection;
+
+// The server structure
+typedef struct {
+	int listen_fd, epoll_fd, event_fd;
+	// The shared array of matrices and its lock
+	d_matrices dm;
+	pthread_rwlock_t lock;
+	octave_stats_ptr stats;
+	// The commands waiting for a worker (jobs) and the ones that were executed
+	// (done), both protected by queue_lock
+	server_connection *jobs, *jobs_tail, *done;
+	pthread_mutex_t queue_lock;
+	pthread_cond_t queue_cond;
+	// The worker threads (workers_started = how many of them are running,
+	// used to pin every one of them to a different CPU)
+	pthread_t *workers;
+	int workers_count, workers_started;
+	// Every connection is in this list...
+	server_connection *connections;
+	// ...until it is closed (see 'server_connection')
+	server_connection *closed;
+	// running = 0 once the server has to stop
+	volatile int running;
+} octave_server;
+
+// Note: The following typedefs are kept in the same spirit as the ones that
+// can be found in 'matrices_base'
+typedef server_connection * server_connection_ptr;
+typedef octave_server * octave_server_ptr;
+
+// This function appends len bytes to a buffer
+extern void server_buffer_append(server_buffer *buf, const char *data,
+								 size_t len);
+
+// This function removes the first len bytes of a buffer
+extern void server_buffer_consume(server_buffer *buf, size_t len);
+
+// This function returns the length of the first command in buf (leading
+// newlines included), 0 if the command wasn't received entirely yet or
+// SERVER_INVALID. The scan starts where the previous one stopped (the scan
+// structure has to be zeroed for every new command).
+extern size_t server_command_length(const char *buf, size_t len,
+									server_scan *scan);
+
+// This function accepts every pending client
+extern void server_accept(octave_server_ptr server);
+
+// This function reads whatever a client sent. It returns 0 if the client hung
+// up (the connection may have been freed already).
+extern int server_receive(octave_server_ptr server,
+						  server_connection_ptr conn);
+
+// This function sends as much of a connection's output as the socket accepts.
+// It returns 0 if the connection was closed (and freed).
+extern int server_flush(octave_server_ptr server, server_connection_ptr conn);
+
+// This function handles the commands that were executed by the workers
+extern void server_collect(octave_server_ptr server);
+
+// This function passes the next command of a connection to the workers (if
+// the connection isn't already busy and a whole command was received)
+extern void server_dispatch(octave_server_ptr server,
+							server_connection_ptr conn);
+
+// This function is executed by every worker thread
+extern void *server_worker(void *arg);
+
+// This function is called once a client is gone. The connection is freed
+// right away, unless one of its commands is being executed.
+extern void server_hangup(octave_server_ptr server,
+						  server_connection_ptr conn);
+
+// This function closes a connection
+extern void server_close(octave_server_ptr server, server_connection_ptr conn);
+
+// This function frees the connections that were closed
+extern void server_free_closed(octave_server_ptr server);
+
+// This function runs the server until SIGINT / SIGTERM is received
+extern int octave_server_run(octave_options_ptr opts);
+
+#endif // OCTAVE_SERVER_H
@@ -0,0 +1,176 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// clock_gettime is a POSIX function
+#define _POSIX_C_SOURCE 200809L
+
+// Include the asscociated header file
+#include "octave_stats.h"
+
+// Standard library dependencies
+#include <time.h> // clock_gettime
+
+// This function initializes a stats structure. If path is NULL, the statistics
+// will be written to stderr. It returns 0 if the file could not be opened.
+int octave_stats_init(octave_stats_ptr st, int enabled, const char *path)
+{
+	memset(st, 0, sizeof(octave_stats));
+	pthread_mutex_init(&st->lock, NULL);
+	st->enabled = enabled;
+	st->out = stderr;
+	st->start_ns = octave_stats_clock();
+
+	if (enabled && path) {
+		st->out = fopen(path, "a");
+		if (!st->out) {
+			fprintf(stderr, "Could not open the stats file: %s\n", path);
+			st->out = stderr;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// This function returns the value of a monotonic clock, in nanoseconds
+unsigned long long octave_stats_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// This function returns the histogram bucket for a given latency. Small values
+// get a bucket of their own; bigger values are split by their most significant
+// bit (the power of two) and by the OCTAVE_STATS_SUBBUCKETS bits that follow.
+int octave_stats_bucket(unsigned long long ns)
+{
+	if (ns < OCTAVE_STATS_SUBBUCKETS)
+		return (int)ns;
+
+	// Find the most significant bit (OCTAVE_STATS_SUBBUCKETS = 2^3)
+	int msb = 63;
+	while (!(ns >> msb))
+		--msb;
+
+	int mantissa = (int)(ns >> (msb - 3)) - OCTAVE_STATS_SUBBUCKETS;
+	return (msb - 2) * OCTAVE_STATS_SUBBUCKETS + mantissa;
+}
+
+// This function returns the highest latency that still fits in a bucket
+unsigned long long octave_stats_bucket_limit(int bucket)
+{
+	if (bucket < OCTAVE_STATS_SUBBUCKETS)
+		return (unsigned long long)bucket;
+
+	int msb = bucket / OCTAVE_STATS_SUBBUCKETS + 2;
+	unsigned long long mantissa = bucket % OCTAVE_STATS_SUBBUCKETS +
+								  OCTAVE_STATS_SUBBUCKETS;
+	return ((mantissa + 1) << (msb - 3)) - 1;
+}
+
+// This function returns the p-th percentile (0 < p <= 1) of the latencies that
+// were recorded for a command
+unsigned long long octave_stats_percentile(octave_stats_command *cmd, double p)
+{
+	// The rank of the wanted latency (rounded up)
+	unsigned long long rank = (unsigned long long)(p * cmd->count);
+	if (rank < p * cmd->count)
+		++rank;
+	if (rank == 0)
+		rank = 1;
+
+	unsigned long long seen = 0;
+	for (int b = 0; b < OCTAVE_STATS_BUCKETS; ++b) {
+		seen += cmd->histogram[b];
+		if (seen >= rank) {
+			// The bucket's limit may be bigger than anything we've seen
+			unsigned long long limit = octave_stats_bucket_limit(b);
+			return limit < cmd->max_ns ? limit : cmd->max_ns;
+		}
+	}
+
+	return cmd->max_ns;
+}
+
+// This function records the execution of a command which took ns nanoseconds
+// and performed flops arithmetic operations, after which matrices_count
+// matrices were loaded
+void octave_stats_record(octave_stats_ptr st, char command,
+						 unsigned long long ns, unsigned long long flops,
+						 int matrices_count)
+{
+	// Unknown commands are stored in the last entry
+	const char *at = strchr(OCTAVE_STATS_COMMANDS, command);
+	if (!at || command == '\0')
+		at = OCTAVE_STATS_COMMANDS + OCTAVE_STATS_COMMANDS_COUNT - 1;
+	octave_stats_command *cmd = &st->commands[at - OCTAVE_STATS_COMMANDS];
+
+	pthread_mutex_lock(&st->lock);
+	++cmd->count;
+	cmd->total_ns += ns;
+	if (ns > cmd->max_ns)
+		cmd->max_ns = ns;
+	cmd->flops += flops;
+	++cmd->histogram[octave_stats_bucket(ns)];
+
+	if (matrices_count > st->matrices_peak)
+		st->matrices_peak = matrices_count;
+	pthread_mutex_unlock(&st->lock);
+}
+
+// This function outputs all the statistics, as a single JSON line
+void octave_stats_dump(octave_stats_ptr st, d_matrices_ptr dm)
+{
+	// The memory used by the loaded matrices is computed on the spot
+	unsigned long long resident_bytes = 0;
+	for (int i = 0; i < dm->matrices_count; ++i)
+		if (!dm->matrices[i]->spilled)
+			resident_bytes += mm_matrix_bytes(dm->matrices[i]);
+
+	pthread_mutex_lock(&st->lock);
+	fprintf(st->out, "{\"enabled\":%s,\"uptime_ns\":%llu,",
+			st->enabled ? "true" : "false",
+			octave_stats_clock() - st->start_ns);
+	fprintf(st->out, "\"matrices_resident\":%d,\"matrices_spilled\":%d,",
+			dm->matrices_count - mm_spilled_count(), mm_spilled_count());
+	fprintf(st->out, "\"matrices_peak\":%d,", st->matrices_peak);
+	fprintf(st->out, "\"resident_bytes\":%llu,\"allocated_bytes\":%llu,",
+			resident_bytes, safe_allocated_bytes());
+	fprintf(st->out, "\"commands\":{");
+
+	int first = 1;
+	for (int i = 0; i < OCTAVE_STATS_COMMANDS_COUNT; ++i) {
+		octave_stats_command *cmd = &st->commands[i];
+		if (!cmd->count)
+			continue;
+
+		fprintf(st->out, "%s\"%c\":{\"count\":%llu,\"total_ns\":%llu,",
+				first ? "" : ",", OCTAVE_STATS_COMMANDS[i], cmd->count,
+				cmd->total_ns);
+		fprintf(st->out, "\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu",
+				octave_stats_percentile(cmd, 0.50),
+				octave_stats_percentile(cmd, 0.99), cmd->max_ns);
+		// The FLOP rate only makes sense for the multiplications
+		if (cmd->flops) {
+			double gflops = cmd->total_ns ?
+							(double)cmd->flops / cmd->total_ns : 0.0;
+			fprintf(st->out, ",\"flops\":%llu,\"gflops\":%.3f",
+					cmd->flops, gflops);
+		}
+		fprintf(st->out, "}");
+		first = 0;
+	}
+
+	fprintf(st->out, "}}\n");
+	fflush(st->out);
+	pthread_mutex_unlock(&st->lock);
+}
+
+// This function closes the output file (if one was opened)
+void octave_stats_free(octave_stats_ptr st)
+{
+	if (st->out && st->out != stderr)
+		fclose(st->out);
+	st->out = NULL;
+	pthread_mutex_destroy(&st->lock);
+}
@@ -0,0 +1,97 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef OCTAVE_STATS_H
+#define OCTAVE_STATS_H
+
+// This file contains the built-in instrumentation of the simulator. When it is
+// enabled (--stats), every command is timed and its latency is stored in a
+// histogram. The statistics are dumped (as a single JSON line) when the 'I'
+// command is issued and when the program quits.
+
+// Standard library dependencies
+#include <stdio.h> // fprintf, fopen
+#include <string.h> // strchr
+#include <pthread.h> // pthread_mutex_t
+
+// Other dependencies
+#include "matrices_base.h"
+#include "matrices_memory.h" // mm_matrix_bytes, mm_spilled_count
+#include "safe_utilities.h" // safe_allocated_bytes
+
+// These are the commands that are tracked separately. Anything else (invalid
+// commands included) ends up in the last entry, '?'
+#define OCTAVE_STATS_COMMANDS "LDPCMOTFSQIERVXABHKabhkUWN?"
+#define OCTAVE_STATS_COMMANDS_COUNT 27
+
+// The latency histogram splits every power of two (in nanoseconds) into this
+// many buckets, so a percentile is off by at most 1/8 = 12.5%
+#define OCTAVE_STATS_SUBBUCKETS 8
+#define OCTAVE_STATS_BUCKETS (64 * OCTAVE_STATS_SUBBUCKETS)
+
+// The information that is gathered for every command type
+typedef struct {
+	// count = how many times the command was issued
+	unsigned long long count;
+	// The total and the maximum latency, in nanoseconds
+	unsigned long long total_ns, max_ns;
+	// The number of arithmetic operations performed by the command ('M', 'S',
+	// 'N', the linear algebra and the element-wise ones)
+	unsigned long long flops;
+	// histogram[b] = how many latencies fell in bucket b
+	unsigned long long histogram[OCTAVE_STATS_BUCKETS];
+} octave_stats_command;
+
+// The stats structure
+typedef struct {
+	// enabled = 1 if the commands have to be timed
+	int enabled;
+	// The server (see 'octave_server') records commands from multiple threads
+	pthread_mutex_t lock;
+	// The statistics are written here (stderr or a file opened in append mode)
+	FILE *out;
+	// The moment the instrumentation was started, in nanoseconds
+	unsigned long long start_ns;
+	// The highest number of matrices that were loaded at the same time
+	int matrices_peak;
+	// One entry for every character of OCTAVE_STATS_COMMANDS
+	octave_stats_command commands[OCTAVE_STATS_COMMANDS_COUNT];
+} octave_stats;
+
+// Note: The following typedef is kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef octave_stats * octave_stats_ptr;
+
+// This function initializes a stats structure. If path is NULL, the statistics
+// will be written to stderr. It returns 0 if the file could not be opened.
+extern int octave_stats_init(octave_stats_ptr st, int enabled,
+							 const char *path);
+
+// This function returns the value of a monotonic clock, in nanoseconds
+extern unsigned long long octave_stats_clock(void);
+
+// This function returns the histogram bucket for a given latency
+extern int octave_stats_bucket(unsigned long long ns);
+
+// This function returns the highest latency that still fits in a bucket
+extern unsigned long long octave_stats_bucket_limit(int bucket);
+
+// This function returns the p-th percentile (0 < p <= 1) of the latencies that
+// were recorded for a command
+extern unsigned long long octave_stats_percentile(octave_stats_command *cmd,
+												  double p);
+
+// This function records the execution of a command which took ns nanoseconds
+// and performed flops arithmetic operations, after which matrices_count
+// matrices were loaded
+extern void octave_stats_record(octave_stats_ptr st, char command,
+								unsigned long long ns,
+								unsigned long long flops,
+								int matrices_count);
+
+// This function outputs all the statistics, as a single JSON line
+extern void octave_stats_dump(octave_stats_ptr st, d_matrices_ptr dm);
+
+// This function closes the output file (if one was opened)
+extern void octave_stats_free(octave_stats_ptr st);
+
+#endif // OCTAVE_STATS_H
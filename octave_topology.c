@@ -0,0 +1,266 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// CPU affinity and madvise hints are Linux features
+#define _GNU_SOURCE
+
+// Include the asscociated header file
+#include "octave_topology.h"
+
+// Standard library dependencies
+#include <pthread.h> // pthread_setaffinity_np
+#include <sched.h> // sched_getaffinity, cpu_set_t
+#include <stdint.h> // uintptr_t
+#include <string.h> // strchr, strcspn
+#include <sys/mman.h> // madvise
+#include <sys/syscall.h> // SYS_mbind
+#include <unistd.h> // syscall, sysconf
+
+// The mbind policy (from the kernel's headers, so libnuma isn't needed)
+#define TOPO_MPOL_INTERLEAVE 3
+
+// The topology is shared by the whole program
+static octave_topology topo;
+
+// This function reads the first line of a file into buf. It returns 0 if the
+// file can't be read.
+static int topo_read_line(const char *path, char *buf, int size)
+{
+	FILE *f = fopen(path, "r");
+	if (!f)
+		return 0;
+	int ok = fgets(buf, size, f) != NULL;
+	fclose(f);
+	buf[strcspn(buf, "\n")] = '\0';
+	return ok;
+}
+
+// This function parses a list of CPUs (e.g. "0-3,8") and appends every one of
+// them to cpus (which has room for max CPUs)
+void topo_parse_cpus(const char *list, int *cpus, int *count, int max)
+{
+	while (*list) {
+		char *end;
+		long first = strtol(list, &end, 10), last = first;
+		if (end == list)
+			return;
+		if (*end == '-')
+			last = strtol(end + 1, &end, 10);
+		for (long cpu = first; cpu <= last && *count < max; ++cpu)
+			cpus[(*count)++] = (int)cpu;
+		list = *end == ',' ? end + 1 : end;
+	}
+}
+
+// This function reads the nodes from sysfs. The CPUs this process may not use
+// are left out.
+static void topo_detect(void)
+{
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed))
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+			CPU_SET(cpu, &allowed);
+
+	// The CPUs of every node, in the kernel's order
+	static int node_cpus[TOPO_MAX_NODES][TOPO_MAX_CPUS];
+	int node_count[TOPO_MAX_NODES];
+
+	// The nodes are numbered by the kernel, with gaps if some are offline
+	// (written like a list of CPUs, e.g. "0,2-3"). Without the list, every
+	// number is tried.
+	int ids[TOPO_MAX_NODES], ids_count = 0;
+	char online[256];
+	if (topo_read_line("/sys/devices/system/node/online", online,
+					   sizeof(online)))
+		topo_parse_cpus(online, ids, &ids_count, TOPO_MAX_NODES);
+	else
+		for (ids_count = 0; ids_count < TOPO_MAX_NODES; ++ids_count)
+			ids[ids_count] = ids_count;
+
+	topo.nodes_count = 0;
+	for (int k = 0; k < ids_count; ++k) {
+		// The nodes that don't fit in the mask of mbind are left out
+		int id = ids[k], node = topo.nodes_count;
+		if (id < 0 || id >= TOPO_MAX_NODES)
+			continue;
+
+		char path[128], line[256];
+		snprintf(path, sizeof(path),
+				 "/sys/devices/system/node/node%d/cpulist", id);
+		if (!topo_read_line(path, topo.node_cpus[node],
+							sizeof(topo.node_cpus[node])))
+			continue;
+		topo.node_ids[node] = id;
+
+		node_count[node] = 0;
+		topo_parse_cpus(topo.node_cpus[node], node_cpus[node],
+						&node_count[node], TOPO_MAX_CPUS);
+
+		// The first line is "Node N MemTotal: X kB"
+		topo.node_memory[node] = 0;
+		snprintf(path, sizeof(path),
+				 "/sys/devices/system/node/node%d/meminfo", id);
+		if (topo_read_line(path, line, sizeof(line))) {
+			char *total = strchr(line, ':');
+			if (total)
+				topo.node_memory[node] = strtoull(total + 1, NULL, 10);
+		}
+		++topo.nodes_count;
+	}
+
+	// Without NUMA (or sysfs), every CPU belongs to a single node
+	if (!topo.nodes_count) {
+		topo.nodes_count = 1;
+		topo.node_ids[0] = 0;
+		node_count[0] = 0;
+		for (int cpu = 0; cpu < CPU_SETSIZE && cpu < TOPO_MAX_CPUS; ++cpu)
+			if (CPU_ISSET(cpu, &allowed))
+				node_cpus[0][node_count[0]++] = cpu;
+		snprintf(topo.node_cpus[0], sizeof(topo.node_cpus[0]), "all");
+		topo.node_memory[0] = (unsigned long long)sysconf(_SC_PHYS_PAGES) *
+							  sysconf(_SC_PAGESIZE) / 1024;
+	}
+
+	// One CPU from every node in turn, so consecutive workers are spread
+	// over the nodes (and use the memory bandwidth of all of them)
+	topo.cpus_count = 0;
+	for (int round = 0, added = 1; added; ++round) {
+		added = 0;
+		for (int node = 0; node < topo.nodes_count; ++node) {
+			if (round >= node_count[node])
+				continue;
+			int cpu = node_cpus[node][round];
+			if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed) &&
+				topo.cpus_count < TOPO_MAX_CPUS)
+				topo.cpus[topo.cpus_count++] = cpu;
+			added = 1;
+		}
+	}
+
+	if (!topo_read_line("/sys/kernel/mm/transparent_hugepage/enabled",
+						topo.thp, sizeof(topo.thp)))
+		snprintf(topo.thp, sizeof(topo.thp), "unavailable");
+
+	// The huge page size is found in /proc/meminfo ("Hugepagesize: X kB")
+	topo.huge_page_size = 0;
+	FILE *f = fopen("/proc/meminfo", "r");
+	if (f) {
+		char line[256];
+		while (fgets(line, sizeof(line), f))
+			if (sscanf(line, "Hugepagesize: %llu", &topo.huge_page_size) == 1)
+				break;
+		fclose(f);
+	}
+}
+
+// This function reads the topology and sets up the placement. It returns 0
+// on failure.
+int topo_init(int numa, int pin, int huge_pages, unsigned long long threshold,
+			  int threads)
+{
+	topo.numa = numa;
+	// Local memory only helps if the threads stay on the same node
+	topo.pin = pin || numa == TOPO_NUMA_LOCAL;
+	topo.huge_pages = huge_pages;
+	topo.threshold = threshold;
+	topo.threads = threads;
+	topo_detect();
+
+	if (huge_pages || (numa == TOPO_NUMA_INTERLEAVE && topo.nodes_count > 1))
+		safe_set_advise(topo_advise);
+	return 1;
+}
+
+// This function is called for every allocation (see 'safe_set_advise'). The
+// memory is advised if what it is a part of is big.
+void topo_advise(void *p, size_t n, size_t whole)
+{
+	if (whole < topo.threshold)
+		return;
+
+	// Only whole pages can be advised, so the pages the block shares with its
+	// neighbours (if malloc didn't map it on its own) are left as they are
+	uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t first = ((uintptr_t)p + page - 1) & ~(page - 1);
+	uintptr_t last = ((uintptr_t)p + n) & ~(page - 1);
+	if (last <= first)
+		return;
+
+#ifdef MADV_HUGEPAGE
+	if (topo.huge_pages)
+		madvise((void *)first, last - first, MADV_HUGEPAGE);
+#endif
+
+#ifdef SYS_mbind
+	if (topo.numa == TOPO_NUMA_INTERLEAVE && topo.nodes_count > 1) {
+		unsigned long mask[TOPO_MAX_NODES / (8 * sizeof(unsigned long)) + 1];
+		memset(mask, 0, sizeof(mask));
+		for (int node = 0; node < topo.nodes_count; ++node) {
+			int id = topo.node_ids[node];
+			mask[id / (8 * sizeof(unsigned long))] |=
+				1UL << (id % (8 * sizeof(unsigned long)));
+		}
+		// The pages that weren't touched yet are placed as they are used (the
+		// ones malloc already wrote to stay where they are)
+		syscall(SYS_mbind, first, last - first, TOPO_MPOL_INTERLEAVE, mask,
+				TOPO_MAX_NODES + 1, 0);
+	}
+#endif
+}
+
+// This function pins the calling thread to the index-th CPU (round robin), if
+// the workers should be pinned
+void topo_pin(int index)
+{
+	if (!topo.pin || !topo.cpus_count)
+		return;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(topo.cpus[index % topo.cpus_count], &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// This function returns the number of threads a kernel may use (at least 1,
+// at most max)
+int topo_threads(int max)
+{
+	// The library may be used without topo_init, so the CPUs may be unknown
+	long threads = topo.threads;
+	if (threads < 1)
+		threads = topo.cpus_count;
+	if (threads < 1)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads > max)
+		threads = max;
+	return threads < 1 ? 1 : (int)threads;
+}
+
+// This function outputs the topology and the chosen placement
+void topo_report(FILE *out)
+{
+	static const char *numa[] = {"off", "local", "interleave"};
+
+	fprintf(out, "Topology: %d node(s), %d usable CPU(s)\n",
+			topo.nodes_count, topo.cpus_count);
+	for (int node = 0; node < topo.nodes_count; ++node)
+		fprintf(out, "  node %d: CPUs %s, %llu MB\n", topo.node_ids[node],
+				topo.node_cpus[node], topo.node_memory[node] / 1024);
+	fprintf(out, "Transparent huge pages: %s (huge page size: %llu kB)\n",
+			topo.thp, topo.huge_page_size);
+	fprintf(out, "Placement: numa=%s, pinning=%s, huge pages=%s",
+			numa[topo.numa], topo.pin ? "on" : "off",
+			topo.huge_pages ? "on" : "off");
+	if (topo.huge_pages || topo.numa == TOPO_NUMA_INTERLEAVE)
+		fprintf(out, " (allocations of at least %llu bytes)", topo.threshold);
+	fprintf(out, "\n");
+	fprintf(out, "Threads of a kernel: at most %d\n",
+			topo_threads(TOPO_MAX_CPUS));
+
+	if (topo.pin) {
+		fprintf(out, "Worker CPUs:");
+		for (int i = 0; i < topo.cpus_count; ++i)
+			fprintf(out, " %d", topo.cpus[i]);
+		fprintf(out, "\n");
+	}
+}
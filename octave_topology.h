@@ -0,0 +1,94 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef OCTAVE_TOPOLOGY_H
+#define OCTAVE_TOPOLOGY_H
+
+// This file contains the placement of the memory and of the threads on
+// machines with more than one NUMA node (e.g. dual-socket servers). The
+// topology is read from sysfs at startup and, depending on the options:
+// --numa=local      the worker threads (see 'octave_server') and processes
+//                   (see 'matrices_distributed') are pinned, spread over the
+//                   nodes, so the memory they touch first is local to them
+// --numa=interleave big allocations are spread over every node, so memory
+//                   shared by every thread gets the bandwidth of all of them
+// --pin-threads     the workers are pinned (without changing the memory)
+// --huge-pages      big allocations are backed by transparent huge pages
+// --topology        the topology and the chosen placement are output
+// Only allocations of at least --huge-threshold bytes (2M by default) are
+// affected - for a matrix, that is the size of all of its lines together (see
+// alloc_matrix_lines). Everything is off by default.
+//
+// The kernels that split their work between threads (see 'matrices_linear'
+// and 'matrices_chain') take their number from here, too: --threads=N, or one
+// for every CPU this process may use. Their threads are pinned just like the
+// workers.
+
+// Standard library dependencies
+#include <stdio.h> // fopen, fscanf, fprintf
+#include <stdlib.h> // strtol
+
+// Other dependencies
+#include "safe_utilities.h" // safe_set_advise
+
+// The maximum number of nodes / CPUs that are handled
+#define TOPO_MAX_NODES 64
+#define TOPO_MAX_CPUS 1024
+
+// The memory placement policies
+#define TOPO_NUMA_OFF 0
+#define TOPO_NUMA_LOCAL 1
+#define TOPO_NUMA_INTERLEAVE 2
+
+// The default size above which the memory is advised
+#define TOPO_DEFAULT_THRESHOLD (2ULL << 20)
+
+// The topology structure (there is a single one per program)
+typedef struct {
+	// The nodes (a machine without NUMA has a single one) and the number the
+	// kernel gave to every one of them (there may be gaps, see topo_detect)
+	int nodes_count;
+	int node_ids[TOPO_MAX_NODES];
+	// The CPUs of every node, as written by the kernel (e.g. "0-7,16-23")
+	char node_cpus[TOPO_MAX_NODES][128];
+	// The memory of every node (in kB)
+	unsigned long long node_memory[TOPO_MAX_NODES];
+	// The CPUs this process may use, in the order the workers are pinned to
+	// them: one CPU from every node in turn
+	int cpus[TOPO_MAX_CPUS];
+	int cpus_count;
+	// The kernel's transparent huge pages setting and the huge page size (kB)
+	char thp[128];
+	unsigned long long huge_page_size;
+	// The chosen placement
+	int numa, pin, huge_pages;
+	unsigned long long threshold;
+	// threads = the most threads a kernel may use (0 = one for every CPU)
+	int threads;
+} octave_topology;
+
+// This function reads the topology and sets up the placement. It returns 0
+// on failure.
+extern int topo_init(int numa, int pin, int huge_pages,
+					 unsigned long long threshold, int threads);
+
+// This function parses a list of CPUs (e.g. "0-3,8") and appends every one of
+// them to cpus (which has room for max CPUs)
+extern void topo_parse_cpus(const char *list, int *cpus, int *count,
+							int max);
+
+// This function is called for every allocation (see 'safe_set_advise'). The
+// memory is advised if what it is a part of is big.
+extern void topo_advise(void *p, size_t n, size_t whole);
+
+// This function pins the calling thread to the index-th CPU (round robin), if
+// the workers should be pinned
+extern void topo_pin(int index);
+
+// This function returns the number of threads a kernel may use (at least 1,
+// at most max)
+extern int topo_threads(int max);
+
+// This function outputs the topology and the chosen placement
+extern void topo_report(FILE *out);
+
+#endif // OCTAVE_TOPOLOGY_H
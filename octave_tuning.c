@@ -0,0 +1,190 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+// Include the asscociated header file
+#include "octave_tuning.h"
+
+// The maximum length of a line of the tuning file
+#define TUNE_LINE 512
+
+// The parameters are shared by the whole program. They are only changed before
+// any command is executed (or by the tuner), so they are never locked.
+static octave_tuning tune;
+
+// This function sets the default parameters and finds out the CPU model
+void tune_init(void)
+{
+	for (int i = 0; i < TUNE_CLASSES; ++i) {
+		tune.params[i].strassen_cutoff = TUNE_DEFAULT_STRASSEN_CUTOFF;
+		tune.params[i].multiply_block = TUNE_DEFAULT_MULTIPLY_BLOCK;
+	}
+	tune.tuned = 0;
+	tune_cpu_model(tune.cpu, sizeof(tune.cpu));
+}
+
+// This function reads the CPU model from /proc/cpuinfo into buf
+void tune_cpu_model(char *buf, int size)
+{
+	snprintf(buf, size, "unknown");
+
+	FILE *f = fopen("/proc/cpuinfo", "r");
+	if (!f)
+		return;
+
+	// x86 calls it "model name"; other machines only have "CPU part" and the
+	// likes, which are better than nothing
+	char line[TUNE_LINE];
+	while (fgets(line, sizeof(line), f)) {
+		char *value = strchr(line, ':');
+		if (!value)
+			continue;
+		if (!strncmp(line, "model name", 10) ||
+			(!strcmp(buf, "unknown") && (!strncmp(line, "CPU part", 8) ||
+										 !strncmp(line, "cpu model", 9)))) {
+			value += strspn(value, ": \t");
+			value[strcspn(value, "\t\n")] = '\0';
+			snprintf(buf, size, "%s", value);
+			if (!strncmp(line, "model name", 10))
+				break;
+		}
+	}
+	fclose(f);
+}
+
+// This function returns the tuning file that --tune writes when none was given,
+// or NULL if there is none (no home directory)
+const char *tune_default_path(void)
+{
+	static char path[TUNE_LINE];
+	const char *home = getenv("HOME");
+	if (!home || !*home)
+		return NULL;
+	snprintf(path, sizeof(path), "%s/.octave_tuning", home);
+	return path;
+}
+
+// This function checks that the parameters can be used by the kernels
+int tune_valid(tune_params_ptr params)
+{
+	int cutoff = params->strassen_cutoff;
+	return cutoff >= 1 && cutoff <= TUNE_MAX_STRASSEN_CUTOFF &&
+		   !(cutoff & (cutoff - 1)) && params->multiply_block >= 0;
+}
+
+// This function splits a line of the tuning file. It returns 0 if the line
+// isn't valid.
+static int tune_parse_line(char *line, char **cpu, int *class,
+						   tune_params_ptr params)
+{
+	char *tab = strchr(line, '\t');
+	if (line[0] == '#' || !tab)
+		return 0;
+	*tab = '\0';
+	*cpu = line;
+	return sscanf(tab + 1, "%d %d %d", class, &params->strassen_cutoff,
+				  &params->multiply_block) == 3 &&
+		   *class >= 0 && *class < TUNE_CLASSES && tune_valid(params);
+}
+
+// This function reads the current CPU's parameters from the tuning file. It
+// returns 0 if there are none (the defaults are kept).
+int tune_load(const char *path)
+{
+	FILE *f = path ? fopen(path, "r") : NULL;
+	if (!f)
+		return 0;
+
+	char line[TUNE_LINE];
+	while (fgets(line, sizeof(line), f)) {
+		char *cpu;
+		int class;
+		tune_params params;
+		if (tune_parse_line(line, &cpu, &class, &params) &&
+			!strcmp(cpu, tune.cpu)) {
+			tune.params[class] = params;
+			tune.tuned = 1;
+		}
+	}
+	fclose(f);
+
+	return tune.tuned;
+}
+
+// This function stores the current CPU's parameters in the tuning file. The
+// lines of the other CPUs are kept. It returns 0 on failure.
+int tune_save(const char *path)
+{
+	if (!path)
+		return 0;
+
+	// The file is rewritten through a temporary one, so a program that reads
+	// it at the same time never sees half of it
+	char tmp[TUNE_LINE];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	FILE *out = fopen(tmp, "w");
+	if (!out)
+		return 0;
+
+	fprintf(out, "# octave-simulator tuning file: CPU<tab>class<tab>"
+			"strassen_cutoff multiply_block\n");
+	FILE *in = fopen(path, "r");
+	if (in) {
+		char line[TUNE_LINE], copy[TUNE_LINE];
+		while (fgets(line, sizeof(line), in)) {
+			char *cpu;
+			int class;
+			tune_params params;
+			memcpy(copy, line, sizeof(line));
+			if (tune_parse_line(copy, &cpu, &class, &params) &&
+				strcmp(cpu, tune.cpu))
+				fputs(line, out);
+		}
+		fclose(in);
+	}
+
+	for (int i = 0; i < TUNE_CLASSES; ++i)
+		fprintf(out, "%s\t%d\t%d %d\n", tune.cpu, i,
+				tune.params[i].strassen_cutoff, tune.params[i].multiply_block);
+
+	if (fclose(out) || rename(tmp, path)) {
+		remove(tmp);
+		return 0;
+	}
+	return 1;
+}
+
+// This function returns the size class of a matrix with the given biggest
+// dimension
+int tune_class(int size)
+{
+	static const int bounds[TUNE_CLASSES] = TUNE_CLASS_BOUNDS;
+	int class = 0;
+	while (class < TUNE_CLASSES - 1 && size > bounds[class])
+		++class;
+	return class;
+}
+
+// This function returns the parameters that should be used for matrices with
+// the given biggest dimension
+tune_params_ptr tune_lookup(int size)
+{
+	return &tune.params[tune_class(size)];
+}
+
+// This function changes the parameters of a size class
+void tune_set(int class, tune_params_ptr params)
+{
+	tune.params[class] = *params;
+	tune.tuned = 1;
+}
+
+// This function outputs the CPU model and the parameters of every class
+void tune_report(FILE *out)
+{
+	static const int sizes[TUNE_CLASSES] = TUNE_CLASS_SIZES;
+	fprintf(out, "CPU: %s (%s parameters)\n", tune.cpu,
+			tune.tuned ? "tuned" : "default");
+	for (int i = 0; i < TUNE_CLASSES; ++i)
+		fprintf(out, "  class %d (~%d): strassen_cutoff=%d multiply_block=%d\n",
+				i, sizes[i], tune.params[i].strassen_cutoff,
+				tune.params[i].multiply_block);
+}
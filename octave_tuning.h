@@ -0,0 +1,97 @@
+// Copyright (C) 2021 Valentin-Ioan VINTILA (313CA / 2021-2022)
+
+#ifndef OCTAVE_TUNING_H
+#define OCTAVE_TUNING_H
+
+// This file contains the parameters of the kernels (block sizes, crossover
+// points) that depend on the machine. The best ones are found by measuring the
+// candidates on the current machine (--tune, see 'octave_benchmark') and are
+// stored in a tuning file (--tuning-file, ~/.octave_tuning by default), next to
+// the ones found on other machines - every line holds the parameters of a CPU
+// model for a size class:
+// MODEL<tab>CLASS<tab>STRASSEN_CUTOFF MULTIPLY_BLOCK
+// The file is only read at startup if it was given (--tuning-file); without
+// it (or without a line for the current CPU), the defaults are used. The
+// kernels look up the parameters that fit the size of their operands.
+
+// Standard library dependencies
+#include <stdio.h> // fopen, fgets, fprintf, rename
+#include <stdlib.h> // getenv
+#include <string.h> // strcmp, strchr, strcspn
+
+// The size classes. The parameters of a class are measured on square matrices
+// of its representative size and are used for every matrix whose biggest
+// dimension is at most the class's bound.
+#define TUNE_CLASSES 4
+#define TUNE_CLASS_BOUNDS {128, 384, 768, 0x7fffffff}
+#define TUNE_CLASS_SIZES {64, 256, 512, 1024}
+
+// The biggest Strassen cutoff (the base case keeps a line of the block on the
+// stack, see STRASSEN_BOUND in 'matrices_multiplication')
+#define TUNE_MAX_STRASSEN_CUTOFF 256
+
+// The default parameters
+#define TUNE_DEFAULT_STRASSEN_CUTOFF 64
+#define TUNE_DEFAULT_MULTIPLY_BLOCK 0
+
+// The parameters of a size class
+typedef struct {
+	// strassen_cutoff = the size below which the Strassen algorithm multiplies
+	// the blocks using the naive method (a power of two, at most
+	// TUNE_MAX_STRASSEN_CUTOFF)
+	int strassen_cutoff;
+	// multiply_block = the number of columns of the result computed at once by
+	// the naive method (0 = every element on its own, as a dot product)
+	int multiply_block;
+} tune_params;
+
+// The tuning structure (there is a single one per program)
+typedef struct {
+	// cpu = the CPU model the parameters are stored for
+	char cpu[256];
+	// tuned = 1 if the parameters were measured on this CPU (now or when the
+	// tuning file was written)
+	int tuned;
+	tune_params params[TUNE_CLASSES];
+} octave_tuning;
+
+// Note: The following typedef is kept in the same spirit as the ones that can
+// be found in 'matrices_base'
+typedef tune_params * tune_params_ptr;
+
+// This function sets the default parameters and finds out the CPU model
+extern void tune_init(void);
+
+// This function reads the CPU model from /proc/cpuinfo into buf
+extern void tune_cpu_model(char *buf, int size);
+
+// This function returns the tuning file that --tune writes when none was given,
+// or NULL if there is none (no home directory)
+extern const char *tune_default_path(void);
+
+// This function checks that the parameters can be used by the kernels
+extern int tune_valid(tune_params_ptr params);
+
+// This function reads the current CPU's parameters from the tuning file. It
+// returns 0 if there are none (the defaults are kept).
+extern int tune_load(const char *path);
+
+// This function stores the current CPU's parameters in the tuning file. The
+// lines of the other CPUs are kept. It returns 0 on failure.
+extern int tune_save(const char *path);
+
+// This function returns the size class of a matrix with the given biggest
+// dimension
+extern int tune_class(int size);
+
+// This function returns the parameters that should be used for matrices with
+// the given biggest dimension
+extern tune_params_ptr tune_lookup(int size);
+
+// This function changes the parameters of a size class
+extern void tune_set(int class, tune_params_ptr params);
+
+// This function outputs the CPU model and the parameters of every class
+extern void tune_report(FILE *out);
+
+#endif // OCTAVE_TUNING_H
@@ -3,36 +3,106 @@
 // Include the asscociated header file
 #include "safe_utilities.h"
 
+// Every successful allocation adds its size to this counter (atomically, since
+// the server allocates from multiple threads)
+static unsigned long long allocated_bytes;
+
+// This handler is asked to free some memory when an allocation fails
+static int (*reclaim_handler)(size_t n);
+
+// This handler is told about every new allocation
+static void (*advise_handler)(void *p, size_t n, size_t whole);
+
+// This function registers a handler that is called when an allocation fails,
+// before giving up. The handler should free some memory (at least n bytes,
+// ideally) and return 0 if it couldn't free anything. NULL removes it.
+void safe_set_reclaim(int (*reclaim)(size_t n))
+{
+	reclaim_handler = reclaim;
+}
+
+// This function registers a handler that is called after every successful
+// allocation, with the new memory, its size and the size of what it is a part
+// of (the same size, for safe_malloc). It may give the kernel hints about the
+// memory (see 'octave_topology'). NULL removes it.
+void safe_set_advise(void (*advise)(void *p, size_t n, size_t whole))
+{
+	advise_handler = advise;
+}
+
+// This function calls the handler registered by safe_set_advise for a part of
+// something bigger (e.g. the lines of a matrix, see alloc_matrix_lines): n
+// bytes at p, out of whole bytes
+void safe_advise(void *p, size_t n, size_t whole)
+{
+	if (advise_handler)
+		advise_handler(p, n, whole);
+}
+
 // This function allocates memory safely (it verifies that said memory does
 // indeed get allocated)
-void *safe_malloc_utility(int n, int line, int retry)
+void *safe_malloc_utility(size_t n, int line, int retry)
 {
 	void *p = malloc(n);
+	// Ask the handler to make some room for as long as it can
+	while (!p && reclaim_handler && reclaim_handler(n))
+		p = malloc(n);
 	if (!p) {
 		if (retry != 0)
 			return safe_malloc_utility(n, line, retry - 1);
 
 		// Error message
 		fprintf(stderr, "[%s:%d] FATAL: Out of memory.\n", __FILE__, line);
-		fprintf(stderr, "Tried to allocate: %d bytes", n);
+		fprintf(stderr, "Tried to allocate: %zu bytes", n);
 		exit(EXIT_FAILURE);
 	}
+	__atomic_fetch_add(&allocated_bytes, n, __ATOMIC_RELAXED);
+	if (advise_handler)
+		advise_handler(p, n, n);
 	return p;
 }
 
 // This function reallocates memory safely (it verifies that said memory does
 // indeed get reallocated)
-void *safe_realloc_utility(void *ptr, int n, int line, int retry)
+void *safe_realloc_utility(void *ptr, size_t n, int line, int retry)
 {
 	void *p = realloc(ptr, n);
+	// Ask the handler to make some room for as long as it can
+	while (!p && reclaim_handler && reclaim_handler(n))
+		p = realloc(ptr, n);
 	if (!p) {
 		if (retry != 0)
 			return safe_realloc_utility(ptr, n, line, retry - 1);
 
 		// Error message
 		fprintf(stderr, "[%s:%d] FATAL: Out of memory.\n", __FILE__, line);
-		fprintf(stderr, "Tried to reallocate: %d bytes", n);
+		fprintf(stderr, "Tried to reallocate: %zu bytes", n);
 		exit(EXIT_FAILURE);
 	}
+	__atomic_fetch_add(&allocated_bytes, n, __ATOMIC_RELAXED);
+	if (advise_handler)
+		advise_handler(p, n, n);
 	return p;
 }
+
+// This function computes the size of an array (count elements of the given
+// size) safely: if the size doesn't fit in a size_t, the program quits instead
+// of allocating a smaller block
+size_t safe_mul_utility(long long count, size_t size, int line)
+{
+	size_t n;
+	if (count < 0 || __builtin_mul_overflow((size_t)count, size, &n)) {
+		// Error message
+		fprintf(stderr, "[%s:%d] FATAL: Size overflow.\n", __FILE__, line);
+		fprintf(stderr, "Tried to allocate: %lld x %zu bytes", count, size);
+		exit(EXIT_FAILURE);
+	}
+	return n;
+}
+
+// This function returns the total number of bytes that were requested through
+// safe_malloc and safe_realloc since the program started
+unsigned long long safe_allocated_bytes(void)
+{
+	return __atomic_load_n(&allocated_bytes, __ATOMIC_RELAXED);
+}
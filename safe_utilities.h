@@ -7,6 +7,7 @@
 // memory can be allocated.
 
 // Standard library dependencies
+#include <stddef.h> // size_t
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -18,7 +19,7 @@
 
 // This function allocates memory safely (it verifies that said memory does
 // indeed get allocated)
-extern void *safe_malloc_utility(int n, int line, int retry);
+extern void *safe_malloc_utility(size_t n, int line, int retry);
 
 // The safe_realloc_utility SHOULD NOT be used by itself. safe_realloc should be
 // used instead. It passes two additional arguments to the safe_realloc_utility,
@@ -28,6 +29,38 @@ extern void *safe_malloc_utility(int n, int line, int retry);
 
 // This function reallocates memory safely (it verifies that said memory does
 // indeed get reallocated)
-extern void *safe_realloc_utility(void *ptr, int n, int line, int retry);
+extern void *safe_realloc_utility(void *ptr, size_t n, int line, int retry);
+
+// The safe_mul_utility SHOULD NOT be used by itself. safe_mul should be used
+// instead. It passes the line number where the size is computed as an
+// additional argument.
+#define safe_mul(count, size) safe_mul_utility(count, size, __LINE__)
+
+// This function computes the size of an array (count elements of the given
+// size) safely: if the size doesn't fit in a size_t, the program quits instead
+// of allocating a smaller block. count is a long long, so negative counts
+// (e.g. read from the input) are caught, too.
+extern size_t safe_mul_utility(long long count, size_t size, int line);
+
+// This function registers a handler that is called when an allocation fails,
+// before giving up. The handler should free some memory (at least n bytes,
+// ideally) and return 0 if it couldn't free anything. NULL removes it.
+extern void safe_set_reclaim(int (*reclaim)(size_t n));
+
+// This function registers a handler that is called after every successful
+// allocation, with the new memory, its size and the size of what it is a part
+// of (the same size, for safe_malloc). It may give the kernel hints about the
+// memory (see 'octave_topology'). NULL removes it.
+extern void safe_set_advise(void (*advise)(void *p, size_t n, size_t whole));
+
+// This function calls the handler registered by safe_set_advise for a part of
+// something bigger (e.g. the lines of a matrix, see alloc_matrix_lines): n
+// bytes at p, out of whole bytes
+extern void safe_advise(void *p, size_t n, size_t whole);
+
+// This function returns the total number of bytes that were requested through
+// safe_malloc and safe_realloc since the program started (used by the
+// instrumentation that can be found in 'octave_stats')
+extern unsigned long long safe_allocated_bytes(void);
 
 #endif // SAFE_UTILITIES_H